@@ -157,10 +157,10 @@ def evaluate_cameras():
     plt.show()
 
 def generate_images():
-    call_command(EXECUTABLE + ' --config by_step/config.json --eval mse c ' + str(MSE_SAMPLES))
-    call_command(EXECUTABLE + ' --config by_step/config.json --eval mse d ' + str(MSE_SAMPLES))
-    call_command(EXECUTABLE + ' --config by_step/config.json --eval mse da ' + str(MSE_SAMPLES))
-    call_command(EXECUTABLE + ' --config by_step/config.json --eval mse gt')
+    # the ground truth is written by the novel view runs
+    call_command(EXECUTABLE + ' --config by_step/config.json --eval mse c ' + str(MSE_SAMPLES) + ' --dump')
+    call_command(EXECUTABLE + ' --config by_step/config.json --eval mse d ' + str(MSE_SAMPLES) + ' --dump')
+    call_command(EXECUTABLE + ' --config by_step/config.json --eval mse da ' + str(MSE_SAMPLES) + ' --dump')
     return
 
 def images_mse(gt_folder, novel_folder):
@@ -205,6 +205,17 @@ def images_mse(gt_folder, novel_folder):
     return overall_mse, overall_diff
 
 
+def evaluate_metrics():
+    print("----Image metrics----")
+
+    for k, heuristic in {"color": "c", "dist": "d", "dist_angle": "da"}.items():
+        output = call_command(EXECUTABLE + ' --config by_step/config.json --eval mse ' + heuristic + ' ' + str(MSE_SAMPLES) + ' --headless')
+        lines = output.split(sep='\n')
+        mse, psnr, ssim = lines[lines.index("-----EVALUATION RESULTS-----") + 2].split(sep=' ')
+
+        print("Metrics for", k, "heuristic are: MSE", mse, "PSNR", psnr, "SSIM", ssim, "\n")
+
+
 def evaluate_mse():
     print("----MSE Evaluation----")
 
@@ -245,6 +256,7 @@ def main():
 
     evaluate_samples()
     evaluate_cameras()
+    evaluate_metrics()
     evaluate_mse()
 
 if __name__ == "__main__":
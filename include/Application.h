@@ -16,7 +16,10 @@
 #include <fstream>
 #include <array>
 #include <memory>
-#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <map>
 
 // Vulkan
 #include <vulkan/vulkan.h>
@@ -52,6 +55,7 @@
 #include "Renderer.h"
 #include "Model.h"
 #include "Scene.h"
+#include "GeometryArena.h"
 #include "Camera.h"
 #include "View.h"
 #include "ViewGrid.h"
@@ -60,6 +64,9 @@
 namespace vke
 {
 
+struct BenchmarkCase;
+struct BenchmarkFrame;
+
 class Application
 {
 public:
@@ -85,6 +92,14 @@ public:
         int numberOfSamples = 170;
         bool mseGt = false;
         int numberOfFrames = 1;
+        bool headless = false;
+        int quality = 100;
+        // the MSE evaluation writes the compared images, it only computes the metrics otherwise
+        bool dumpImages = false;
+        // the metrics computed on the CPU from the images copied to the host
+        bool cpuMetrics = false;
+        // written into PROFILE_FILES_LOC on exit
+        std::string traceFile;
     };
 
     Application(const Arguments& arguments);
@@ -96,6 +111,16 @@ public:
      */
     void run();
 
+    /**
+     * @brief Renders the novel view of a benchmark case headless, the scene stays loaded
+     * between the cases.
+     * 
+     * @param benchCase 
+     * @param frames Timings of the measured frames.
+     * @return int Number of the views of the grid.
+     */
+    int runBenchmarkCase(const BenchmarkCase& benchCase, std::vector<BenchmarkFrame>& frames);
+
     bool framebufferResized = false;
 private:
     /**
@@ -110,6 +135,26 @@ private:
      */
     void draw();
 
+    /**
+     * @brief Draw the frames without windows, swapchains and ImGui. Only the
+     *        offscreen framebuffers and the novel view image are rendered.
+     * 
+     */
+    void drawHeadless();
+
+    /**
+     * @brief Draws one headless frame.
+     * 
+     */
+    void drawHeadlessFrame();
+
+    /**
+     * @brief Adds or removes whole rows and columns of the view grid until it has the size.
+     * 
+     * @param gridSize Columns and rows.
+     */
+    void resizeViewGrid(const glm::ivec2& gridSize);
+
     /**
      * @brief Render the views before the normal render loop starts.
      *        so that the novel view can be rendered right away.
@@ -117,6 +162,32 @@ private:
      */
     void renderViewMatrix(std::shared_ptr<ViewGrid> grid, std::shared_ptr<Framebuffer> framebuffer, bool novelView);
 
+    /**
+     * @brief Renders again only the views of the view matrix which changed since they were
+     *        rendered, all of them when the scene content changed.
+     * 
+     */
+    void updateViewMatrix();
+
+    /**
+     * @brief Records the screenshot and the image copies of the MSE evaluation into the graphics
+     *        command buffer of the frame, the images are saved by the readback workers.
+     * 
+     */
+    void recordReadbacks();
+
+    /**
+     * @brief Reads the metrics of the novel view of the MSE evaluation computed on the GPU.
+     * 
+     */
+    void evaluateMseFrame();
+
+    /**
+     * @brief Waits for the frames in flight and prints the mean metrics of the camera path.
+     * 
+     */
+    void printMetricsResults();
+
     /**
      * @brief Consumes the user input.
      * 
@@ -138,6 +209,13 @@ private:
      */
     void renderImgui(int lastFps);
 
+    /**
+     * @brief Writes the CPU and GPU zones traced so far into PROFILE_FILES_LOC.
+     * 
+     * @param filename 
+     */
+    void saveTrace(const std::string& filename);
+
     /**
      * @brief Performs clean up after managed resources.
      * 
@@ -164,8 +242,22 @@ private:
 
     void countFps(int& frames, int& lastFps, double& lastTime);
 
+    /**
+     * @brief Get the time since the start of the application, GLFW is not available headless.
+     * 
+     * @return double Time in seconds.
+     */
+    double getTime() const;
+
     void handleGuiInputChanges();
 
+    /**
+     * @brief Destroys the views removed from the grid once no frame in flight uses them.
+     * 
+     * @param views Removed views.
+     */
+    void retireViews(const std::vector<std::shared_ptr<View>>& views);
+
     bool handlePrepareResult(WindowParams &params, glm::vec2& windowResolution,
         glm::vec2& secondaryWindowResolution);
 
@@ -181,23 +273,22 @@ private:
     std::shared_ptr<Model> m_light;
 
     std::vector<std::shared_ptr<Model>> m_models;
-    std::vector<Vertex> m_vertices;
-    std::vector<uint32_t> m_indices;
+    std::shared_ptr<GeometryArena> m_geometry;
     
     std::shared_ptr<ViewGrid> m_novelViewGrid;
     std::shared_ptr<ViewGrid> m_viewGrid;
     std::shared_ptr<Model> m_cameraCube;
 
-    std::shared_ptr<Image> m_viewMatrixScreenshotImage;
-    std::shared_ptr<Image> m_novelViewScreenshotImage;
-    std::shared_ptr<Image> m_actualViewScreenshotImage;
-
     // Application argument + evaluate members
     Arguments m_args;
+    std::chrono::steady_clock::time_point m_startTime;
     bool m_terminate = false;
     bool m_evaluate = false;
     int m_evaluateFrames = 0;
     float m_evaluateTotalDuration = 0;
+    // evaluation zones the profiler read in the last frame, of the frame MAX_FRAMES_IN_FLIGHT before it
+    float m_lastComputeDuration = 0;
+    float m_lastGraphicsDuration = 0;
     std::vector<float> m_evalResults;
     int m_evaluateSteps = 0;
     int m_evaluateTotalMseSteps = 0;
@@ -207,6 +298,14 @@ private:
     float m_currentRotation = MSE_ROTATION_ANGLE;
     glm::vec3 m_evaluateOriginalEye;
     glm::vec3 m_evaluateOriginalViewDir;
+    // renders the ground truth of the novel view camera in the same frame and compares them
+    bool m_compareNovelView = false;
+    // metrics of every camera step, the last frame of the step counts
+    std::map<uint32_t, ImageMetrics> m_evalMetrics;
+    // the CPU metrics are written by the readback workers
+    std::mutex m_evalMetricsMutex;
+    // the camera stays for several frames, their images are the same
+    int m_lastReadbackStep = -1;
 
     // Imgui flags and resources.
     float m_prevTime;
@@ -218,6 +317,11 @@ private:
     bool m_renderNovel = false;
     bool m_novelSecondWindow = false;
     bool m_automaticSampleCount = false;
+    bool m_hierarchicalSampling = false;
+    bool m_emptySpaceSkipping = false;
+    bool m_temporalReuse = false;
+    bool m_variableRate = false;
+    float m_novelViewQuality = 1.f;
     int m_numberOfViewsUsed = 4;
     bool m_thresholdDepth = false;
     int m_numberOfRaySamples = 16;
@@ -230,19 +334,21 @@ private:
     float m_viewsFov;
     float m_mainViewFov;
     SamplingType m_samplingType;
-    bool m_reRenderViewMatrix = false;
+    // scene version the view matrix was rendered with
+    uint32_t m_viewMatrixSceneVersion = 0;
     bool m_screenshot = false;
     int m_screenshotSaved = 0;
-    int m_removeRow = MAX_FRAMES_IN_FLIGHT;
-    int m_removeCol = MAX_FRAMES_IN_FLIGHT;
+    bool m_removeRow = false;
+    bool m_removeCol = false;
     bool m_pointClouds = false;
     glm::ivec2 m_pointCloudRes = {POINT_CLOUD_WIDTH, POINT_CLOUD_HEIGHT};
     glm::ivec2 m_sampledView = glm::vec2(0,0);
+    // grid size of the config, the benchmark cases without a grid size are run with it
+    glm::ivec2 m_configGridSize = glm::ivec2(0);
 
-    // threads
-    std::thread m_saveImageThread;
-    bool m_imagesSaved = true;
-    bool m_threadStarted = false;
+    // screenshots saved by the readback workers, and the count already shown
+    std::atomic<uint32_t> m_screenshotsWritten{ 0 };
+    uint32_t m_screenshotsShown = 0;
     
     // Parsed config file.
     utils::Config m_config;
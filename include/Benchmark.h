@@ -0,0 +1,96 @@
+/**
+ * @file Benchmark.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Sweeps of the novel view evaluation run in one process.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include "glm_include_unified.h"
+#include "utils/Structs.h"
+
+#include <string>
+#include <vector>
+
+namespace vke
+{
+
+/**
+ * @brief One combination of the parameters of a sweep.
+ */
+struct BenchmarkCase
+{
+    std::string sweep;
+    glm::ivec2 gridSize;
+    int raySamples;
+    // 0 uses all the views of the grid
+    int maxViewsUsed;
+    SamplingType samplingType;
+    glm::ivec2 resolution;
+    int warmupFrames;
+    int measuredFrames;
+};
+
+/**
+ * @brief Timings of one measured frame, in milliseconds.
+ */
+struct BenchmarkFrame
+{
+    float cpu;
+    float gpuCompute;
+    float gpuGraphics;
+};
+
+struct BenchmarkResult
+{
+    BenchmarkCase benchCase;
+    // views of the grid after the resize, grids not defined by steps cannot be resized
+    int viewCount;
+    std::vector<BenchmarkFrame> frames;
+};
+
+/**
+ * @brief Expands the sweeps of a JSON file into the cartesian products of their parameters and
+ * runs them headless. The scene is loaded once per resolution, the other parameters change
+ * between the cases of the same application.
+ *
+ * {
+ *     "config": "by_step/config.json",
+ *     "warmupFrames": 10,
+ *     "measuredFrames": 50,
+ *     "sweeps": [
+ *         {
+ *             "name": "cameras",
+ *             "gridSizes": [[2, 2], [3, 2]],
+ *             "raySamples": [32],
+ *             "maxViewsUsed": [0],
+ *             "samplingTypes": ["c", "d", "da"],
+ *             "resolutions": [[960, 540]]
+ *         }
+ *     ]
+ * }
+ */
+class Benchmark
+{
+public:
+    Benchmark(const std::string& sweepFile);
+    ~Benchmark();
+
+    void run();
+
+    void saveResults(const std::string& filename) const;
+
+    const std::vector<BenchmarkCase>& getCases() const;
+
+private:
+    void parseSweeps(const std::string& sweepFile);
+
+    std::string m_configFile;
+    std::vector<BenchmarkCase> m_cases;
+    std::vector<BenchmarkResult> m_results;
+};
+
+}
\ No newline at end of file
@@ -10,6 +10,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "MemoryAllocator.h"
+
 #include <memory>
 
 namespace vke
@@ -41,7 +43,7 @@ private:
     std::shared_ptr<Device> m_device;
 
     VkBuffer m_buffer;
-    VkDeviceMemory m_bufferMemory;
+    MemoryAllocation m_allocation;
     VkDeviceSize m_size;
     VkBufferUsageFlags m_usage;
     VkMemoryPropertyFlags m_properties;
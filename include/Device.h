@@ -44,6 +44,7 @@ namespace vke
 
 class Buffer;
 class Image;
+class MemoryAllocator;
 
 class Device
 {
@@ -51,7 +52,8 @@ public:
     /**
      * @brief Construct a new Device object.
      * 
-     * @param window Window which will be used for rendering.
+     * @param window Window which will be used for rendering. When nullptr is passed
+     *               the device is created headless, without a surface and swapchain support.
      */
     Device(std::shared_ptr<Window> window);
     ~Device();
@@ -66,12 +68,30 @@ public:
     VkDevice getVkDevice() const;
     VkInstance getInstance() const;
     VkCommandPool getCommandPool() const;
+    VkCommandPool getComputeCommandPool() const;
     VkQueue getGraphicsQueue() const;
     VkQueue getPresentQueue() const;
     VkQueue getComputeQueue() const;
     VkPhysicalDevice getPhysicalDevice() const;
     VkPhysicalDeviceFeatures getFeatures() const;
     VkFormat getDepthFormat() const;
+    bool isHeadless() const;
+    uint32_t getGraphicsFamily() const;
+    uint32_t getComputeFamily() const;
+
+    /**
+     * @brief Whether the compute queue comes from a separate compute only family.
+     */
+    bool hasAsyncCompute() const;
+
+    /**
+     * @brief Sharing mode of the buffers and images used by both the graphics and the compute queue.
+     * 
+     * @param queueFamilies Filled with the families of the concurrent sharing, empty otherwise.
+     * @return VkSharingMode 
+     */
+    VkSharingMode getSharingMode(std::vector<uint32_t>& queueFamilies) const;
+    std::shared_ptr<MemoryAllocator> getAllocator() const;
 
     /**
      * @brief Finds physical device memory type.
@@ -139,10 +159,13 @@ public:
      * @param imgAspectFlags 
      * @param srcStage Source pipeline stage. 
      * @param dstStage Destination pipeline stage.
+     * @param srcFamily Queue family releasing the image, for ownership transfers.
+     * @param dstFamily Queue family acquiring the image, for ownership transfers.
      */
     void createImageBarrier(VkCommandBuffer commandBuffer, VkAccessFlags src, VkAccessFlags dst, VkImageLayout oldL, VkImageLayout newL,
         VkImage image, VkImageAspectFlags imgAspectFlags, VkPipelineStageFlags srcStage,
-        VkPipelineStageFlags dstStage);
+        VkPipelineStageFlags dstStage, uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED,
+        uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED);
 
     /**
      * @brief Creates a memory barrier.
@@ -196,9 +219,12 @@ private:
     VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
     VkDevice m_device;
     VkCommandPool m_commandPool;
+    VkCommandPool m_computeCommandPool;
     VkPhysicalDeviceFeatures m_features;
     VkFormat m_depthFormat;
 
+    std::shared_ptr<MemoryAllocator> m_allocator;
+
     VkQueue m_graphicsQueue;
     VkQueue m_presentQueue;
     VkQueue m_computeQueue;
@@ -206,6 +232,7 @@ private:
     QueueFamilyIndices m_familyIndices;
 
     bool m_enableValidationLayers = true;
+    bool m_headless = false;
 
     const std::vector<const char*> m_validationLayers = {
         "VK_LAYER_KHRONOS_validation" 
@@ -0,0 +1,149 @@
+/**
+ * @file FrameScheduler.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Orders the submissions of the frame by timeline semaphores.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace vke
+{
+
+class Device;
+
+enum class QueueType
+{
+    GRAPHICS,
+    COMPUTE,
+    COUNT
+};
+
+/**
+ * @brief Passes of the frame, cull -> view matrix render -> ray evaluation -> quad.
+ */
+enum class FrameStage
+{
+    CULL,
+    VIEW_MATRIX,
+    RAY_EVAL,
+    QUAD,
+    COUNT
+};
+
+/**
+ * @brief Value of the timeline of a queue, reached once the submission signaling it finished.
+ * The zero value of every timeline is reached from the start.
+ */
+struct SchedulePoint
+{
+    QueueType queue = QueueType::GRAPHICS;
+    uint64_t value = 0;
+};
+
+/**
+ * @brief The stages of the submission which wait for the point.
+ */
+struct ScheduleDependency
+{
+    SchedulePoint point;
+    VkPipelineStageFlags stages;
+};
+
+/**
+ * @brief Last finished submission of a stage, as observed by the CPU.
+ */
+struct StageTiming
+{
+    uint64_t value = 0;
+    // time between the submission and the observed completion, in milliseconds
+    float latency = 0.f;
+    std::chrono::steady_clock::time_point completed;
+};
+
+/**
+ * @brief Every queue signals its own timeline semaphore with a monotonically increasing value
+ * on each submission. Submissions depend on the points of the other submissions instead of
+ * binary semaphores and fences, so a point can be waited for by any number of later
+ * submissions and by the CPU, and waits for already reached points are dropped.
+ * The swapchain acquire and present still use binary semaphores.
+ */
+class FrameScheduler
+{
+public:
+    FrameScheduler(std::shared_ptr<Device> device);
+    ~FrameScheduler();
+
+    void destroyVkResources();
+
+    /**
+     * @brief Submits the command buffer to the queue and signals the next point of its timeline.
+     *
+     * @param queue
+     * @param stage Stage whose completion time is recorded.
+     * @param commandBuffer
+     * @param dependencies Points of the timelines waited for.
+     * @param waitSemaphores Binary semaphores waited for, the swapchain images.
+     * @param waitStages Stages waiting for the binary semaphores.
+     * @param signalSemaphores Binary semaphores signaled, the presents.
+     * @return SchedulePoint Point reached when the submission finishes.
+     */
+    SchedulePoint submit(QueueType queue, FrameStage stage, VkCommandBuffer commandBuffer,
+        const std::vector<ScheduleDependency>& dependencies, const std::vector<VkSemaphore>& waitSemaphores = {},
+        const std::vector<VkPipelineStageFlags>& waitStages = {}, const std::vector<VkSemaphore>& signalSemaphores = {});
+
+    /**
+     * @brief Blocks the CPU until all the points are reached.
+     *
+     * @param points
+     */
+    void wait(const std::vector<SchedulePoint>& points);
+
+    /**
+     * @brief Blocks the CPU until every submission finished.
+     */
+    void waitIdle();
+
+    bool isReached(const SchedulePoint& point);
+
+    /**
+     * @brief Records the completion time of the submissions finished since the last call.
+     */
+    void collectTimings();
+
+    SchedulePoint getLastPoint(QueueType queue) const;
+    const StageTiming& getStageTiming(FrameStage stage) const;
+
+private:
+    struct PendingStage
+    {
+        FrameStage stage;
+        SchedulePoint point;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    uint64_t getCompletedValue(QueueType queue);
+    VkQueue getQueue(QueueType queue) const;
+
+    std::shared_ptr<Device> m_device;
+
+    std::array<VkSemaphore, static_cast<size_t>(QueueType::COUNT)> m_timelines;
+    std::array<uint64_t, static_cast<size_t>(QueueType::COUNT)> m_submittedValues;
+    std::array<uint64_t, static_cast<size_t>(QueueType::COUNT)> m_completedValues;
+
+    std::deque<PendingStage> m_pendingStages;
+    std::array<StageTiming, static_cast<size_t>(FrameStage::COUNT)> m_stageTimings;
+};
+
+}
\ No newline at end of file
@@ -50,6 +50,7 @@ public:
     std::shared_ptr<Sampler> getSampler() const;
     VkImageView getColorImageView() const;
     std::shared_ptr<Image> getColorImage() const; 
+    std::shared_ptr<Image> getDepthImage() const;
     VkDescriptorImageInfo getColorImageInfo();
     VkDescriptorImageInfo getDepthImageInfo();
     VkExtent2D getResolution() const;
@@ -0,0 +1,96 @@
+/**
+ * @file GeometryArena.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Single owner of the host geometry of the scene.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include "utils/Structs.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vke
+{
+
+/**
+ * @brief Vertices and indices of all the imported models in the order of the model imports.
+ * Meshes only keep their ranges in the arena (Mesh::MeshInfo), which are the same as the ranges
+ * in the scene vertex and index buffers. The geometry is not copied, every model keeps pointing
+ * into the storage it was loaded into, e.g. the mapped scene cache, which is kept alive until
+ * the arena is released after the upload. The counts stay valid after the release.
+ */
+class GeometryArena
+{
+public:
+    GeometryArena();
+
+    /**
+     * @brief Appends the geometry of one model without copying it.
+     *
+     * @param owner Keeps the vertices and indices alive until the release.
+     * @param vertices
+     * @param vertexCount
+     * @param indices Indices relative to the model vertices.
+     * @param indexCount
+     */
+    void append(std::shared_ptr<const void> owner, const Vertex* vertices, uint32_t vertexCount,
+        const uint32_t* indices, uint32_t indexCount);
+
+    /**
+     * @brief Drops the references to the geometry of the models.
+     */
+    void release();
+
+    /**
+     * @brief Vertices of the model starting at the arena vertex, ranges of meshes never cross models.
+     *
+     * @param firstVertex
+     * @return const Vertex*
+     */
+    const Vertex* getVertices(uint32_t firstVertex) const;
+
+    /**
+     * @brief Copies all the vertices contiguously, e.g. into a staging buffer.
+     *
+     * @param dst Room for getVertexCount() vertices.
+     */
+    void copyVertices(Vertex* dst) const;
+
+    /**
+     * @brief Copies all the indices contiguously, e.g. into a staging buffer.
+     *
+     * @param dst Room for getIndexCount() indices.
+     */
+    void copyIndices(uint32_t* dst) const;
+
+    uint32_t getVertexCount() const;
+    uint32_t getIndexCount() const;
+    bool isReleased() const;
+
+private:
+    struct Chunk
+    {
+        std::shared_ptr<const void> owner;
+        const Vertex* vertices;
+        uint32_t vertexCount;
+        const uint32_t* indices;
+        uint32_t indexCount;
+        uint32_t firstVertex;
+    };
+
+    void checkReleased() const;
+
+    std::vector<Chunk> m_chunks;
+
+    uint32_t m_vertexCount;
+    uint32_t m_indexCount;
+    bool m_released;
+};
+
+}
\ No newline at end of file
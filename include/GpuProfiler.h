@@ -0,0 +1,150 @@
+/**
+ * @file GpuProfiler.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Named GPU timestamp zones of the passes.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "FrameScheduler.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vke
+{
+
+class Device;
+
+/**
+ * @brief Rolling statistics of a zone over its last samples, in milliseconds.
+ */
+struct GpuZoneStats
+{
+    std::string name;
+    uint32_t samples = 0;
+    float last = 0.f;
+    float mean = 0.f;
+    float p50 = 0.f;
+    float p95 = 0.f;
+    float p99 = 0.f;
+};
+
+/**
+ * @brief Sum of the samples of a zone, in milliseconds, over any number of frames.
+ */
+struct GpuZoneTotal
+{
+    float duration = 0.f;
+    uint32_t samples = 0;
+};
+
+/**
+ * @brief Every recorded command buffer takes the next timestamp pool of a ring and writes a
+ * pair of timestamps per zone into it. The results of a pool are read once the GPU made them
+ * available, the ring is longer than the number of command buffers in flight, so the read never
+ * waits. Zones of the same name are accumulated into rolling statistics and added to the CPU
+ * trace, placed by a timestamp calibrated against the CPU clock at the start.
+ */
+class GpuProfiler
+{
+public:
+    static constexpr uint32_t POOL_COUNT = 8;
+    static constexpr uint32_t MAX_ZONES = 32;
+    static constexpr uint32_t WINDOW_SIZE = 256;
+
+    GpuProfiler(std::shared_ptr<Device> device);
+    ~GpuProfiler();
+
+    void destroyVkResources();
+
+    /**
+     * @brief Reads the finished pools and takes the next pool for the command buffer. Has to be
+     * called after the command buffer began.
+     *
+     * @param commandBuffer
+     * @param queue Queue the command buffer is submitted to, some compute queues lack timestamps.
+     */
+    void beginCommandBuffer(VkCommandBuffer commandBuffer, QueueType queue);
+
+    /**
+     * @brief Zones may be nested, they are closed in the reversed order.
+     *
+     * @param commandBuffer
+     * @param name
+     */
+    void beginZone(VkCommandBuffer commandBuffer, const std::string& name);
+    void endZone(VkCommandBuffer commandBuffer);
+
+    /**
+     * @brief Reads the results of the pools, which the GPU already finished, without waiting.
+     */
+    void collect();
+
+    std::vector<GpuZoneStats> getStats() const;
+
+    /**
+     * @brief Sum of the samples of the zone read since the last call, for the averages over
+     * more frames than the window.
+     *
+     * @param name
+     * @return GpuZoneTotal
+     */
+    GpuZoneTotal takeTotal(const std::string& name);
+
+    void exportCsv(const std::string& filename) const;
+    void exportJson(const std::string& filename) const;
+
+private:
+    struct Zone
+    {
+        std::string name;
+        uint32_t startQuery;
+        uint32_t endQuery;
+    };
+
+    struct PoolRecording
+    {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        std::vector<Zone> zones;
+        std::vector<uint32_t> openZones;
+        uint32_t queryCount = 0;
+        QueueType queue = QueueType::GRAPHICS;
+        bool pending = false;
+    };
+
+    void calibrate();
+    bool readPool(PoolRecording& recording, bool wait);
+    const char* addSample(const std::string& name, float duration);
+
+    std::shared_ptr<Device> m_device;
+
+    float m_timestampPeriod = 1.f;
+    bool m_computeTimestamps = false;
+    bool m_graphicsTimestamps = false;
+
+    // GPU timestamp and utils::traceNow at the same moment, approximately
+    bool m_calibrated = false;
+    uint64_t m_calibrationTicks = 0;
+    int64_t m_calibrationTime = 0;
+
+    std::vector<PoolRecording> m_pools;
+    uint32_t m_nextPool = 0;
+    std::unordered_map<VkCommandBuffer, uint32_t> m_recordings;
+
+    // ordered by the name, so the panel and the exports are stable
+    std::map<std::string, std::deque<float>> m_samples;
+    std::unordered_map<std::string, GpuZoneTotal> m_totals;
+};
+
+}
\ No newline at end of file
@@ -14,6 +14,9 @@
 // glm
 #include "glm_include_unified.h"
 
+// vke
+#include "MemoryAllocator.h"
+
 // std
 #include <memory>
 
@@ -35,9 +38,12 @@ public:
      * @param usage 
      * @param properties 
      * @param initialLayout 
+     * @param concurrent Shares the image between the graphics and the compute queue families,
+     *                   images without it need ownership transfers between the queues.
      */
     Image(std::shared_ptr<Device> device, glm::vec2 dims, VkFormat format, VkImageTiling tiling,
-        VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+        VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        bool concurrent = false);
     ~Image();
 
     void destroyVkResources();
@@ -69,6 +75,13 @@ public:
     VkFormat getVkFormat() const;
     glm::vec2 getDims() const;
     void* getMapped();
+
+    /**
+     * @brief Set the layout after a transition recorded by the caller.
+     * 
+     * @param layout 
+     */
+    void setVkImageLayout(VkImageLayout layout);
     
 private:
     glm::vec2 m_dims;
@@ -76,7 +89,7 @@ private:
     std::shared_ptr<Device> m_device;
 
     VkImage m_image;
-    VkDeviceMemory m_imageMemory;
+    MemoryAllocation m_allocation;
     VkFormat m_format;
     VkImageTiling m_tiling;
     VkImageUsageFlags m_usage;
@@ -0,0 +1,170 @@
+/**
+ * @file ImageReadback.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Asynchronous readback of images into host memory for screenshots and frame dumps.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "glm_include_unified.h"
+
+#include "FrameScheduler.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vke
+{
+
+class Buffer;
+class Image;
+
+/**
+ * @brief RGBA8 pixels of one image of the readback, only valid during the job.
+ */
+struct ReadbackImage
+{
+    uint8_t* data;
+    // W * H data, z coordinate is the number of channels
+    glm::ivec3 dims;
+};
+
+/**
+ * @brief Run on a worker thread with the images in the order they were requested.
+ */
+using ReadbackJob = std::function<void(const std::vector<ReadbackImage>& images)>;
+
+/**
+ * @brief Ring of persistently mapped host buffers. The copies of the images are recorded into
+ * the command buffer of the frame, so nothing is submitted or waited for on its own. Every slot
+ * is tagged with the timeline point of the submission which copies into it, the finished slots
+ * are handed to a fixed pool of workers over lock-free single producer single consumer queues,
+ * and the workers give the slots back once their jobs are done. Idle workers and the render
+ * thread waiting for a slot sleep on condition variables.
+ * The render thread only blocks when every slot is taken, when the jobs are slower than the
+ * frames for longer than the ring covers.
+ */
+class ImageReadback
+{
+public:
+    static constexpr uint32_t SLOT_COUNT = 8;
+
+    /**
+     * @brief Construct a new Image Readback object.
+     *
+     * @param device
+     * @param scheduler Scheduler of the submissions the copies are recorded into.
+     * @param workerCount Number of the worker threads.
+     */
+    ImageReadback(std::shared_ptr<Device> device, std::shared_ptr<FrameScheduler> scheduler, uint32_t workerCount = 2);
+    ~ImageReadback();
+
+    ImageReadback(const ImageReadback&) = delete;
+    ImageReadback& operator=(const ImageReadback&) = delete;
+
+    /**
+     * @brief Finishes the pending jobs, stops the workers and destroys the buffers.
+     */
+    void destroyVkResources();
+
+    /**
+     * @brief Records the copies of the RGBA8 images into one slot. The images are moved to the
+     * transfer layout and back to the layout they are tracked with.
+     *
+     * @param commandBuffer Command buffer of the frame, submitted by the next call to submit.
+     * @param images
+     * @param srcStages Stages which last accessed the images in the command buffer.
+     * @param srcAccess Writes to the images, which have to be finished before the copy.
+     * @param job Run once the copies finished.
+     */
+    void copyImages(VkCommandBuffer commandBuffer, const std::vector<std::shared_ptr<Image>>& images,
+        VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, ReadbackJob job);
+
+    /**
+     * @brief Tags the slots recorded since the last call with the point of their submission.
+     *
+     * @param point
+     */
+    void submit(const SchedulePoint& point);
+
+    /**
+     * @brief Hands the slots, whose copies already finished, to the workers without waiting.
+     */
+    void collect();
+
+    /**
+     * @brief Blocks until every submitted copy finished and all the jobs are done.
+     */
+    void flush();
+
+private:
+    enum class SlotState : uint32_t
+    {
+        FREE,
+        RECORDED,
+        SUBMITTED,
+        PROCESSING
+    };
+
+    struct Slot
+    {
+        std::unique_ptr<Buffer> buffer;
+        std::vector<ReadbackImage> images;
+        ReadbackJob job;
+        SchedulePoint point;
+        std::atomic<SlotState> state{ SlotState::FREE };
+    };
+
+    /**
+     * @brief Bounded queue of slot indices, pushed by the render thread and popped by one
+     * worker. Every slot is in at most one queue, so it never overflows. The mutex is only
+     * taken to sleep and to wake the worker, never by push and pop.
+     */
+    struct WorkQueue
+    {
+        std::array<uint32_t, SLOT_COUNT + 1> slots;
+        std::atomic<uint32_t> head{ 0 };
+        std::atomic<uint32_t> tail{ 0 };
+
+        std::mutex mutex;
+        std::condition_variable condition;
+
+        bool push(uint32_t slot);
+        bool pop(uint32_t& slot);
+        bool empty() const;
+    };
+
+    uint32_t acquireSlot();
+    void stopWorkers();
+    void workerLoop(uint32_t workerId);
+
+    std::shared_ptr<Device> m_device;
+    std::shared_ptr<FrameScheduler> m_scheduler;
+
+    std::array<Slot, SLOT_COUNT> m_slots;
+    uint32_t m_nextSlot = 0;
+    uint32_t m_nextWorker = 0;
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_stop{ false };
+    bool m_destroyed = false;
+
+    // signalled by the workers whenever a slot is freed
+    std::mutex m_freedMutex;
+    std::condition_variable m_freedCondition;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+/**
+ * @file MemoryAllocator.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Sub-allocation of the device memory.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vke
+{
+
+/**
+ * @brief Part of a memory block owned by a buffer or an image.
+ */
+struct MemoryAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // persistent mapping of the host visible memory, already offset
+    void* mapped = nullptr;
+
+    uint32_t memoryType = 0;
+    bool linear = true;
+    bool dedicated = false;
+};
+
+/**
+ * @brief Allocates big blocks of device memory per memory type and places the buffers and
+ * images into them. Linear resources (buffers, linear images) and optimal images never share
+ * a block, so bufferImageGranularity does not have to be considered. Host visible blocks are
+ * mapped for their whole lifetime. Resources bigger than half of a block get their own
+ * dedicated allocation.
+ */
+class MemoryAllocator
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    struct Stats
+    {
+        // device memory allocated from the driver
+        VkDeviceSize reservedBytes;
+        // bytes given out to the resources
+        VkDeviceSize usedBytes;
+        // free bytes outside of the largest free range of each block
+        VkDeviceSize fragmentedBytes;
+        uint32_t blockCount;
+        uint32_t allocationCount;
+        uint32_t deviceAllocationCount;
+    };
+
+    MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    /**
+     * @brief Frees all the blocks, has to be called before the device is destroyed.
+     */
+    void destroyVkResources();
+
+    /**
+     * @brief Finds place for the resource.
+     *
+     * @param requirements Memory requirements of the resource.
+     * @param properties Required memory properties.
+     * @param linear False for optimal tiling images.
+     * @return MemoryAllocation
+     */
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+
+    /**
+     * @brief Returns the allocation to its block.
+     *
+     * @param allocation
+     */
+    void free(const MemoryAllocation& allocation);
+
+    Stats getStats() const;
+
+    /**
+     * @brief Finds physical device memory type.
+     *
+     * @param typeFilter
+     * @param properties
+     * @return uint32_t
+     */
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+    struct Block
+    {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        VkDeviceSize used;
+        uint32_t allocationCount;
+        char* mapped;
+        // offset -> size, neighbouring ranges are always merged
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    };
+
+    struct Pool
+    {
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+    bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    void freeInBlock(Block& block, VkDeviceSize offset, VkDeviceSize size);
+    Pool& getPool(uint32_t memoryType, bool linear);
+
+    VkDevice m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    VkDeviceSize m_blockSize;
+
+    // two pools for each memory type, [type * 2 + linear]
+    std::vector<Pool> m_pools;
+
+    VkDeviceSize m_dedicatedBytes;
+    uint32_t m_dedicatedCount;
+    uint32_t m_allocationCount;
+
+    mutable std::mutex m_mutex;
+};
+
+}
\ No newline at end of file
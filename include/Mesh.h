@@ -50,16 +50,15 @@ public:
         uint32_t indexCount;
         uint32_t firstIndex;
         uint32_t vertexOffset;
+        uint32_t vertexCount;
     };
 
     /**
-     * @brief Construct a new Mesh object.
+     * @brief Construct a new Mesh object. The geometry itself is owned by the GeometryArena.
      * 
-     * @param vertices Vertices of the mesh.
-     * @param indices Indices of the mesh.
-     * @param info Info about the mesh for indirect rendering.
+     * @param info Range of the mesh in the scene geometry, used for indirect rendering.
      */
-    Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, MeshInfo info);
+    Mesh(MeshInfo info);
     ~Mesh();
 
     /**
@@ -96,15 +95,17 @@ public:
     void setTransform(const glm::mat4& matrix);
     void setMaterial(std::shared_ptr<Material> material);
     void setBbProperties(const glm::vec3& center, float radius);
+    void setPositionQuantization(const glm::vec3& offset, const glm::vec3& scale);
 
     // Getters
     std::shared_ptr<Material> getMaterial() const;
+    const MeshInfo& getMeshInfo() const;
     glm::vec3 getBbCenter() const;
     float getBbRadius() const;
+    glm::vec3 getPositionOffset() const;
+    glm::vec3 getPositionScale() const;
     uint32_t getDrawId() const;
 
-    std::vector<Vertex> m_vertices;
-    std::vector<uint32_t> m_indices;
 private:
     /**
      * @brief Create and assign texture.
@@ -127,6 +128,10 @@ private:
     glm::vec3 m_bbCenter;
     float m_bbRadius;
 
+    // dequantization of the packed vertex positions
+    glm::vec3 m_positionOffset;
+    glm::vec3 m_positionScale;
+
     glm::mat4 m_modelMatrix;
     
     std::shared_ptr<Material> m_material;
@@ -0,0 +1,81 @@
+/**
+ * @file MeshBvh.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Bounding volume hierarchy over the mesh bounding spheres used for culling.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include "utils/Structs.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace vke
+{
+
+/**
+ * @brief Binary AABB tree over the world space bounding spheres of the culled meshes, in the
+ * draw order of the scene. Children of a node are stored next to each other and the primitives
+ * of every subtree form a contiguous range of the primitive list, so a rejected or fully visible
+ * subtree is resolved without visiting it. The tree is cut into task roots, the GPU culling
+ * traverses one task root per thread.
+ */
+class MeshBvh
+{
+public:
+    enum class Visibility
+    {
+        OUTSIDE,
+        INTERSECTING,
+        INSIDE
+    };
+
+    MeshBvh();
+
+    /**
+     * @brief Builds the tree by median splits along the longest axis of the centroid bounds.
+     *
+     * @param spheres Bounding spheres (center, radius), the index is the draw id.
+     */
+    void build(const std::vector<glm::vec4>& spheres);
+
+    /**
+     * @brief CPU traversal of the tree.
+     *
+     * @param frustumPlanes
+     * @param visible Draw ids of the meshes inside the frustum, in traversal order.
+     */
+    void cull(const std::vector<glm::vec4>& frustumPlanes, std::vector<uint32_t>& visible) const;
+
+    /**
+     * @brief Classifies the box against the frustum planes.
+     *
+     * @param aabbMin
+     * @param aabbMax
+     * @param frustumPlanes
+     * @return Visibility
+     */
+    static Visibility classify(const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+        const std::vector<glm::vec4>& frustumPlanes);
+
+    const std::vector<BvhNodeCompute>& getNodes() const;
+    const std::vector<uint32_t>& getPrimitives() const;
+    const std::vector<uint32_t>& getTasks() const;
+    uint32_t getDepth() const;
+
+private:
+    void buildNode(uint32_t nodeId, uint32_t depth);
+    void createTasks();
+
+    std::vector<glm::vec4> m_spheres;
+    std::vector<BvhNodeCompute> m_nodes;
+    std::vector<uint32_t> m_primitives;
+    std::vector<uint32_t> m_tasks;
+    uint32_t m_depth;
+};
+
+}
\ No newline at end of file
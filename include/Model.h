@@ -40,6 +40,7 @@ public:
 
     // Getters
     std::vector<std::shared_ptr<Mesh>> getMeshes() const;
+    std::vector<std::shared_ptr<Mesh>> getTransparentMeshes() const;
     size_t getMeshesCount() const;
     size_t getTransparentMeshesCount() const;
 
@@ -26,9 +26,11 @@ public:
      * @param colorFormat Format of the color attachement.
      * @param depthFormat Format of the depth attachement.
      * @param offscreen Whether or not the render pass is offscreen.
+     * @param load Whether the offscreen attachments keep their content, so only parts of them
+     *        can be rendered again. Compatible with the clearing variant.
      */
     RenderPass(std::shared_ptr<Device> device, VkFormat colorFormat, VkFormat depthFormat,
-        bool offscreen = false);
+        bool offscreen = false, bool load = false);
     ~RenderPass();
 
     void destroyVkResources();
@@ -45,6 +47,7 @@ private:
     VkFormat m_depthFormat;
 
     bool m_offscreen;
+    bool m_load;
 
     VkRenderPass m_renderPass;
 };
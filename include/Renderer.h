@@ -14,12 +14,18 @@
 
 // std
 #include <unordered_map>
+#include <deque>
+#include <functional>
 
 // vke
 #include "Device.h"
 #include "SwapChain.h"
 #include "Texture.h"
 #include "Buffer.h"
+#include "FrameScheduler.h"
+#include "GpuProfiler.h"
+#include "ImageReadback.h"
+#include "utils/ImageMetrics.h"
 
 namespace vke
 {
@@ -39,6 +45,16 @@ class Framebuffer;
 class Image;
 class Sampler;
 
+/**
+ * @brief Images of the frame, which can be read back into host memory.
+ */
+enum class ReadbackSource
+{
+    VIEW_MATRIX,
+    OFFSCREEN,
+    NOVEL_VIEW
+};
+
 class Renderer
 {
 public:
@@ -46,7 +62,7 @@ public:
      * @brief Construct a new Renderer object.
      * 
      * @param device Vulkan device to be used with the renderer.
-     * @param window Main window for rendering.
+     * @param window Main window for rendering, nullptr for headless rendering.
      * @param params Contains paths to each individual shader needed.
      */
     Renderer(std::shared_ptr<Device> device, std::shared_ptr<Window> window, const RendererInitParams& params);
@@ -70,6 +86,28 @@ public:
     void cullComputePass(const std::shared_ptr<Scene>& scene, const std::shared_ptr<ViewGrid>& viewGrid,
         bool novelViews = false);
 
+    /**
+     * @brief Records the min/max depth pyramid build of every view of the grid into the graphics
+     * command buffer, after the view matrix render pass. The novel view generation uses it to skip
+     * empty parts of the rays.
+     *
+     * @param viewGrid Grid rendered into the view matrix framebuffer.
+     */
+    void depthPyramidPass(const std::shared_ptr<ViewGrid>& viewGrid);
+
+    /**
+     * @brief Renders only the given views of the grid into their tiles of the view matrix and
+     * rebuilds their part of the depth pyramid. The rest of the view matrix is kept. The views are
+     * culled on the CPU and the update is submitted on its own, the next compute pass waits for it
+     * on the GPU, so there is no device wait.
+     *
+     * @param scene Scene to be rendered.
+     * @param viewGrid Grid rendered into the view matrix framebuffer.
+     * @param views Views of the grid to be rendered again.
+     */
+    void updateViewMatrix(const std::shared_ptr<Scene>& scene, const std::shared_ptr<ViewGrid>& viewGrid,
+        const std::vector<std::shared_ptr<View>>& views);
+
     /**
      * @brief Performs the compute pass for novel view generation.
      * 
@@ -100,6 +138,39 @@ public:
      */
     void quadRenderPass(glm::vec2 windowResolution, bool depthOnly = false, bool secondaryWindow = false);
 
+    /**
+     * @brief Compares the novel view of the current frame with the offscreen framebuffer, which
+     * has to contain the ground truth of the same camera. Records the metrics reduction into the
+     * graphics command buffer after both barriers, only a few floats are read back.
+     * 
+     * @param id Returned together with the metrics of the frame.
+     */
+    void metricsPass(uint32_t id);
+
+    /**
+     * @brief Reads the metrics of the finished frames, which were not read yet, without waiting.
+     * All of them are finished after waitForFrames.
+     * 
+     * @return std::vector<std::pair<uint32_t, ImageMetrics>> Ids given to metricsPass with the metrics.
+     */
+    std::vector<std::pair<uint32_t, ImageMetrics>> collectMetrics();
+
+    /**
+     * @brief Copies the images of the current frame into host memory inside its graphics command
+     * buffer, the job gets the pixels on a worker thread once the frame finished. Has to be
+     * recorded outside of a render pass, after the barriers of the images. The novel view is the
+     * one of the current frame, so it has to be acquired by setNovelViewBarrier.
+     * 
+     * @param sources Images passed to the job in this order.
+     * @param job
+     */
+    void readbackImages(const std::vector<ReadbackSource>& sources, ReadbackJob job);
+
+    /**
+     * @brief Blocks until every submitted readback finished and its job is done.
+     */
+    void flushReadbacks();
+
     void pointsRenderPass(const std::shared_ptr<ViewGrid>& mainView, const std::shared_ptr<ViewGrid>& viewGrid,
         const PointCloudParams& pointsParams);
     
@@ -108,16 +179,20 @@ public:
      * 
      * @param viewportStart Starting position of the viewport.
      * @param viewportResolution Resolution of the viewport.
+     * @param commandBuffer Command buffer to record into, the frame command buffer if not set.
      */
-    void setViewport(const glm::vec2& viewportStart, const glm::vec2& viewportResolution);
+    void setViewport(const glm::vec2& viewportStart, const glm::vec2& viewportResolution,
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
 
     /**
      * @brief Set the Scissor.
      * 
      * @param viewportStart Starting position of the viewport.
      * @param viewportResolution Resolution of the viewport.
+     * @param commandBuffer Command buffer to record into, the frame command buffer if not set.
      */
-    void setScissor(const glm::vec2& viewportStart, const glm::vec2& viewportResolution);
+    void setScissor(const glm::vec2& viewportStart, const glm::vec2& viewportResolution,
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
 
     /**
      * @brief Prepares necessary data for render pass.
@@ -149,6 +224,26 @@ public:
     void recordComputeCommandBuffer(VkCommandBuffer commandBuffer, const std::shared_ptr<Scene>& scene,
         const std::shared_ptr<View>& view);
 
+    /**
+     * @brief Records a single culling dispatch for all the views of the grid.
+     * 
+     * @param commandBuffer Command buffer to use.
+     * @param scene Scene.
+     * @param viewGrid Grid whose views are culled.
+     */
+    void recordBatchedComputeCommandBuffer(VkCommandBuffer commandBuffer, const std::shared_ptr<Scene>& scene,
+        const std::shared_ptr<ViewGrid>& viewGrid);
+
+    /**
+     * @brief Records the draw of all the views of the grid as one draw stream.
+     * 
+     * @param commandBuffer Command buffer to use.
+     * @param scene Scene.
+     * @param viewGrid Grid whose views are rendered, has to be culled by the batched culling.
+     */
+    void recordGridCommandBuffer(VkCommandBuffer commandBuffer, const std::shared_ptr<Scene>& scene,
+        const std::shared_ptr<ViewGrid>& viewGrid);
+
     /**
      * @brief Submit the frame for rendering.
      * 
@@ -157,11 +252,27 @@ public:
     void submitFrame(bool secondarySwapchain = false, bool waitForCompute = true);
 
     /**
-     * @brief Submit graphics without using swapchain.
+     * @brief Submit graphics without using swapchain, guarded by the frame fence. Advances
+     *        to the next frame, the next compute submit waits for it.
      * 
      */
     void submitGraphics();
 
+    /**
+     * @brief Prepares a frame which is not presented, waits for the frame fence
+     *        instead of acquiring a swapchain image.
+     * 
+     */
+    void prepareOffscreenFrame();
+
+    /**
+     * @brief Submits the headless frame guarded by the frame fence and advances
+     *        to the next frame, as there is no present.
+     * 
+     * @param waitForCompute Whether to wait for the compute pass of the frame.
+     */
+    void submitOffscreenFrame(bool waitForCompute = true);
+
     /**
      * @brief Submit compute command buffer.
      * 
@@ -183,6 +294,30 @@ public:
      */
     void changeQuadRenderPassSource(VkDescriptorImageInfo imageInfo, bool allFrames = false);
 
+    /**
+     * @brief Change the source image for on screen render pass to the novel view, every frame
+     * in flight samples its own novel view image.
+     * 
+     * @param allFrames 
+     */
+    void changeQuadRenderPassSourceToNovelView(bool allFrames = false);
+
+    /**
+     * @brief Retires resources, which may still be used by the frames in flight. They are
+     * destroyed once those frames reached their timeline points.
+     * 
+     * @param destroy Destroys the resources.
+     */
+    void deferDestroy(std::function<void()> destroy);
+
+    /**
+     * @brief Waits for the frames in flight instead of the whole device.
+     * 
+     * @param allFrames Whether to wait for all the frames or only for the last one using
+     * the resources of the current frame.
+     */
+    void waitForFrames(bool allFrames = true);
+
     /**
      * @brief Copy offscreen frame buffer to the image for pixel testing.
      * 
@@ -220,14 +355,18 @@ public:
     std::shared_ptr<Framebuffer> getQuadFramebuffer() const;
     std::shared_ptr<Framebuffer> getSecondaryQuadFramebuffer() const;
     std::shared_ptr<Framebuffer> getViewMatrixFramebuffer() const;
-    VkDescriptorImageInfo getNovelImageInfo() const;
+    VkDescriptorImageInfo getNovelImageInfo(uint32_t frame) const;
+
+    /**
+     * @brief Novel view image of the last submitted frame.
+     */
     std::shared_ptr<Image> getNovelViewImage() const;
     VkDescriptorImageInfo getTestPixelImageInfo() const;
     SamplingType getNovelViewSamplingType() const;
+    const StageTiming& getStageTiming(FrameStage stage) const;
+    std::shared_ptr<GpuProfiler> getProfiler() const;
 
     // Setters
-    void setSceneChanged(int sceneChanged);
-    void setLightChanged(int lightChanged);
     void setNovelViewSamplingType(SamplingType samplingType);
 
     /**
@@ -282,7 +421,8 @@ public:
     void beginRenderPass(std::shared_ptr<RenderPass> renderPass, std::shared_ptr<Framebuffer> framebuffer);
     
     /**
-     * @brief Set the image barrier for novel view image.
+     * @brief Set the image barrier for novel view image, acquires the image of the current frame
+     * from the compute queue family.
      * 
      */
     void setNovelViewBarrier();
@@ -303,11 +443,14 @@ public:
      */
     void endCommandBuffer();
 
-    float collectQuery(bool compute = false);
-
-    void startQuery(bool compute = false);
-
-    void endQuery(bool compute = false);
+    /**
+     * @brief Named GPU timestamp zone in the command buffer of the current frame.
+     * 
+     * @param name
+     * @param compute Whether the zone is in the compute command buffer.
+     */
+    void beginGpuZone(const std::string& name, bool compute = false);
+    void endGpuZone(bool compute = false);
 private:
     // Create methods.
     void createCommandBuffers();
@@ -315,7 +458,40 @@ private:
     void createDescriptors();
     void createRenderResources(const RendererInitParams& params);
     void createPipeline(const RendererInitParams& params);
-    void createQueryResources();
+    void createViewMatrixUpdateResources();
+
+    /**
+     * @brief Destroys the deferred resources whose frames are finished.
+     * 
+     * @param all Destroys all of them, the device has to be idle.
+     */
+    void destroyRetiredResources(bool all = false);
+
+    /**
+     * @brief Number of ray eval workgroups, each of them is one tile of the novel view.
+     *
+     * @return glm::uvec2
+     */
+    glm::uvec2 getRayEvalTileCount() const;
+
+    /**
+     * @brief Number of depth pyramid texels of a view, all the levels together.
+     *
+     * @param res Resolution of the view.
+     * @return uint32_t
+     */
+    static uint32_t getDepthPyramidSize(const glm::vec2& res);
+
+    /**
+     * @brief Records the depth pyramid build of a subset of the views, the pyramid layout is
+     * given by all the views of the grid.
+     *
+     * @param commandBuffer Command buffer to record into.
+     * @param views All the views of the grid.
+     * @param pyramidViews Views whose pyramids are built.
+     */
+    void recordDepthPyramid(VkCommandBuffer commandBuffer, const std::vector<std::shared_ptr<View>>& views,
+        const std::vector<std::shared_ptr<View>>& pyramidViews);
 
     /**
      * @brief Update the main desriptor data.
@@ -334,6 +510,14 @@ private:
      */
     void updateCullComputeDescriptorData(const std::shared_ptr<Scene>& scene);
 
+    /**
+     * @brief Marks every frame slot outdated for the scene and light changes since the last call
+     * and clears the flags of the scene. A slot is clean again once its buffers were written.
+     * 
+     * @param scene Scene.
+     */
+    void collectSceneChanges(const std::shared_ptr<Scene>& scene);
+
     /**
      * @brief Update data for the novel view generation.
      * 
@@ -356,6 +540,12 @@ private:
 
     std::shared_ptr<Device> m_device;
     std::shared_ptr<Window> m_window;
+    bool m_headless;
+    // all views of a grid are culled by one dispatch, needs dynamic indexing of storage buffer arrays
+    bool m_batchedCulling;
+    // all views of a grid are rendered by one indirect draw, needs the batched culling and clip distances
+    bool m_gridRendering;
+    VkExtent2D m_renderPassExtent;
     std::shared_ptr<Window> m_secondaryWindow;
     std::shared_ptr<SwapChain> m_swapChain;
     std::vector<uint32_t> m_swapChainImageIndices;
@@ -363,12 +553,21 @@ private:
     std::vector<uint32_t> m_secondarySwapChainImageIndices;
     std::shared_ptr<RenderPass> m_quadRenderPass;
     std::shared_ptr<RenderPass> m_offscreenRenderPass;
+    // keeps the view matrix content for the partial updates
+    std::shared_ptr<RenderPass> m_offscreenLoadRenderPass;
     std::shared_ptr<Framebuffer> m_offscreenFramebuffer;
     std::shared_ptr<Framebuffer> m_viewMatrixFramebuffer;
 
     std::shared_ptr<GraphicsPipeline> m_offscreenPipeline;
+    std::shared_ptr<GraphicsPipeline> m_offscreenGridPipeline;
     std::shared_ptr<ComputePipeline> m_cullPipeline;
+    std::shared_ptr<ComputePipeline> m_cullBatchedPipeline;
     std::shared_ptr<ComputePipeline> m_raysEvalPipeline;
+    std::shared_ptr<ComputePipeline> m_tileViewsPipeline;
+    std::shared_ptr<ComputePipeline> m_depthPyramidPipeline;
+    std::shared_ptr<ComputePipeline> m_upsamplePipeline;
+    std::shared_ptr<ComputePipeline> m_metricsPipeline;
+    std::shared_ptr<ComputePipeline> m_metricsReducePipeline;
     std::shared_ptr<GraphicsPipeline> m_quadPipeline;
     std::shared_ptr<GraphicsPipeline> m_pointCloudPipeline;
 
@@ -381,22 +580,55 @@ private:
     std::vector<VkCommandBuffer> m_commandBuffers;
     std::vector<VkCommandBuffer> m_computeCommandBuffers;
 
+    // Last submits of every frame in flight, the swapchain only keeps the acquire and present semaphores
+    std::shared_ptr<FrameScheduler> m_scheduler;
+    std::vector<SchedulePoint> m_graphicsPoints;
+    std::vector<SchedulePoint> m_computePoints;
+
+    std::shared_ptr<GpuProfiler> m_profiler;
+    // screenshots and frame dumps, copied by the frame command buffers
+    std::shared_ptr<ImageReadback> m_readback;
+    // stage of the recorded compute command buffer, the ray evaluation waits for the view matrix
+    FrameStage m_computeStage;
+
+    // Partial and full view matrix renders, the ray evaluation waits for the last one
+    std::vector<VkCommandBuffer> m_viewMatrixCommandBuffers;
+    SchedulePoint m_viewMatrixPoint;
+
     std::vector<std::unique_ptr<Buffer>> m_fubos;
     std::vector<std::unique_ptr<Buffer>> m_vssbos;
     std::vector<std::unique_ptr<Buffer>> m_fssbos;
     std::vector<std::unique_ptr<Buffer>> m_cssbos;
+    std::vector<std::unique_ptr<Buffer>> m_bvhssbos;
+    std::vector<std::unique_ptr<Buffer>> m_bvhPrimitiveSsbos;
+    // BVH version held by the buffers of every frame in flight
+    std::vector<uint32_t> m_bvhVersions;
     std::vector<std::unique_ptr<Buffer>> m_creubo;
     std::vector<std::unique_ptr<Buffer>> m_cressbo;
+    std::vector<std::unique_ptr<Buffer>> m_viewTableSsbos;
     std::vector<std::unique_ptr<Buffer>> m_creDebugSsbo;
+    std::vector<std::unique_ptr<Buffer>> m_tileViewsSsbos;
+    std::vector<std::unique_ptr<Buffer>> m_depthPyramidViewSsbos;
+    std::unique_ptr<Buffer> m_depthPyramidSsbo;
+    uint32_t m_depthPyramidCapacity;
+    std::unique_ptr<Buffer> m_temporalHistorySsbo;
     std::vector<std::unique_ptr<Buffer>> m_quadubo;
     std::vector<std::unique_ptr<Buffer>> m_secondaryQuadubo;
     std::vector<std::unique_ptr<Buffer>> m_pointsUbo;
     std::vector<std::unique_ptr<Buffer>> m_pointsSsbo;
+    std::vector<std::unique_ptr<Buffer>> m_metricsPartialSsbos;
+    // host visible, only the sums of the whole image
+    std::vector<std::unique_ptr<Buffer>> m_metricsSsbos;
+    // frame number and id of the metrics recorded into the frame slot, UINT64_MAX once read
+    std::vector<uint64_t> m_metricsFrames;
+    std::vector<uint32_t> m_metricsIds;
 
     std::vector<std::shared_ptr<DescriptorSet>> m_generalDescriptorSets;
     std::vector<std::shared_ptr<DescriptorSet>> m_materialDescriptorSets;
     std::vector<std::shared_ptr<DescriptorSet>> m_computeDescriptorSets;
     std::vector<std::shared_ptr<DescriptorSet>> m_computeRayEvalDescriptorSets;
+    std::vector<std::shared_ptr<DescriptorSet>> m_depthPyramidDescriptorSets;
+    std::vector<std::shared_ptr<DescriptorSet>> m_metricsDescriptorSets;
     std::vector<std::shared_ptr<DescriptorSet>> m_quadDescriptorSets;
     std::vector<std::shared_ptr<DescriptorSet>> m_secondaryQuadDescriptorSets;
     std::vector<std::shared_ptr<DescriptorSet>> m_pointsDescriptorsets;
@@ -406,7 +638,11 @@ private:
     std::shared_ptr<DescriptorSetLayout> m_materialSetLayout;
     std::shared_ptr<DescriptorSetLayout> m_computeSetLayout;
     std::shared_ptr<DescriptorSetLayout> m_computeSceneSetLayout;
+    std::shared_ptr<DescriptorSetLayout> m_computeBatchSetLayout;
+    std::shared_ptr<DescriptorSetLayout> m_gridViewSetLayout;
     std::shared_ptr<DescriptorSetLayout> m_computeRayEvalSetLayout;
+    std::shared_ptr<DescriptorSetLayout> m_depthPyramidSetLayout;
+    std::shared_ptr<DescriptorSetLayout> m_metricsSetLayout;
     std::shared_ptr<DescriptorSetLayout> m_quadSetLayout;
     std::shared_ptr<DescriptorSetLayout> m_secondaryQuadSetLayout;
     std::shared_ptr<DescriptorSetLayout> m_pointsSetLayout;
@@ -416,14 +652,19 @@ private:
     std::shared_ptr<DescriptorPool> m_materialPool;
     std::shared_ptr<DescriptorPool> m_computePool;
     std::shared_ptr<DescriptorPool> m_computeScenePool;
+    std::shared_ptr<DescriptorPool> m_computeBatchPool;
+    std::shared_ptr<DescriptorPool> m_gridViewPool;
     std::shared_ptr<DescriptorPool> m_computeRayEvalPool;
+    std::shared_ptr<DescriptorPool> m_depthPyramidPool;
+    std::shared_ptr<DescriptorPool> m_metricsPool;
     std::shared_ptr<DescriptorPool> m_quadPool;
     std::shared_ptr<DescriptorPool> m_secondaryQuadPool;
     std::shared_ptr<DescriptorPool> m_pointsPool;
 
-    std::shared_ptr<Image> m_novelImage;
+    // Written by the compute queue while the previous frame still samples its own image.
+    std::vector<std::shared_ptr<Image>> m_novelImages;
     std::shared_ptr<Sampler> m_novelImageSampler;
-    VkImageView m_novelImageView;
+    std::vector<VkImageView> m_novelImageViews;
 
     std::shared_ptr<Image> m_testPixelImage;
     std::shared_ptr<Sampler> m_testPixelSampler;
@@ -432,20 +673,21 @@ private:
     std::vector<int> bufferBindings;
 
     int m_currentFrame;
-    int m_sceneFramesUpdated;
-    int m_lightsFramesUpdated;
+    // Frames submitted so far, the deferred destroys are tagged by it
+    uint64_t m_frameNumber;
+    std::deque<std::pair<uint64_t, std::function<void()>>> m_deferredDestroys;
+    // frame slots whose model, light and cull data are outdated, one bit per slot
+    uint32_t m_sceneDirtySlots;
+    uint32_t m_lightDirtySlots;
+    uint32_t m_cullDirtySlots;
     SamplingType m_novelViewSamplingType;
 
-    // vkQuery things
-    std::vector<VkQueryPool> m_timestampQueryGraphPools;
-    std::vector<VkQueryPool> m_timestampQueryCompPools;
-    std::vector<uint32_t> m_startGraphicsQuery;
-    std::vector<uint32_t> m_endGraphicsQuery;
-    std::vector<uint32_t> m_startComputeQuery;
-    std::vector<uint32_t> m_endComputeQuery;
-    float m_timestampPeriod = 1;
-    uint32_t m_lastUsedQuery = 0;
-    uint32_t m_timestampCount = 4;
+    // Temporal reuse of the novel view, the history is valid while the evaluation does not change
+    bool m_temporalHistoryValid;
+    uint32_t m_temporalFrame;
+    glm::mat4 m_prevNovelInvView;
+    glm::mat4 m_prevNovelInvProj;
+    RayEvalParams m_prevRayEvalParams;
 };
 
 }
\ No newline at end of file
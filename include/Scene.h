@@ -10,6 +10,7 @@
 #pragma once
 
 #include "Device.h"
+#include "MeshBvh.h"
 #include "utils/Constants.h"
 
 #include <vector>
@@ -28,6 +29,8 @@ class Buffer;
 class DescriptorPool;
 class DescriptorSetLayout;
 class DescriptorSet;
+class GeometryArena;
+class ViewGrid;
 
 class Scene
 {
@@ -48,12 +51,11 @@ public:
      * @param descriptorSetLayout Descriptor set layout for the model resources.
      * @param descriptorPool Descriptor pool for the model resources.
      * @param models Vector of models.
-     * @param vertices Total vertices vector.
-     * @param indices Total indices vector.
+     * @param geometry Geometry of the models, can be released after the call.
      */
     void setModels(const std::shared_ptr<Device>& device, std::shared_ptr<DescriptorSetLayout> descriptorSetLayout,
         std::shared_ptr<DescriptorPool> descriptorPool, std::vector<std::shared_ptr<Model>> models,
-        const std::vector<Vertex>& vertices, const std::vector<uint32_t> indices);
+        const GeometryArena& geometry);
     void setLightChanged(bool lightChanged);
     void setSceneChanged(bool sceneChanged);
 
@@ -63,8 +65,39 @@ public:
 
     bool lightChanged() const;
     bool sceneChanged() const;
+
+    /**
+     * @brief Version of the rendered content, it changes with the models, the light and the debug
+     * geometry, not with the cameras. The view matrix is rendered again when it changes.
+     * 
+     * @return uint32_t 
+     */
+    uint32_t getVersion() const;
     bool viewResourcesExist(std::shared_ptr<View> view);
 
+    /**
+     * @brief Rebuilds the mesh BVH from the current mesh bounding spheres if the geometry changed
+     * since the last build. Camera movement does not rebuild it.
+     * 
+     */
+    void updateBvh();
+    const MeshBvh& getBvh() const;
+
+    /**
+     * @brief Incremented with every build of the BVH, the device copies are uploaded again when it changes.
+     * 
+     * @return uint32_t 
+     */
+    uint32_t getBvhVersion() const;
+
+    /**
+     * @brief CPU culling of the meshes through the BVH, sets the instance counts of the commands.
+     * 
+     * @param camera 
+     * @param commands Indirect commands of the scene meshes.
+     */
+    void checkMeshesVisible(std::shared_ptr<Camera> camera, VkDrawIndexedIndirectCommand* commands) const;
+
     /**
      * @brief Dispatch the compute.
      * 
@@ -75,6 +108,18 @@ public:
      */
     void dispatch(std::shared_ptr<View> view, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t currentFrame);
 
+    /**
+     * @brief Dispatch the batched culling of all the views of the grid, the view index
+     * is the second dispatch dimension.
+     * 
+     * @param grid 
+     * @param commandBuffer 
+     * @param pipelineLayout 
+     * @param currentFrame 
+     */
+    void dispatchBatched(std::shared_ptr<ViewGrid> grid, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+        uint32_t currentFrame);
+
     /**
      * @brief Draw the scene.
      * 
@@ -84,6 +129,16 @@ public:
      */
     void draw(std::shared_ptr<View> view, VkCommandBuffer commandBuffer, uint32_t currentFrame);
 
+    /**
+     * @brief Draw the scene into all the views of the grid with the draw stream written by
+     * the batched culling, one instance per view in which the mesh is visible.
+     * 
+     * @param grid 
+     * @param commandBuffer 
+     * @param currentFrame 
+     */
+    void drawGrid(std::shared_ptr<ViewGrid> grid, VkCommandBuffer commandBuffer, uint32_t currentFrame);
+
     /**
      * @brief Create a View Resources.
      * 
@@ -95,6 +150,52 @@ public:
     void createViewResources(std::shared_ptr<View> view, const std::shared_ptr<Device>& device,
         std::shared_ptr<DescriptorSetLayout> descriptorSetLayout, std::shared_ptr<DescriptorPool> descriptorPool);
 
+    /**
+     * @brief Destroys the culling resources of a view removed from its grid.
+     * 
+     * @param view 
+     */
+    void destroyViewResources(std::shared_ptr<View> view);
+
+    /**
+     * @brief Create the batched culling and rendering resources of the grid, the frustum buffer,
+     * the grid draw stream and the descriptor sets.
+     * 
+     * @param grid 
+     * @param device 
+     * @param descriptorSetLayout Layout of the batched culling set.
+     * @param descriptorPool 
+     * @param renderSetLayout Layout of the grid rendering view set.
+     * @param renderPool 
+     */
+    void createGridResources(std::shared_ptr<ViewGrid> grid, const std::shared_ptr<Device>& device,
+        std::shared_ptr<DescriptorSetLayout> descriptorSetLayout, std::shared_ptr<DescriptorPool> descriptorPool,
+        std::shared_ptr<DescriptorSetLayout> renderSetLayout, std::shared_ptr<DescriptorPool> renderPool);
+    bool gridResourcesExist(std::shared_ptr<ViewGrid> grid);
+
+    /**
+     * @brief Writes the frustums of the views into the grid buffer and rebinds the view
+     * draw buffers when the views of the grid changed. View resources have to exist.
+     * 
+     * @param grid 
+     * @param views 
+     * @param currentFrame 
+     */
+    void updateGridResources(std::shared_ptr<ViewGrid> grid, const std::vector<std::shared_ptr<View>>& views,
+        uint32_t currentFrame);
+
+    /**
+     * @brief Writes the view matrices and the view tiles for the grid rendering.
+     * 
+     * @param grid 
+     * @param views 
+     * @param currentFrame 
+     * @param framebufferResolution Resolution of the framebuffer the views are rendered into.
+     */
+    void updateGridRenderData(std::shared_ptr<ViewGrid> grid, const std::vector<std::shared_ptr<View>>& views,
+        uint32_t currentFrame, glm::vec2 framebufferResolution);
+    std::shared_ptr<DescriptorSet> getGridRenderDescriptorSet(std::shared_ptr<ViewGrid> grid, uint32_t currentFrame);
+
     void setLightPos(const glm::vec3& lightPos);
     glm::vec3 getLightPos() const;
 
@@ -113,24 +214,54 @@ public:
 
 private:
     // Create methods
-    void createVertexBuffer(const std::shared_ptr<Device>& device, const std::vector<Vertex>& vertices);
-    void createIndexBuffer(const std::shared_ptr<Device>& device, const std::vector<uint32_t> indices);
+    void createVertexBuffer(const std::shared_ptr<Device>& device, const GeometryArena& geometry);
+    void createIndexBuffer(const std::shared_ptr<Device>& device, const GeometryArena& geometry);
     void createIndirectDrawBuffer(const std::shared_ptr<Device>& device);
+    void updateGridDrawTemplate();
 
-    std::vector<std::shared_ptr<Model>> m_models;
+    /**
+     * @brief Records the bulk clear of the mesh draws of the views, the culling writes only the visible ones.
+     * 
+     * @param commandBuffer 
+     * @param views 
+     * @param currentFrame 
+     */
+    void clearViewDraws(VkCommandBuffer commandBuffer, const std::vector<std::shared_ptr<View>>& views, uint32_t currentFrame);
 
-    std::vector<Vertex> m_vertices;
-    std::vector<uint32_t> m_indices;
+    std::vector<std::shared_ptr<Model>> m_models;
 
     std::shared_ptr<Buffer> m_vertexBuffer;
     std::shared_ptr<Buffer> m_indexBuffer;
     std::shared_ptr<Buffer> m_indirectDrawBuffer;
+    // scene draws without instances, grid draw streams are reset from it before the culling
+    std::shared_ptr<Buffer> m_gridDrawTemplateBuffer;
 
     std::map<std::shared_ptr<View>, std::array<std::shared_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT>> m_indirectBuffersMap;
     std::map<std::shared_ptr<View>, std::array<std::shared_ptr<DescriptorSet>, MAX_FRAMES_IN_FLIGHT>> m_computeDescriptorsMap;
+
+    struct GridCullResources
+    {
+        std::array<std::shared_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> cullBuffers;
+        std::array<std::shared_ptr<DescriptorSet>, MAX_FRAMES_IN_FLIGHT> descriptorSets;
+        // views whose draw buffers are bound in the descriptor set
+        std::array<std::vector<std::shared_ptr<View>>, MAX_FRAMES_IN_FLIGHT> boundViews;
+
+        // grid draw stream, instances of a draw are the views in which it is visible
+        std::array<std::shared_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> drawBuffers;
+        std::array<std::shared_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> instanceBuffers;
+        std::array<std::shared_ptr<Buffer>, MAX_FRAMES_IN_FLIGHT> viewBuffers;
+        std::array<std::shared_ptr<DescriptorSet>, MAX_FRAMES_IN_FLIGHT> renderDescriptorSets;
+    };
+
+    std::map<std::shared_ptr<ViewGrid>, GridCullResources> m_gridCullMap;
     std::map<std::shared_ptr<Model>, std::array<int, 2>> m_modelDrawRef;
 
     bool m_sceneChanged;
+    uint32_t m_version;
+
+    MeshBvh m_bvh;
+    bool m_bvhDirty;
+    uint32_t m_bvhVersion;
 
     // TODO: Just for testing now.
     glm::vec3 m_lightPos = { 0, 20, 0 };
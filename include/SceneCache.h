@@ -0,0 +1,191 @@
+/**
+ * @file SceneCache.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Binary cache of the imported models.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include "glm_include_unified.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vke
+{
+
+struct Vertex;
+class Model;
+
+/**
+ * @brief Geometry and materials of one imported model stored in a single binary blob.
+ * The blob is memory mapped from the cache file, or owned when the cache could not be written.
+ *
+ * Layout: Header | MeshRecord[meshCount] | Vertex[vertexCount] | uint32_t[indexCount] |
+ * DependencyRecord[dependencyCount] | strings.
+ * Mesh records keep the import order, index and vertex offsets are relative to the model.
+ * Dependencies are the other files the import read or referenced, e.g. the material libraries
+ * and the textures, the cache is outdated when any of them changes.
+ */
+class SceneCache
+{
+public:
+    static constexpr uint32_t VERSION = 2;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexStride;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint32_t meshCount;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t stringsSize;
+        uint32_t dependencyCount;
+        uint32_t __padding;
+        uint64_t meshesOffset;
+        uint64_t verticesOffset;
+        uint64_t indicesOffset;
+        uint64_t dependenciesOffset;
+        uint64_t stringsOffset;
+    };
+
+    /**
+     * @brief Size and modification time of a file the model depends on, a missing file is stored
+     * with the maximal size.
+     */
+    struct DependencyRecord
+    {
+        uint32_t pathOffset;
+        uint32_t pathSize;
+        uint64_t size;
+        int64_t time;
+    };
+
+    struct MeshRecord
+    {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        uint32_t vertexOffset;
+        uint32_t vertexCount;
+        float boundingSphere[4];
+        float ambientColor[3];
+        float diffuseColor[3];
+        float specularColor[3];
+        float opacity;
+        uint32_t textureFileOffset;
+        uint32_t textureFileSize;
+        uint32_t bumpTextureFileOffset;
+        uint32_t bumpTextureFileSize;
+        uint32_t flags;
+        uint32_t __padding;
+    };
+
+    enum MeshFlags : uint32_t
+    {
+        HAS_MATERIAL = 1 << 0,
+        HAS_TEXTURE = 1 << 1,
+        HAS_BUMP_TEXTURE = 1 << 2
+    };
+
+    /**
+     * @brief Maps the cache file.
+     *
+     * @param cacheFile
+     * @param directory Model directory, relative texture paths are resolved against it.
+     */
+    SceneCache(const std::string& cacheFile, const std::string& directory);
+
+    /**
+     * @brief Takes ownership of an already serialized blob.
+     *
+     * @param blob
+     * @param directory Model directory, relative texture paths are resolved against it.
+     */
+    SceneCache(std::vector<char>&& blob, const std::string& directory);
+    ~SceneCache();
+
+    SceneCache(const SceneCache&) = delete;
+    SceneCache& operator=(const SceneCache&) = delete;
+
+    /**
+     * @brief Loads the model from the cache, imports it with assimp and writes the cache
+     * if it is missing or outdated.
+     *
+     * @param filename Model path relative to MODELS_FILES_LOC.
+     * @return std::shared_ptr<SceneCache>
+     */
+    static std::shared_ptr<SceneCache> loadModel(const std::string& filename);
+
+    /**
+     * @brief Serializes the imported model.
+     *
+     * @param modelFile Absolute path of the source model.
+     * @param model Imported model.
+     * @param vertices Vertices of the model only.
+     * @param indices Indices of the model only.
+     * @param importedFiles Files read by the importer besides the model.
+     * @return std::vector<char>
+     */
+    static std::vector<char> serialize(const std::string& modelFile, const std::shared_ptr<Model>& model,
+        const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+        const std::vector<std::string>& importedFiles);
+
+    /**
+     * @brief Path of the cache file for the model.
+     *
+     * @param filename Model path relative to MODELS_FILES_LOC.
+     * @return std::string
+     */
+    static std::string getCacheFile(const std::string& filename);
+
+    /**
+     * @brief Checks the version and the size and modification time of the source model and of
+     * every file it depends on.
+     *
+     * @param cacheFile
+     * @param modelFile
+     * @return true if the cache can be used.
+     */
+    static bool isValid(const std::string& cacheFile, const std::string& modelFile);
+
+    /**
+     * @brief Creates the model from the cached meshes.
+     *
+     * @param firstVertex Offset of the model vertices in the scene vertex buffer.
+     * @param firstIndex Offset of the model indices in the scene index buffer.
+     * @return std::shared_ptr<Model>
+     */
+    std::shared_ptr<Model> createModel(uint32_t firstVertex, uint32_t firstIndex) const;
+
+    const Vertex* getVertices() const;
+    const uint32_t* getIndices() const;
+    uint32_t getVertexCount() const;
+    uint32_t getIndexCount() const;
+    bool isMapped() const;
+
+private:
+    void validate() const;
+    void unmap();
+    const Header* getHeader() const;
+    std::string getString(uint32_t offset, uint32_t size) const;
+
+    const char* m_data;
+    size_t m_size;
+
+    std::vector<char> m_blob;
+    std::string m_directory;
+
+    // platform mapping handles
+    void* m_mapping;
+    intptr_t m_file;
+};
+
+}
@@ -45,12 +45,9 @@ public:
     void initializeFramebuffers(std::shared_ptr<RenderPass> renderPass);
 
     // Getters
-    VkFence getFenceId(int id);
-    VkFence getComputeFenceId(int id);
     VkSwapchainKHR getSwapChain() const;
     VkSemaphore getImageAvailableSemaphore(int id);
     VkSemaphore getRenderFinishedSemaphore(int id);
-    VkSemaphore getComputeFinishedSemaphore(int id);
     std::shared_ptr<Framebuffer> getFramebuffer(int id);
     VkExtent2D getExtent();
     uint32_t getImageCount() const;
@@ -111,14 +108,9 @@ private:
     std::vector<VkImageView> m_swapChainImageViews;
     std::vector<std::shared_ptr<Framebuffer>> m_swapChainFramebuffers;
 
-    // Sync members
+    // Sync members, the frames are ordered by the frame scheduler of the renderer
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
-    std::vector<VkFence> m_inFlightFences;
-
-    // Compute sync members
-    std::vector<VkSemaphore> m_computeFinishedSemaphores;
-    std::vector<VkFence> m_computeInFlightFences;
 };
 
 }
\ No newline at end of file
@@ -36,6 +36,15 @@ public:
      */
     Texture(std::shared_ptr<Device> device, unsigned char* pixels, glm::vec2 dims, int channels = 4,
         VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+
+    /**
+     * @brief Construct a new Texture object from an image that is already uploaded
+     * and in the shader read only layout.
+     * 
+     * @param device Device for the texture.
+     * @param image Uploaded image.
+     */
+    Texture(std::shared_ptr<Device> device, std::shared_ptr<Image> image);
     ~Texture();
 
     void destroyVkResources();
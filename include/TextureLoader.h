@@ -0,0 +1,84 @@
+/**
+ * @file TextureLoader.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Parallel loading and batched upload of the material textures.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "Device.h"
+#include "cpu/TileThreadPool.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vke
+{
+
+class Model;
+class Renderer;
+class Image;
+
+class TextureLoader
+{
+public:
+    /**
+     * @brief Construct a new Texture Loader object.
+     *
+     * @param device
+     * @param threadCount Number of decoding threads, 0 for all hardware threads.
+     */
+    TextureLoader(std::shared_ptr<Device> device, uint32_t threadCount = 0);
+
+    /**
+     * @brief Collects the unique texture and bump texture files of all the materials that
+     * are not registered in the renderer yet, decodes them on the thread pool directly into
+     * a shared staging buffer and uploads each batch with a single command buffer. The textures
+     * are registered through Renderer::addTexture and Renderer::addBumpTexture, so that
+     * Mesh::afterImportInit only looks up their ids.
+     *
+     * @param models
+     * @param renderer
+     */
+    void loadTextures(const std::vector<std::shared_ptr<Model>>& models, std::shared_ptr<Renderer> renderer);
+
+private:
+    struct TextureRequest
+    {
+        std::string filename;
+        bool bump;
+        int width;
+        int height;
+        VkFormat format;
+        VkDeviceSize size;
+        VkDeviceSize offset;
+        std::shared_ptr<Image> image;
+    };
+
+    /**
+     * @brief Decodes the images of the batch into the staging memory.
+     *
+     * @param requests
+     * @param staging Mapped staging memory.
+     */
+    void decodeBatch(std::vector<TextureRequest*>& requests, unsigned char* staging);
+
+    /**
+     * @brief Records the layout transitions and copies of the whole batch into one command buffer.
+     *
+     * @param requests
+     * @param stagingBuffer
+     */
+    void uploadBatch(std::vector<TextureRequest*>& requests, VkBuffer stagingBuffer);
+
+    std::shared_ptr<Device> m_device;
+    TileThreadPool m_threadPool;
+};
+
+}
\ No newline at end of file
@@ -42,7 +42,7 @@ public:
         std::shared_ptr<DescriptorSetLayout> descriptorSetLayout, std::shared_ptr<DescriptorPool> descriptorPool);
     ~View();
 
-    void destroyVkResources(int currentFrame = -1);
+    void destroyVkResources();
 
     // Getters
     glm::vec2 getResolution() const;
@@ -85,6 +85,26 @@ public:
     void updateDescriptorDataRenderDebugCube(std::vector<MeshShaderDataVertex>& vertexShaderData,
         std::vector<MeshShaderDataFragment>& fragmentShaderData);
 
+    /**
+     * @brief Whether the camera, the resolution, the viewport or the shading of the view changed
+     * since it was last rendered into the view matrix.
+     * 
+     * @return true The tile of the view has to be rendered again.
+     */
+    bool isDirty() const;
+
+    /**
+     * @brief Remembers the current state as the one in the view matrix.
+     * 
+     */
+    void setRendered();
+
+    /**
+     * @brief Forces the view to be rendered again, e.g. after a scene change.
+     * 
+     */
+    void setDirty();
+
     // Debug
     void setDebugCameraGeometry(std::shared_ptr<Model> model);
     std::shared_ptr<Model> getDebugCameraModel() const;
@@ -114,6 +134,14 @@ private:
     bool m_frustumCull;
     bool m_depthOnly;
 
+    // State of the view when it was last rendered into the view matrix
+    bool m_rendered;
+    glm::mat4 m_renderedView;
+    glm::mat4 m_renderedProj;
+    glm::vec2 m_renderedResolution;
+    glm::vec2 m_renderedViewportStart;
+    bool m_renderedDepthOnly;
+
     // Debug
     std::shared_ptr<Model> m_debugModel;
 };
@@ -56,11 +56,34 @@ public:
 
     void addColumn();
 
-    void removeColumn(int currentFrame, bool resourcesOnly = false);
+    /**
+     * @brief Removes the last column of the grid.
+     * 
+     * @return std::vector<std::shared_ptr<View>> Removed views, their resources may still be used
+     * by the frames in flight and are not destroyed.
+     */
+    std::vector<std::shared_ptr<View>> removeColumn();
 
     void addRow();
 
-    void removeRow(int currentFrame, bool resourcesOnly = false);
+    /**
+     * @brief Removes the last row of the grid.
+     * 
+     * @return std::vector<std::shared_ptr<View>> Removed views, their resources may still be used
+     * by the frames in flight and are not destroyed.
+     */
+    std::vector<std::shared_ptr<View>> removeRow();
+
+    /**
+     * @brief Views whose tiles in the view matrix are out of date.
+     * 
+     * @return std::vector<std::shared_ptr<View>> Dirty views in the grid order.
+     */
+    std::vector<std::shared_ptr<View>> getDirtyViews() const;
+
+    void setViewsRendered();
+
+    void setViewsDirty();
 
     // Getters
     std::vector<std::shared_ptr<View>> getViews() const;
@@ -0,0 +1,76 @@
+/**
+ * @file CpuRayEvaluator.h
+ * @author Boris Burkalo (xburka00)
+ * @brief CPU implementation of the novel view ray evaluation from novelView.comp.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include "glm_include_unified.h"
+
+#include "utils/Structs.h"
+#include "cpu/TileThreadPool.h"
+
+#include <memory>
+#include <vector>
+
+namespace vke
+{
+
+/**
+ * @brief Non-owning view of the view matrix atlas. Color is RGBA8, depth is one
+ * float per texel, both of resolution res (RayEvalUniformBuffer::viewsTotalRes).
+ */
+struct CpuAtlas
+{
+    const uint8_t* color = nullptr;
+    const float* depth = nullptr;
+    glm::ivec2 res = glm::ivec2(0);
+};
+
+class CpuRayEvaluator
+{
+public:
+    /**
+     * @brief Number of rays evaluated together by one lane group.
+     */
+    static constexpr int RAY_PACKET_SIZE = 8;
+
+    /**
+     * @brief Construct a new Cpu Ray Evaluator object.
+     *
+     * @param threadCount Number of worker threads, 0 for all hardware threads.
+     * @param tileSize Side of the square tile handed to a single worker.
+     */
+    CpuRayEvaluator(uint32_t threadCount = 0, uint32_t tileSize = 32);
+
+    /**
+     * @brief Evaluates the novel view. Follows the compute shader, the test pixel
+     * visualization is not written, the tested pixel is evaluated as any other.
+     *
+     * @param ubo Same data as uploaded for the compute shader.
+     * @param views Per view data, ubo.viewCnt entries are used.
+     * @param atlas Color and depth of the view matrix.
+     * @param output RGBA result of ubo.res resolution, resized if needed.
+     */
+    void evaluate(const RayEvalUniformBuffer& ubo, const std::vector<ViewEvalDataCompute>& views,
+        const CpuAtlas& atlas, std::vector<glm::vec4>& output);
+
+    uint32_t getThreadCount() const;
+    uint32_t getTileSize() const;
+
+private:
+    struct ViewData;
+    struct RayPacket;
+
+    void evaluatePacket(const RayEvalUniformBuffer& ubo, const std::vector<ViewData>& views,
+        const CpuAtlas& atlas, RayPacket& packet) const;
+
+    std::unique_ptr<TileThreadPool> m_threadPool;
+    uint32_t m_tileSize;
+};
+
+}
@@ -0,0 +1,79 @@
+/**
+ * @file TileThreadPool.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Work-stealing thread pool used for tiled CPU work.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vke
+{
+
+class TileThreadPool
+{
+public:
+    /**
+     * @brief Construct a new Tile Thread Pool object.
+     *
+     * @param threadCount Number of workers including the calling thread,
+     * 0 means std::thread::hardware_concurrency().
+     */
+    TileThreadPool(uint32_t threadCount = 0);
+    ~TileThreadPool();
+
+    TileThreadPool(const TileThreadPool&) = delete;
+    TileThreadPool& operator=(const TileThreadPool&) = delete;
+
+    /**
+     * @brief Runs the task for every index in [0, taskCount) and blocks until all of them
+     * are done. The calling thread works as one of the workers. Tasks are split into
+     * contiguous blocks per worker, idle workers steal from the back of the other queues.
+     * The first exception thrown by a task is rethrown here.
+     *
+     * @param taskCount
+     * @param task
+     */
+    void run(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+    uint32_t getThreadCount() const;
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<uint32_t> tasks;
+    };
+
+    void workerLoop(uint32_t workerId);
+    void executeTasks(uint32_t workerId);
+    bool popTask(uint32_t workerId, uint32_t& task);
+    bool stealTask(uint32_t workerId, uint32_t& task);
+
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+    const std::function<void(uint32_t)>* m_task = nullptr;
+    std::exception_ptr m_exception;
+
+    std::mutex m_mutex;
+    std::condition_variable m_startCondition;
+    std::condition_variable m_doneCondition;
+    uint64_t m_generation = 0;
+    uint32_t m_runningWorkers = 0;
+    bool m_stop = false;
+};
+
+}
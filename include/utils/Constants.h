@@ -9,7 +9,7 @@
 
 #pragma once
 
-#define MAX_FRAMES_IN_FLIGHT 1
+#define MAX_FRAMES_IN_FLIGHT 2
 #define MAX_VIEWS 64
 #define MAX_SBOS 1024
 #define MAX_BINDLESS_RESOURCES 16536
@@ -18,6 +18,20 @@
 #define MIN_RAY_SAMPLES 0
 #define MAX_RAY_SAMPLES 256
 #define MAX_POINT_CLOUD_DIM 1920 * 2
+#define MAX_TEXTURE_STAGING_SIZE (256 * 1024 * 1024)
+#define MAX_CULL_GRIDS 4
+#define CULL_WORKGROUP_SIZE 256
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_TASKS 1024
+#define RAY_EVAL_TILE_SIZE 32
+#define DEPTH_PYRAMID_BASE 8
+#define DEPTH_PYRAMID_LEVELS 5
+#define DEPTH_PYRAMID_GROUP_SIZE (1 << (DEPTH_PYRAMID_LEVELS - 1))
+#define VARIABLE_RATE_MAX_VARIANCE 0.01f
+#define METRICS_GROUP_SIZE 16
+#define SSIM_WINDOW 8
+#define SSIM_C1 (0.01f * 0.01f)
+#define SSIM_C2 (0.03f * 0.03f)
 
 #define VIEW_MATRIX_WIDTH  (1920.f * 4.f)
 #define VIEW_MATRIX_HEIGHT (1080.f * 4.f)
@@ -53,9 +67,25 @@
 #define SCREENSHOT_FILES_LOC "../screenshots/"
 #endif
 
+#ifndef PROFILE_FILES_LOC
+#define PROFILE_FILES_LOC "../profiles/"
+#endif
+
 #ifndef MODELS_FILES_LOC
 #define MODELS_FILES_LOC "../res/models/"
 #endif
 
+#ifndef MODEL_CACHE_FILES_LOC
+#define MODEL_CACHE_FILES_LOC MODELS_FILES_LOC "cache/"
+#endif
+
 #define DRAW_LIGHT false
 
+#ifndef PACKED_VERTICES
+#define PACKED_VERTICES 0
+#endif
+
+#ifndef QUANTIZED_POSITIONS
+#define QUANTIZED_POSITIONS 0
+#endif
+
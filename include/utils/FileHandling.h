@@ -39,6 +39,32 @@ std::vector<char> readFile(const std::string& filename);
  */
 unsigned char* loadImage(std::string& filename, int& width, int& height, int& channels);
 
+/**
+ * @brief Loads an image without touching the global stb flip flag, so it can be called from
+ * multiple threads at once. The flag has to be set by setFlipImagesOnLoad beforehand.
+ * 
+ * @param filename 
+ * @param width 
+ * @param height 
+ * @param channels 
+ * @return unsigned char*, released with freeImage.
+ */
+unsigned char* decodeImage(const std::string& filename, int& width, int& height, int& channels);
+
+/**
+ * @brief Reads only the image header.
+ * 
+ * @param filename 
+ * @param width 
+ * @param height 
+ * @param channels 
+ * @return true if the image is readable.
+ */
+bool getImageInfo(const std::string& filename, int& width, int& height, int& channels);
+
+void setFlipImagesOnLoad(bool flip);
+void freeImage(unsigned char* pixels);
+
 /**
  * @brief Saves image using the stb image library.
  * 
@@ -55,14 +81,6 @@ void saveImage(const std::string& filename, const glm::ivec3& dims, uint8_t* dat
  */
 void saveImages(const std::vector<SaveImageInfo>& saveInfos);
 
-/**
- * @brief Save images and notify when done.
- * 
- * @param saveInfos 
- * @param imagesSaved 
- */
-void saveImagesThread(const std::vector<SaveImageInfo> &saveInfos, bool& imagesSaved);
-
 /**
  * @brief Transform image of three channels to one channel image.
  * 
@@ -85,5 +103,24 @@ std::vector<unsigned char> threeChannelsToOne(unsigned char* pixels, const int&
 std::vector<unsigned char> threeChannelsToFour(unsigned char* pixels, const int& width,
     const int& height);
 
+/**
+ * @brief Widens RGB pixels to RGBA with alpha set to 255. Uses SSSE3 when the CPU supports it.
+ * 
+ * @param src pixelCount * 3 bytes.
+ * @param dst pixelCount * 4 bytes.
+ * @param pixelCount 
+ */
+void rgbToRgba(const unsigned char* src, unsigned char* dst, size_t pixelCount);
+
+/**
+ * @brief Averages RGB pixels into a single channel, (r + g + b) / 3 rounded down. Uses SSSE3
+ * when the CPU supports it.
+ * 
+ * @param src pixelCount * 3 bytes.
+ * @param dst pixelCount bytes.
+ * @param pixelCount 
+ */
+void rgbToLuma(const unsigned char* src, unsigned char* dst, size_t pixelCount);
+
 }
 
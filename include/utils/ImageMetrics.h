@@ -0,0 +1,50 @@
+/**
+ * @file ImageMetrics.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Image quality metrics of the novel view, the CPU counterpart of metrics.comp.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include "glm_include_unified.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "Structs.h"
+
+namespace vke::utils
+{
+
+/**
+ * @brief Computes the sums of the metrics of two RGBA8 images of the same size, the same way
+ * as the compute shader. The squared error is summed over the RGB channels, SSIM over every
+ * SSIM_WINDOW x SSIM_WINDOW window of the luma, which lies inside the image.
+ *
+ * @param gt Ground truth.
+ * @param novel Novel view.
+ * @param dims Width and height.
+ * @return MetricsSumsCompute
+ */
+MetricsSumsCompute computeMetricsSums(const uint8_t* gt, const uint8_t* novel, const glm::ivec2& dims);
+
+/**
+ * @brief MSE of the channels in [0, 1], PSNR against the peak of 1 and the mean SSIM of the windows.
+ *
+ * @param sums
+ * @return ImageMetrics PSNR is infinite for identical images.
+ */
+ImageMetrics metricsFromSums(const MetricsSumsCompute& sums);
+
+/**
+ * @brief Mean of every metric over the frames.
+ *
+ * @param metrics
+ * @return ImageMetrics
+ */
+ImageMetrics averageMetrics(const std::vector<ImageMetrics>& metrics);
+
+}
\ No newline at end of file
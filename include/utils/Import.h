@@ -13,12 +13,15 @@
 #include "Mesh.h"
 #include "Structs.h"
 #include "Material.h"
+#include "SceneCache.h"
+#include "GeometryArena.h"
 
 #include <string>
 #include <memory>
 #include <iostream>
 
 #include <assimp/Importer.hpp>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
@@ -71,9 +74,20 @@ void processNode(const std::shared_ptr<Model>& model, aiNode* node, const aiScen
  * @param filename Path to the model.
  * @param vertices All vertices parsed.
  * @param indices All indices parsed.
+ * @param openedFiles Optional list of every file the importer read, e.g. the material libraries.
  * @return std::shared_ptr<Model> 
  */
 std::shared_ptr<Model> importModel(std::string filename, std::vector<Vertex>& vertices,
-    std::vector<uint32_t>& indices);
+    std::vector<uint32_t>& indices, std::vector<std::string>* openedFiles = nullptr);
+
+/**
+ * @brief Import the model through the binary scene cache. The model geometry is appended
+ * to the arena, its meshes are offset behind the geometry already present.
+ * 
+ * @param filename Path to the model.
+ * @param geometry Geometry of all the imported models.
+ * @return std::shared_ptr<Model> 
+ */
+std::shared_ptr<Model> importModelCached(std::string filename, GeometryArena& geometry);
 
 }
\ No newline at end of file
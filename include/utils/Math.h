@@ -8,6 +8,9 @@
  */
 
 #include "glm_include_unified.h"
+#include "utils/Structs.h"
+
+#include <cstdint>
 
 namespace vke::utils
 {
@@ -20,4 +23,33 @@ namespace vke::utils
  */
 glm::vec3 getScaleFromMatrix(glm::mat4 matrix);
 
+/**
+ * @brief Octahedral encoding of a direction.
+ * 
+ * @param direction Does not have to be normalized.
+ * @return glm::vec2 Encoded direction in [-1, 1].
+ */
+glm::vec2 octEncode(glm::vec3 direction);
+
+/**
+ * @brief Decodes the octahedral encoded direction.
+ * 
+ * @param encoded 
+ * @return glm::vec3 Normalized direction.
+ */
+glm::vec3 octDecode(glm::vec2 encoded);
+
+/**
+ * @brief Converts the vertices of one mesh into the packed format. With QUANTIZED_POSITIONS
+ * the positions are quantized into the bounds of the vertices.
+ * 
+ * @param vertices 
+ * @param count 
+ * @param dst 
+ * @param positionOffset Dequantization offset of the positions.
+ * @param positionScale Dequantization scale of the positions.
+ */
+void packVertices(const Vertex* vertices, uint32_t count, PackedVertex* dst,
+    glm::vec3& positionOffset, glm::vec3& positionScale);
+
 }
\ No newline at end of file
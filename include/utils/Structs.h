@@ -17,6 +17,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "Constants.h"
+
 // GLM
 #include "glm_include_unified.h"
 
@@ -33,6 +35,8 @@ enum class SamplingType {
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Family with compute but without graphics support, empty when the device has none.
+    std::optional<uint32_t> computeFamily;
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -50,9 +54,17 @@ struct RendererInitParams
     std::string vertexShaderFile;
     std::string fragmentShaderFile;
     std::string computeShaderFile;
+    std::string computeBatchedShaderFile;
+    std::string gridVertexShaderFile;
+    std::string gridFragmentShaderFile;
     std::string quadVertexShaderFile;
     std::string quadFragmentShaderFile;
     std::string computeRaysEvalShaderFile;
+    std::string computeTileViewsShaderFile;
+    std::string depthPyramidShaderFile;
+    std::string novelViewUpsampleShaderFile;
+    std::string metricsShaderFile;
+    std::string metricsReduceShaderFile;
     std::string vertexPointCloudShaderFile;
     std::string fragmentPointCloudShaderFile;
 
@@ -67,6 +79,15 @@ struct ViewDataVertex {
     glm::mat4 proj;
 };
 
+// Grid rendering, viewport xy - scale, zw - offset of the view tile in the framebuffer NDC
+struct GridViewDataVertex {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::vec4 viewport;
+    unsigned int depthOnly;
+    unsigned int __padding[3];
+};
+
 struct UniformDataFragment {
     glm::vec3 lightPos;
     float __padding;
@@ -79,6 +100,9 @@ struct ViewDataFragment {
 
 struct MeshShaderDataVertex {
     glm::mat4 model;
+    // dequantization of the packed positions, identity otherwise
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
 };
 
 struct MeshShaderDataFragment {
@@ -103,6 +127,38 @@ struct MeshShaderDataCompute {
     glm::vec4 boundingSphere;
 };
 
+// Batched cull shader data, all views of a grid in one buffer
+struct ViewCullDataCompute {
+    glm::vec4 frustumPlanes[6];
+    unsigned int frustumCull;
+    unsigned int __padding[3];
+};
+
+struct GridCullDataCompute {
+    unsigned int totalMeshes;
+    unsigned int viewCount;
+    unsigned int __padding[2];
+    ViewCullDataCompute views[MAX_VIEWS];
+};
+
+// Mesh BVH, subtree primitives are contiguous, leaves have leftChild 0
+struct BvhNodeCompute {
+    glm::vec4 aabbMin;
+    glm::vec4 aabbMax;
+    unsigned int firstPrimitive;
+    unsigned int primitiveCount;
+    unsigned int leftChild;
+    unsigned int __padding;
+};
+
+// Followed by the nodes, one cull thread per task root
+struct BvhHeaderCompute {
+    unsigned int nodeCount;
+    unsigned int taskCount;
+    unsigned int __padding[2];
+    unsigned int tasks[BVH_MAX_TASKS];
+};
+
 
 // Ray Eval shader data
 struct RayEvalUniformBuffer {
@@ -118,7 +174,19 @@ struct RayEvalUniformBuffer {
     int numOfRaySamples;
     bool automaticSampleCount;
     int maxViewsUsed;
-    float __padding2;
+    alignas(4) bool hierarchicalSampling;
+    alignas(4) bool emptySpaceSkipping;
+    alignas(4) bool temporalReuse;
+    alignas(16) glm::mat4 viewProj;
+    glm::mat4 prevInvView;
+    glm::mat4 prevInvProj;
+    glm::uvec2 historyRes;
+    unsigned int historyRead;
+    unsigned int historyWrite;
+    unsigned int frameIndex;
+    alignas(4) bool historyValid;
+    alignas(4) bool variableRate;
+    float rateThreshold;
 };
 
 struct ViewEvalDataCompute {
@@ -129,10 +197,50 @@ struct ViewEvalDataCompute {
     glm::mat4 invProj;
     glm::vec4 resOffset;
     glm::vec2 nearFar;
-    float __padding[2];
+    unsigned int depthPyramidOffset;
+    float __padding;
     glm::vec4 viewDir;
 };
 
+// Per-view data of the ray samples as separate arrays, staged in shared memory by novelView.comp.
+// A clip space point of the view lands on the atlas uv xy * uvScaleBias.xy + uvScaleBias.zw
+struct ViewEvalTableCompute {
+    glm::mat4 viewProj[MAX_VIEWS];
+    glm::mat4 invViewProj[MAX_VIEWS];
+    glm::vec4 uvScaleBias[MAX_VIEWS];
+};
+
+// Tile of the view in the atlas and the start of its depth pyramid
+struct DepthPyramidViewCompute {
+    glm::vec4 resOffset;
+    unsigned int pyramidOffset;
+    unsigned int __padding[3];
+};
+
+// Sums of the image metrics reduced by a workgroup or over the whole image
+struct MetricsSumsCompute {
+    // over the RGB channels
+    float squaredError;
+    float ssim;
+    float windows;
+    float pixels;
+};
+
+// Last evaluated sample of a novel view pixel
+struct TemporalHistoryCompute {
+    unsigned int color;
+    float t;
+    float metric;
+    unsigned int age;
+};
+
+// Views whose frustum the rays of a novel view tile can hit
+struct TileViewsCompute {
+    unsigned int count;
+    unsigned int rate;
+    unsigned int viewIds[MAX_VIEWS];
+};
+
 struct ViewEvalDebugCompute {
     glm::vec4 frustumPlanes[6];
     int numOfIntersections;
@@ -160,6 +268,11 @@ struct RayEvalParams
     bool thresholdDepth;
     float maxSampleDistance;
     int maxViewsUsed;
+    bool hierarchicalSampling;
+    bool emptySpaceSkipping;
+    bool temporalReuse;
+    bool variableRate;
+    float quality;
 };
 
 struct PointCloudParams
@@ -175,6 +288,14 @@ struct WindowParams
     VkResult secondaryResult;
 };
 
+// Novel view compared against the ground truth seen by the same camera
+struct ImageMetrics
+{
+    float mse;
+    float psnr;
+    float ssim;
+};
+
 struct SaveImageInfo
 {
     std::string filename;
@@ -241,6 +362,63 @@ struct Point
     }
 };
 
+/**
+ * @brief Compact vertex used by the geometry pass when built with PACKED_VERTICES.
+ * Normal and tangent are octahedral encoded, the bitangent is reconstructed from their cross
+ * product and the sign stored in pos.w. With QUANTIZED_POSITIONS the position is unorm16
+ * in the bounds of its mesh (see MeshShaderDataVertex). The vertex color is not stored,
+ * the geometry pass does not use it.
+ */
+struct PackedVertex
+{
+#if QUANTIZED_POSITIONS
+    uint16_t pos[4];
+#else
+    float pos[4];
+#endif
+    int16_t normalTangent[4];
+    uint16_t uv[2];
+
+    static VkVertexInputBindingDescription getBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(PackedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
+    {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+#if QUANTIZED_POSITIONS
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+#else
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+#endif
+        attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescriptions[1].offset = offsetof(PackedVertex, normalTangent);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(PackedVertex, uv);
+
+        return attributeDescriptions;
+    }
+};
+
+/**
+ * @brief Vertex as imported and cached. The device vertex buffer holds PackedVertex
+ * instead when built with PACKED_VERTICES, the descriptions follow the device layout.
+ */
 struct Vertex 
 {
     glm::vec3 pos;
@@ -252,16 +430,23 @@ struct Vertex
 
     static VkVertexInputBindingDescription getBindingDescription()
     {
+#if PACKED_VERTICES
+        return PackedVertex::getBindingDescription();
+#else
         VkVertexInputBindingDescription bindingDescription{};
         bindingDescription.binding = 0;
         bindingDescription.stride = sizeof(Vertex);
         bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
         return bindingDescription;
+#endif
     }
 
     static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
     {
+#if PACKED_VERTICES
+        return PackedVertex::getAttributeDescriptions();
+#else
         std::vector<VkVertexInputAttributeDescription> attributeDescriptions(6);
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
@@ -294,6 +479,7 @@ struct Vertex
         attributeDescriptions[5].offset = offsetof(Vertex, uv);
 
         return attributeDescriptions;
+#endif
     }
 };
 
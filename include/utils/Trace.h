@@ -0,0 +1,71 @@
+/**
+ * @file Trace.h
+ * @author Boris Burkalo (xburka00)
+ * @brief Scoped CPU trace zones written in the Chrome trace event format.
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/**
+ * @brief Traces the rest of the scope, the name has to outlive the trace (a string literal).
+ */
+#define TRACE_ZONE(name) vke::utils::TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+namespace vke::utils
+{
+
+/**
+ * @brief Nanoseconds since the start of the trace.
+ */
+int64_t traceNow();
+
+/**
+ * @brief Adds a finished zone to the ring of the calling thread. Only the owning thread writes
+ * its ring, so no lock is taken, the oldest zones are overwritten once the ring is full.
+ *
+ * @param name Has to outlive the trace.
+ * @param start
+ * @param end
+ */
+void traceEvent(const char* name, int64_t start, int64_t end);
+
+/**
+ * @brief Adds a zone of the GPU, already converted to the CPU time, to the ring of the calling thread.
+ *
+ * @param name Has to outlive the trace.
+ * @param track Queue of the zone.
+ * @param start
+ * @param end
+ */
+void traceGpuEvent(const char* name, uint32_t track, int64_t start, int64_t end);
+
+void setTraceThreadName(const std::string& name);
+
+/**
+ * @brief Writes the zones of all the threads as a chrome://tracing or Perfetto JSON file.
+ *
+ * @param filename
+ */
+void writeTrace(const std::string& filename);
+
+class TraceZone
+{
+public:
+    TraceZone(const char* name) : m_name(name), m_start(traceNow()) {}
+    ~TraceZone() { traceEvent(m_name, m_start, traceNow()); }
+
+private:
+    const char* m_name;
+    int64_t m_start;
+};
+
+}
\ No newline at end of file
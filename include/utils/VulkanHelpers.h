@@ -19,6 +19,7 @@ namespace vke::utils
 
 /**
  * @brief Find queue families for the surface and physical device.
+ *        With VK_NULL_HANDLE surface the present family falls back to the graphics family.
  * 
  * @param device 
  * @param surface 
@@ -37,6 +38,7 @@ SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurface
 
 /**
  * @brief Check whether the device is suitable for rendering.
+ *        Swapchain support is not checked for VK_NULL_HANDLE surface.
  * 
  * @param device 
  * @param surface 
@@ -12,6 +12,47 @@
 #define MIN_PIX_SAMPLES 16
 #define MAX_PIX_SAMPLES (256 - MIN_PIX_SAMPLES)
 
+// Empty space skipping, the segments have to fit into one uint mask
+#define EMPTY_SPACE_SEGMENTS 16
+#define DEPTH_PYRAMID_BASE 8
+#define DEPTH_PYRAMID_LEVELS 5
+#define DEPTH_PYRAMID_GROUP_SIZE (1 << (DEPTH_PYRAMID_LEVELS - 1))
+#define DEPTH_PYRAMID_EPSILON 0.0001
+
+// Image metrics, every workgroup reduces its pixels and the SSIM windows starting in them
+#define METRICS_GROUP_SIZE 16
+#define SSIM_WINDOW 8
+#define SSIM_C1 (0.01 * 0.01)
+#define SSIM_C2 (0.03 * 0.03)
+
+// Hierarchical ray sampling, every skipping segment gets at least one coarse sample
+#define MIN_COARSE_SAMPLES EMPTY_SPACE_SEGMENTS
+#define COARSE_SAMPLES_RATIO 8
+#define MAX_REFINE_LEVELS 8
+#define REFINE_COLOR_THRESHOLD 0.01
+#define REFINE_DEPTH_THRESHOLD 0.001
+
+// Temporal reuse, a reused pixel is evaluated again after TEMPORAL_MAX_AGE frames at the latest
+#define TEMPORAL_MAX_AGE 8
+#define TEMPORAL_REPROJECT_ITERATIONS 2
+#define TEMPORAL_PIXEL_TOLERANCE 0.5
+#define TEMPORAL_COLOR_CONFIDENCE 0.2
+#define TEMPORAL_DEPTH_CONFIDENCE 0.5
+
+// Variable rate evaluation, flat tiles are evaluated at every 2nd or 4th pixel in both directions
+#define RATE_FULL 1
+#define RATE_QUARTER 2
+#define RATE_SIXTEENTH 4
+#define VARIABLE_RATE_MARGIN 8
+#define VARIABLE_RATE_DEPTH_RANGE 0.05
+#define UPSAMPLE_DEPTH_SIGMA 0.05
+
+// Novel view tile, one ray eval workgroup
+#define TILE_SIZE 32
+
+// vec4 rows of one view in the view table, viewProj, invViewProj and the uv scale and bias
+#define VIEW_TABLE_ROWS 9u
+
 // Sample types
 #define SAMPLE_COLOR 0x00000001u
 #define SAMPLE_DEPTH_NORMAL 0x00000002u
@@ -34,6 +34,16 @@
     d = ct.xy; \
     pixId = (((ct.xy + 1) / 2) * res) + offset;
 
+// Atlas uv of a world space point seen by the view k of the staged view table, d is its NDC position
+#define PROJECT_TO_VIEW(p, k, uv, d) \
+    vec4 ct = viewProjs[k] * vec4(p, 1.f); \
+    d = ct.xy / ct.w; \
+    uv = d * viewUvScaleBias[k].xy + viewUvScaleBias[k].zw;
+
+#define UNPROJECT_FROM_VIEW(d, z, k, worldPoint) \
+    vec4 wp = invViewProjs[k] * vec4(d, z, 1.0); \
+    worldPoint = wp.xyz / wp.w;
+
 // id mask helpers
 #define GET_MASK_ID(id, result) \
     int outerMask = int(floor(id / 32)); \
@@ -85,45 +95,56 @@
         valid = k == viewId || valid; \
     }
 
-#define FIND_INTERSECTS(frustumHitsIn, frustumHitsOut, ubo, cssbo, org, dir) \
-    for (int i = 0; i < ubo.viewCnt; i++) \
+#define FIND_VIEW_INTERSECT(frustumHitsIn, frustumHitsOut, cssbo, org, dir, i) \
+    vec4 viewPlanes[6] = cssbo.objects[i].frustumPlanes; \
+    \
+    float intersects[2]; \
+    int foundIntersects = 0; \
+    \
+    bool valid = true; \
+    for (int j = 0; j < 6; j++) \
     { \
-        ViewDataEvalCompute currentView = cssbo.objects[i]; \
+        vec4 currentPlane = viewPlanes[j]; \
         \
-        float intersects[2]; \
-        int foundIntersects = 0; \
+        vec3 frustumNormal = currentPlane.xyz; \
+        float frustumDistance = currentPlane.w; \
         \
-        bool valid = true; \
-        for (int j = 0; j < 6; j++) \
+        if (abs(dot(frustumNormal, dir)) > 1e-6) \
         { \
-            vec4 currentPlane = currentView.frustumPlanes[j]; \
+            float t = -(dot(frustumNormal, org) + frustumDistance) / dot(frustumNormal, dir); \
+            vec3 intersect = org + t * dir; \
             \
-            vec3 frustumNormal = currentPlane.xyz; \
-            float frustumDistance = currentPlane.w; \
+            intersects[foundIntersects] = t; \
             \
-            if (abs(dot(frustumNormal, dir)) > 1e-6) \
-            { \
-                float t = -(dot(frustumNormal, org) + frustumDistance) / dot(frustumNormal, dir); \
-                vec3 intersect = org + t * dir; \
-                \
-                intersects[foundIntersects] = t; \
-                \
-                IS_POINT_IN_FRUSTUM(t, intersect, currentView.frustumPlanes, j, valid); \
-                \
-                foundIntersects += int(valid && foundIntersects < 2) * 1; \
-            } \
+            IS_POINT_IN_FRUSTUM(t, intersect, viewPlanes, j, valid); \
+            \
+            foundIntersects += int(valid && foundIntersects < 2) * 1; \
         } \
-        \
-        int idIn = int(intersects[0] >= intersects[1]); \
-        int idOut = int(intersects[0] < intersects[1]); \
-        intersects[idIn] = int(intersects[idIn] >= 0) * intersects[idIn]; \
-        \
-        frustumHitsIn[intersectCount].viewId = i; \
-        frustumHitsOut[intersectCount].viewId = i; \
-        frustumHitsIn[intersectCount].t = intersects[idIn]; \
-        frustumHitsOut[intersectCount].t = intersects[idOut]; \
-        \
-        intersectCount += int(foundIntersects == 2); \
+    } \
+    \
+    int idIn = int(intersects[0] >= intersects[1]); \
+    int idOut = int(intersects[0] < intersects[1]); \
+    intersects[idIn] = int(intersects[idIn] >= 0) * intersects[idIn]; \
+    \
+    frustumHitsIn[intersectCount].viewId = i; \
+    frustumHitsOut[intersectCount].viewId = i; \
+    frustumHitsIn[intersectCount].t = intersects[idIn]; \
+    frustumHitsOut[intersectCount].t = intersects[idOut]; \
+    \
+    intersectCount += int(foundIntersects == 2);
+
+#define FIND_INTERSECTS(frustumHitsIn, frustumHitsOut, ubo, cssbo, org, dir) \
+    for (int i = 0; i < ubo.viewCnt; i++) \
+    { \
+        FIND_VIEW_INTERSECT(frustumHitsIn, frustumHitsOut, cssbo, org, dir, i); \
+    }
+
+// Only the candidate views of the tile, see novelViewTiles.comp
+#define FIND_INTERSECTS_IN_LIST(frustumHitsIn, frustumHitsOut, viewIds, viewCount, cssbo, org, dir) \
+    for (uint c = 0; c < viewCount; c++) \
+    { \
+        int i = int(viewIds[c]); \
+        FIND_VIEW_INTERSECT(frustumHitsIn, frustumHitsOut, cssbo, org, dir, i); \
     }
 
 #define INSERT_SORT(hits, intersectCount) \
@@ -204,13 +225,115 @@
         } \
     }
 
-#define EVALUATE_AND_SAMPLE_COLOR(org, dir, maxInterval, avg, rayPixSamples, maxViewsUsed) \
+// Levels of the depth pyramid of a view are stored one after another from the finest one
+#define DEPTH_PYRAMID_LEVEL(res, level, levelOffset, levelDims) \
+    levelOffset = 0u; \
+    levelDims = (ivec2(res) + DEPTH_PYRAMID_BASE - 1) / DEPTH_PYRAMID_BASE; \
+    for (int l = 0; l < level; l++) \
+    { \
+        levelOffset += uint(levelDims.x * levelDims.y); \
+        levelDims = (levelDims + 1) / 2; \
+    }
+
+// One bit per segment of the interval, set when a surface seen by one of the used views can lie
+// in the segment, i.e. its depth range overlaps the depth pyramid range under its footprint.
+#define FIND_OCCUPIED_SEGMENTS(org, dir, maxInterval, maxViewsUsed, occupied) \
+    occupied = 0u; \
+    { \
+        uint allSegments = (1u << EMPTY_SPACE_SEGMENTS) - 1u; \
+        float segmentLength = (maxInterval.t.y - maxInterval.t.x) / EMPTY_SPACE_SEGMENTS; \
+        int numOfViews = 0; \
+        \
+        for (int k = 0; k < ubo.viewCnt && occupied != allSegments; k++) \
+        { \
+            bool result = false; \
+            IS_IN_MASK(k, maxInterval.idBits, result); \
+            if (result) \
+            { \
+                vec2 res = cssbo.objects[k].resOffset.xy; \
+                uint depthPyramidOffset = cssbo.objects[k].depthPyramidOffset; \
+                \
+                mat4 viewProj = viewProjs[k]; \
+                vec4 clipOrigin = viewProj * vec4(org + dir * maxInterval.t.x, 1.0); \
+                vec4 clipStep = viewProj * vec4(dir * segmentLength, 0.0); \
+                \
+                for (int s = 0; s < EMPTY_SPACE_SEGMENTS; s++) \
+                { \
+                    vec4 clipStart = clipOrigin + s * clipStep; \
+                    vec4 clipEnd = clipStart + clipStep; \
+                    \
+                    bool segmentOccupied = true; \
+                    if (clipStart.w > 0.0 && clipEnd.w > 0.0) \
+                    { \
+                        vec3 ndcStart = clipStart.xyz / clipStart.w; \
+                        vec3 ndcEnd = clipEnd.xyz / clipEnd.w; \
+                        \
+                        vec2 pixStart = clamp((min(ndcStart.xy, ndcEnd.xy) + 1.0) / 2.0 * res, vec2(0.0), res - 1.0); \
+                        vec2 pixEnd = clamp((max(ndcStart.xy, ndcEnd.xy) + 1.0) / 2.0 * res, vec2(0.0), res - 1.0); \
+                        \
+                        float extent = max(pixEnd.x - pixStart.x, pixEnd.y - pixStart.y) / DEPTH_PYRAMID_BASE; \
+                        int level = clamp(int(ceil(log2(max(extent, 1.0)))), 0, DEPTH_PYRAMID_LEVELS - 1); \
+                        \
+                        uint levelOffset; \
+                        ivec2 levelDims; \
+                        DEPTH_PYRAMID_LEVEL(res, level, levelOffset, levelDims); \
+                        \
+                        ivec2 texelStart = ivec2(pixStart) / (DEPTH_PYRAMID_BASE << level); \
+                        ivec2 texelEnd = ivec2(pixEnd) / (DEPTH_PYRAMID_BASE << level); \
+                        \
+                        if (all(lessThanEqual(texelEnd - texelStart, ivec2(1)))) \
+                        { \
+                            vec2 depthRange = vec2(2.0, -1.0); \
+                            for (int y = texelStart.y; y <= texelEnd.y; y++) \
+                            { \
+                                for (int x = texelStart.x; x <= texelEnd.x; x++) \
+                                { \
+                                    vec2 texelRange = depthPyramid.texels[depthPyramidOffset + levelOffset + \
+                                        uint(y * levelDims.x + x)]; \
+                                    depthRange = vec2(min(depthRange.x, texelRange.x), max(depthRange.y, texelRange.y)); \
+                                } \
+                            } \
+                            \
+                            segmentOccupied = max(ndcStart.z, ndcEnd.z) >= depthRange.x - DEPTH_PYRAMID_EPSILON && \
+                                min(ndcStart.z, ndcEnd.z) <= depthRange.y + DEPTH_PYRAMID_EPSILON; \
+                        } \
+                    } \
+                    \
+                    occupied |= uint(segmentOccupied) << s; \
+                } \
+                \
+                numOfViews++; \
+                if (numOfViews > maxViewsUsed) \
+                { \
+                    break; \
+                } \
+            } \
+        } \
+        \
+        occupied = (occupied == 0u) ? allSegments : occupied; \
+    }
+
+#define IS_SEGMENT_OCCUPIED(t, maxInterval, occupied, result) \
+    { \
+        float intervalLength = max(maxInterval.t.y - maxInterval.t.x, 1e-6); \
+        int segmentId = clamp(int(((t) - maxInterval.t.x) / intervalLength * EMPTY_SPACE_SEGMENTS), 0, EMPTY_SPACE_SEGMENTS - 1); \
+        result = (occupied & (1u << segmentId)) != 0u; \
+    }
+
+#define EVALUATE_AND_SAMPLE_COLOR(org, dir, maxInterval, avg, rayPixSamples, maxViewsUsed, occupied, hitT, hitMetric) \
     float dist = 20; \
     float sampleDist = (maxInterval.t.y - maxInterval.t.x) / rayPixSamples; \
     float segmentStart = maxInterval.t.x; \
     \
     for (int j = 0; j < rayPixSamples; j++) \
     { \
+        bool sampleOccupied = false; \
+        IS_SEGMENT_OCCUPIED(segmentStart + j * sampleDist, maxInterval, occupied, sampleOccupied); \
+        if (!sampleOccupied) \
+        { \
+            continue; \
+        } \
+        \
         vec3 p = org + dir * (segmentStart + j * sampleDist); \
         \
         vec4 localMin = vec4(2); \
@@ -225,14 +348,9 @@
             IS_IN_MASK(k, maxInterval.idBits, result); \
             if (result) \
             { \
-                ViewDataEvalCompute currentView = cssbo.objects[k]; \
-                \
-                vec2 pixId; \
-                CALCULATE_PIX_ID(p, currentView.view,  currentView.proj, \
-                    currentView.resOffset.xy, currentView.resOffset.zw, \
-                    pixId); \
-                \
-                vec2 pixIdNorm = pixId / ubo.viewsTotalRes; \
+                vec2 pixIdNorm; \
+                vec2 dView; \
+                PROJECT_TO_VIEW(p, k, pixIdNorm, dView); \
                 \
                 vec4 pixVal = texture(viewImagesSampler, pixIdNorm); \
                 \
@@ -259,10 +377,12 @@
         { \
             dist = localDist; \
             avg = localAvg; \
+            hitT = segmentStart + j * sampleDist; \
+            hitMetric = localDist; \
         } \
     }
 
-#define EVALUATE_AND_SAMPLE_DEPTH_DIST(org, dir, maxInterval, finalColor, samplingType, rayPixSamples, maxViewsUsed) \
+#define EVALUATE_AND_SAMPLE_DEPTH_DIST(org, dir, maxInterval, finalColor, samplingType, rayPixSamples, maxViewsUsed, occupied, hitT, hitMetric) \
     float sampleDist = (maxInterval.t.y - maxInterval.t.x) / rayPixSamples; \
     float segmentStart = maxInterval.t.x; \
     \
@@ -272,6 +392,13 @@
     float minDist = 1.0 / 0.0; \
     for (int j = 0; j < rayPixSamples; j++) \
     { \
+        bool sampleOccupied = false; \
+        IS_SEGMENT_OCCUPIED(segmentStart + j * sampleDist, maxInterval, occupied, sampleOccupied); \
+        if (!sampleOccupied) \
+        { \
+            continue; \
+        } \
+        \
         vec3 p = org + dir * (segmentStart + j * sampleDist); \
         \
         vec4 colorAcc = vec4(0.0); \
@@ -285,25 +412,14 @@
             IS_IN_MASK(k, maxInterval.idBits, result); \
             if (result) \
             { \
-                ViewDataEvalCompute currentView = cssbo.objects[k]; \
-                \
-                vec2 pixId = vec2(0.0); \
+                vec2 uvView = vec2(0.0); \
                 vec2 dView = vec2(0.0); \
-                CALCULATE_PIX_ID_D(p, currentView.view,  currentView.proj, \
-                    currentView.resOffset.xy, currentView.resOffset.zw, \
-                    pixId, dView); \
+                PROJECT_TO_VIEW(p, k, uvView, dView); \
                 \
-                vec2 uvView = pixId / ubo.viewsTotalRes; \
-                \
-                float n = currentView.nearFar.x; \
-                float f = currentView.nearFar.y; \
                 float z = texture(viewImagesDepthSampler, uvView).r; \
                 \
-                vec4 clipPoint = vec4(dView, z, 1.0); \
-                vec4 viewPoint = currentView.invProj * clipPoint; \
-                viewPoint /= viewPoint.w; \
-                \
-                vec3 worldPoint = (currentView.invView * viewPoint).xyz; \
+                vec3 worldPoint; \
+                UNPROJECT_FROM_VIEW(dView, z, k, worldPoint); \
                 \
                 float pointDistance = 1.0 / 0.0; \
                 if (samplingType == SAMPLE_DEPTH_NORMAL) \
@@ -330,9 +446,185 @@
         { \
             minDist = pointDistAcc; \
             finalColor = colorAcc / numOfViews; \
+            hitT = segmentStart + j * sampleDist; \
+            hitMetric = pointDistAcc; \
         } \
     }
 
+// Consistency of the views of the interval in a single ray sample, lower is better
+#define EVALUATE_SAMPLE(org, p, startP, endP, maxInterval, samplingType, maxViewsUsed, metric, color) \
+    { \
+        vec4 localMin = vec4(2); \
+        vec4 localMax = vec4(-1); \
+        vec4 colorAcc = vec4(0.0); \
+        float pointDistAcc = 0; \
+        \
+        int numOfViews = 0; \
+        \
+        for (int k = 0; k < ubo.viewCnt; k++) \
+        { \
+            bool result = false; \
+            IS_IN_MASK(k, maxInterval.idBits, result); \
+            if (result) \
+            { \
+                vec2 uvView = vec2(0.0); \
+                vec2 dView = vec2(0.0); \
+                PROJECT_TO_VIEW(p, k, uvView, dView); \
+                \
+                vec4 pixVal = texture(viewImagesSampler, uvView); \
+                \
+                if (samplingType == SAMPLE_COLOR) \
+                { \
+                    localMin = min(localMin, pixVal); \
+                    localMax = max(localMax, pixVal); \
+                } \
+                else \
+                { \
+                    float z = texture(viewImagesDepthSampler, uvView).r; \
+                    \
+                    vec3 worldPoint; \
+                    UNPROJECT_FROM_VIEW(dView, z, k, worldPoint); \
+                    \
+                    float pointDistance = 1.0 / 0.0; \
+                    if (samplingType == SAMPLE_DEPTH_NORMAL) \
+                    { \
+                        POINT_TO_LINE_DIST(worldPoint, startP, endP, pointDistance); \
+                    } \
+                    else if (samplingType == SAMPLE_DEPTH_ANGLE) \
+                    { \
+                        LINE_TO_LINE_ANGLE_DIST(org, worldPoint, startP, endP, pointDistance); \
+                    } \
+                    \
+                    pointDistAcc += pointDistance; \
+                } \
+                \
+                colorAcc += pixVal; \
+                \
+                numOfViews++; \
+                if (numOfViews > maxViewsUsed) \
+                { \
+                    break; \
+                } \
+            } \
+        } \
+        \
+        vec4 localVecDist = localMax - localMin; \
+        metric = (samplingType == SAMPLE_COLOR) ? \
+            localVecDist.x + localVecDist.y + localVecDist.z + localVecDist.w : pointDistAcc; \
+        color = colorAcc / float(numOfViews); \
+    }
+
+// Keeps the two lowest local minima of the coarse pass as (t, metric)
+#define INSERT_MINIMUM(minima, t, metric) \
+    if (metric < minima[0].y) \
+    { \
+        minima[1] = minima[0]; \
+        minima[0] = vec2(t, metric); \
+    } \
+    else if (metric < minima[1].y) \
+    { \
+        minima[1] = vec2(t, metric); \
+    }
+
+// Coarse pass over the interval, then the best local minima are bisected down to the spacing of
+// rayPixSamples uniform samples. Stops as soon as a sample gets below the consistency threshold.
+#define EVALUATE_AND_SAMPLE_HIERARCHICAL(org, dir, maxInterval, finalColor, samplingType, rayPixSamples, maxViewsUsed, occupied, hitT, hitMetric) \
+    vec3 startP = org + dir * maxInterval.t.x; \
+    vec3 endP = org + dir * maxInterval.t.y; \
+    \
+    int coarseSamples = min(int(rayPixSamples), max(MIN_COARSE_SAMPLES, int(rayPixSamples) / COARSE_SAMPLES_RATIO)); \
+    float coarseDist = (maxInterval.t.y - maxInterval.t.x) / coarseSamples; \
+    float finestDist = (maxInterval.t.y - maxInterval.t.x) / rayPixSamples; \
+    float threshold = (samplingType == SAMPLE_COLOR) ? REFINE_COLOR_THRESHOLD : REFINE_DEPTH_THRESHOLD; \
+    \
+    vec2 minima[2] = vec2[](vec2(0.0, 1.0 / 0.0), vec2(0.0, 1.0 / 0.0)); \
+    float bestMetric = 1.0 / 0.0; \
+    float prevMetric = 1.0 / 0.0; \
+    bool descending = true; \
+    bool converged = false; \
+    \
+    for (int j = 0; j < coarseSamples && !converged; j++) \
+    { \
+        float t = maxInterval.t.x + j * coarseDist; \
+        vec3 p = org + dir * t; \
+        \
+        float sampleMetric = 1.0 / 0.0; \
+        vec4 sampleColor = vec4(0.0); \
+        bool sampleOccupied = false; \
+        IS_SEGMENT_OCCUPIED(t, maxInterval, occupied, sampleOccupied); \
+        if (sampleOccupied) \
+        { \
+            EVALUATE_SAMPLE(org, p, startP, endP, maxInterval, samplingType, maxViewsUsed, sampleMetric, sampleColor); \
+        } \
+        \
+        if (sampleMetric < bestMetric) \
+        { \
+            bestMetric = sampleMetric; \
+            finalColor = sampleColor; \
+            hitT = t; \
+        } \
+        \
+        if (j > 0 && descending && prevMetric <= sampleMetric) \
+        { \
+            INSERT_MINIMUM(minima, t - coarseDist, prevMetric); \
+        } \
+        \
+        descending = sampleMetric < prevMetric; \
+        prevMetric = sampleMetric; \
+        converged = bestMetric < threshold; \
+    } \
+    \
+    if (descending) \
+    { \
+        INSERT_MINIMUM(minima, maxInterval.t.x + (coarseSamples - 1) * coarseDist, prevMetric); \
+    } \
+    \
+    for (int m = 0; m < 2 && !converged && minima[m].y < 1.0 / 0.0; m++) \
+    { \
+        float t = minima[m].x; \
+        float metric = minima[m].y; \
+        float step = coarseDist; \
+        \
+        for (int level = 0; level < MAX_REFINE_LEVELS && step > finestDist && !converged; level++) \
+        { \
+            step *= 0.5; \
+            float nextT = t; \
+            \
+            for (int s = -1; s <= 1; s += 2) \
+            { \
+                float sampleT = clamp(t + s * step, maxInterval.t.x, maxInterval.t.y); \
+                vec3 p = org + dir * sampleT; \
+                \
+                float sampleMetric = 1.0 / 0.0; \
+                vec4 sampleColor = vec4(0.0); \
+                bool sampleOccupied = false; \
+                IS_SEGMENT_OCCUPIED(sampleT, maxInterval, occupied, sampleOccupied); \
+                if (sampleOccupied) \
+                { \
+                    EVALUATE_SAMPLE(org, p, startP, endP, maxInterval, samplingType, maxViewsUsed, sampleMetric, sampleColor); \
+                } \
+                \
+                if (sampleMetric < bestMetric) \
+                { \
+                    bestMetric = sampleMetric; \
+                    finalColor = sampleColor; \
+                    hitT = sampleT; \
+                } \
+                \
+                if (sampleMetric < metric) \
+                { \
+                    metric = sampleMetric; \
+                    nextT = sampleT; \
+                } \
+            } \
+            \
+            t = nextT; \
+            converged = bestMetric < threshold; \
+        } \
+    } \
+    \
+    hitMetric = bestMetric;
+
 #define EVALUATE_AND_SAMPLE_DEPTH_DIST_TEST_PIXEL(org, dir, maxInterval, finalColor, samplingType, testPixelImage, rayPixSamples, maxViewsUsed) \
     float sampleDist = (maxInterval.t.y - maxInterval.t.x) / rayPixSamples; \
     float segmentStart = maxInterval.t.x; \
@@ -361,15 +653,11 @@
             IS_IN_MASK(k, maxInterval.idBits, result); \
             if (result) \
             { \
-                ViewDataEvalCompute currentView = cssbo.objects[k]; \
-                \
-                vec2 pixId = vec2(0.0); \
+                vec2 uvView = vec2(0.0); \
                 vec2 dView = vec2(0.0); \
-                CALCULATE_PIX_ID_D(p, currentView.view,  currentView.proj, \
-                    currentView.resOffset.xy, currentView.resOffset.zw, \
-                    pixId, dView); \
+                PROJECT_TO_VIEW(p, k, uvView, dView); \
                 \
-                vec2 uvView = pixId / ubo.viewsTotalRes; \
+                vec2 pixId = uvView * ubo.viewsTotalRes; \
                 localSampledPixels[intervalViewCnt] = ivec2(pixId); \
                 \
                 if (j == 0) \
@@ -381,15 +669,10 @@
                     endPixels[intervalViewCnt] = ivec2(pixId); \
                 } \
                 \
-                float n = currentView.nearFar.x; \
-                float f = currentView.nearFar.y; \
                 float z = texture(viewImagesDepthSampler, uvView).r; \
                 \
-                vec4 clipPoint = vec4(dView, z, 1.0); \
-                vec4 viewPoint = currentView.invProj * clipPoint; \
-                viewPoint /= viewPoint.w; \
-                \
-                vec3 worldPoint = (currentView.invView * viewPoint).xyz; \
+                vec3 worldPoint; \
+                UNPROJECT_FROM_VIEW(dView, z, k, worldPoint); \
                 \
                 float pointDistance = 1.0 / 0.0; \
                 if (samplingType == SAMPLE_DEPTH_NORMAL) \
@@ -437,6 +720,55 @@
         } \
     }
 
+// Reverse reprojection of the previous frame. The previous hit stored at the lookup pixel is
+// projected with the current camera, when it does not land on this pixel the lookup moves
+// against the offset. The pixel is reused only if the previous surface maps back onto it.
+#define REPROJECT_HISTORY(org, dir, pixCenter, ubo, history, reused, reusedEntry) \
+    { \
+        vec2 pixelSize = vec2(INTERPOLATE_PIXELS_X, INTERPOLATE_PIXELS_Y); \
+        float confidence = (ubo.samplingType == SAMPLE_COLOR) ? TEMPORAL_COLOR_CONFIDENCE : TEMPORAL_DEPTH_CONFIDENCE; \
+        vec2 lookup = pixCenter; \
+        \
+        for (int it = 0; it < TEMPORAL_REPROJECT_ITERATIONS; it++) \
+        { \
+            ivec2 historyPix = ivec2(floor(lookup / pixelSize)); \
+            if (any(lessThan(historyPix, ivec2(0))) || any(greaterThanEqual(historyPix, ivec2(ubo.historyRes)))) \
+            { \
+                break; \
+            } \
+            \
+            TemporalHistory entry = history.entries[ubo.historyRead + historyPix.y * ubo.historyRes.x + historyPix.x]; \
+            if (!(entry.metric < confidence) || entry.age >= TEMPORAL_MAX_AGE) \
+            { \
+                break; \
+            } \
+            \
+            vec2 prevCenter = (vec2(historyPix) + 0.5) * pixelSize; \
+            vec2 prevD = (prevCenter / ubo.res) * 2.0 - 1.0; \
+            vec4 prevFrom = ubo.prevInvProj * vec4(prevD.x, prevD.y, 0.f, 1.f); \
+            vec4 prevTarget = ubo.prevInvProj * vec4(prevD.x, prevD.y, 1.f, 1.f); \
+            \
+            vec3 prevOrg = (ubo.prevInvView * (prevFrom / prevFrom.w)).xyz; \
+            vec3 prevDir = (ubo.prevInvView * vec4(normalize(prevTarget.xyz / prevTarget.w), 0.f)).xyz; \
+            vec4 clip = ubo.viewProj * vec4(prevOrg + prevDir * entry.t, 1.f); \
+            if (clip.w <= 0.f) \
+            { \
+                break; \
+            } \
+            \
+            vec2 offset = ((clip.xy / clip.w) + 1.0) / 2.0 * ubo.res - pixCenter; \
+            if (length(offset / pixelSize) <= TEMPORAL_PIXEL_TOLERANCE) \
+            { \
+                reused = true; \
+                reusedEntry = entry; \
+                reusedEntry.t = dot(prevOrg + prevDir * entry.t - org, dir); \
+                break; \
+            } \
+            \
+            lookup -= offset; \
+        } \
+    }
+
 // Inspired by:
 // https://stackoverflow.com/questions/4858264/find-the-distance-from-a-3d-point-to-a-line-segment
 #define POINT_TO_LINE_DIST(v, a, b, dist) \
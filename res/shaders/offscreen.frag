@@ -27,10 +27,31 @@ layout(std430, binding=3) readonly buffer ssbo {
 layout(set=1, binding=0) uniform sampler2D texSampler[];
 layout(set=1, binding=1) uniform sampler2D bumpSampler[];
 
+#ifdef GRID_RENDERING
+struct GridViewData
+{
+    mat4 view;
+    mat4 proj;
+    vec4 viewport;
+    uint depthOnly;
+    uint pad[3];
+};
+
+layout(std430, set=2, binding=0) readonly buffer GridViews {
+    GridViewData views[];
+} grid;
+
+layout(location=8) flat in int viewId;
+
+#define DEPTH_ONLY (grid.views[viewId].depthOnly != 0)
+#else
 layout(set=2, binding=2) uniform ViewDataFragment {
     bool depthOnly;
 } vbo;
 
+#define DEPTH_ONLY vbo.depthOnly
+#endif
+
 layout(location=0) flat in int instanceId;
 layout(location=1) in FsInput fsIn;
 
@@ -60,7 +81,7 @@ vec3 bumpToNormal(int bumpId)
 
 void main() 
 {
-    if (vbo.depthOnly)
+    if (DEPTH_ONLY)
     {
         float n = 0.1f;
         float f = 100.f;
@@ -2,6 +2,8 @@
 
 struct MeshShaderDataVertex {
     mat4 model;
+    vec4 positionOffset;
+    vec4 positionScale;
 };
 
 struct VsOut
@@ -17,36 +19,125 @@ layout(std430, binding=1) readonly buffer ssbo {
     MeshShaderDataVertex objects[];
 } vssbo;
 
+#ifdef GRID_RENDERING
+// All the views of the grid in one draw stream, gl_InstanceIndex / MAX_VIEWS is the draw
+#define MAX_VIEWS 64
+
+struct GridViewData
+{
+    mat4 view;
+    mat4 proj;
+    vec4 viewport;
+    uint depthOnly;
+    uint pad[3];
+};
+
+layout(std430, set=2, binding=0) readonly buffer GridViews {
+    GridViewData views[];
+} grid;
+
+layout(std430, set=2, binding=1) readonly buffer GridInstances {
+    uint viewIds[];
+} instances;
+
+layout(location = 8) flat out int outViewId;
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+    float gl_ClipDistance[4];
+};
+#else
 layout(set=2, binding=0) uniform ViewDataVertex {
     mat4 view;
     mat4 proj;
 } ubo;
+#endif
 
+#ifdef PACKED_VERTICES
+// xyz - position (unorm16 in the mesh bounds with QUANTIZED_POSITIONS), w - bitangent sign
+layout(location = 0) in vec4 inPosition;
+// xy - octahedral normal, zw - octahedral tangent
+layout(location = 1) in vec4 inNormalTangent;
+layout(location = 2) in vec2 inUv;
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inNormal;
 layout(location = 3) in vec3 inTangent;
 layout(location = 4) in vec3 inBitangent;
 layout(location = 5) in vec2 inUv;
+#endif
 
 layout(location = 0) out int outInstanceId;
 layout(location = 1) out VsOut vsOut;
 
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.x += v.x >= 0.0 ? -t : t;
+    v.y += v.y >= 0.0 ? -t : t;
+
+    return normalize(v);
+}
+
 void main() 
 {
-    outInstanceId = gl_InstanceIndex;
+#ifdef GRID_RENDERING
+    int drawId = gl_InstanceIndex / MAX_VIEWS;
+    uint viewId = instances.viewIds[gl_InstanceIndex];
+    outViewId = int(viewId);
+#else
+    int drawId = gl_InstanceIndex;
+#endif
+
+    outInstanceId = drawId;
+
+    MeshShaderDataVertex object = vssbo.objects[drawId];
+    mat4 model = object.model;
+
+#ifdef PACKED_VERTICES
+    vec3 position = object.positionOffset.xyz + inPosition.xyz * object.positionScale.xyz;
+    vec3 normal = octDecode(inNormalTangent.xy);
+    vec3 tangent = octDecode(inNormalTangent.zw);
+#ifdef QUANTIZED_POSITIONS
+    float bitangentSign = inPosition.w * 2.0 - 1.0;
+#else
+    float bitangentSign = inPosition.w;
+#endif
+    vec3 bitangent = bitangentSign * cross(normal, tangent);
+    vec3 color = vec3(0.5);
+#else
+    vec3 position = object.positionOffset.xyz + inPosition * object.positionScale.xyz;
+    vec3 normal = inNormal;
+    vec3 tangent = inTangent;
+    vec3 bitangent = inBitangent;
+    vec3 color = inColor;
+#endif
+
+#ifdef GRID_RENDERING
+    GridViewData view = grid.views[viewId];
+    vec4 clipPosition = view.proj * view.view * model * vec4(position, 1.0);
 
-    mat4 model = vssbo.objects[gl_InstanceIndex].model;
+    // clip to the view frustum sides, then move the view into its tile of the framebuffer
+    gl_ClipDistance[0] = clipPosition.w + clipPosition.x;
+    gl_ClipDistance[1] = clipPosition.w - clipPosition.x;
+    gl_ClipDistance[2] = clipPosition.w + clipPosition.y;
+    gl_ClipDistance[3] = clipPosition.w - clipPosition.y;
 
-    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
+    gl_Position = vec4(clipPosition.xy * view.viewport.xy + view.viewport.zw * clipPosition.w, clipPosition.zw);
+#else
+    gl_Position = ubo.proj * ubo.view * model * vec4(position, 1.0);
+#endif
 
-    vsOut.fragPosition = vec3(model * vec4(inPosition, 1.0));
-    vsOut.fragColor = inColor;
-    vsOut.normal = transpose(inverse(mat3(model))) * inNormal;
+    vsOut.fragPosition = vec3(model * vec4(position, 1.0));
+    vsOut.fragColor = color;
+    vsOut.normal = transpose(inverse(mat3(model))) * normal;
     vsOut.uv = inUv;
 
-    vec3 t = normalize(vec3(model * vec4(inTangent, 0.0f)));
-    vec3 b = normalize(vec3(model * vec4(inBitangent, 0.0f)));
-    vec3 n = normalize(vec3(model * vec4(inNormal, 0.0f)));
+    vec3 t = normalize(vec3(model * vec4(tangent, 0.0f)));
+    vec3 b = normalize(vec3(model * vec4(bitangent, 0.0f)));
+    vec3 n = normalize(vec3(model * vec4(normal, 0.0f)));
     vsOut.tbn = mat3(t, b, n);
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ struct ViewDataEvalCompute
     mat4 invProj;
     vec4 resOffset;
     vec2 nearFar;
+    uint depthPyramidOffset;
     vec4 viewDir;
 };
 
@@ -26,6 +27,22 @@ struct IntervalHit {
     uint count;
 };
 
+struct TileViews
+{
+    uint count;
+    uint rate;
+    uint viewIds[MAX_VIEWS];
+};
+
+// Last evaluated sample of a novel view pixel, color is packed unorm RGBA
+struct TemporalHistory
+{
+    uint color;
+    float t;
+    float metric;
+    uint age;
+};
+
 struct FrustumHit
 {
     float t;
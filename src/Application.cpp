@@ -10,6 +10,9 @@
 #include "Application.h"
 #include "RenderPass.h"
 #include "Framebuffer.h"
+#include "TextureLoader.h"
+#include "MemoryAllocator.h"
+#include "Benchmark.h"
 #include "utils/Import.h"
 #include "utils/Callbacks.h"
 #include "utils/Constants.h"
@@ -17,6 +20,8 @@
 #include "utils/Input.h"
 #include "utils/FileHandling.h"
 #include "utils/VulkanHelpers.h"
+#include "utils/Trace.h"
+#include "utils/ImageMetrics.h"
 
 // std
 #include <stdexcept>
@@ -46,7 +51,8 @@ Application::Application(const Arguments& arguments)
     m_samplingType(SamplingType::COLOR),
     m_testedPixel(0.f, 0.f),
     m_intervalCounter(m_interval),
-    m_args(arguments)
+    m_args(arguments),
+    m_startTime(std::chrono::steady_clock::now())
 {
     init();
 }
@@ -61,40 +67,52 @@ Application::~Application()
     m_novelViewGrid->destroyVkResources();
     m_viewGrid->destroyVkResources();
 
-    m_viewMatrixScreenshotImage->destroyVkResources();
-    m_novelViewScreenshotImage->destroyVkResources();
-    m_actualViewScreenshotImage->destroyVkResources();
-
-    m_window->destroyVkResources(m_device->getInstance());
-    m_secondaryWindow->destroyVkResources(m_device->getInstance());
+    if (!m_args.headless)
+    {
+        m_window->destroyVkResources(m_device->getInstance());
+        m_secondaryWindow->destroyVkResources(m_device->getInstance());
 
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    vkDestroyDescriptorPool(m_device->getVkDevice(), m_imguiPool, nullptr);
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        vkDestroyDescriptorPool(m_device->getVkDevice(), m_imguiPool, nullptr);
+    }
 
     m_device->destroyVkResources();
 }
 
 void Application::run()
 {
-    draw();
+    if (m_args.headless)
+        drawHeadless();
+    else
+        draw();
+
+    if (!m_args.traceFile.empty())
+        saveTrace(m_args.traceFile);
 
     vke::utils::saveConfig(std::string(CONFIG_FILES_LOC) + "last.json", m_config, m_novelViewGrid, m_viewGrid);
 }
 
 void Application::init()
 {
+    vke::utils::setTraceThreadName("Main");
+    TRACE_ZONE("Init");
+
     utils::parseConfig(m_args.configFile, m_config);
 
-    m_window = std::make_shared<Window>(m_args.windowResolution.x, m_args.windowResolution.y);
+    // Headless runs without any window, the device and renderer get nullptr.
+    if (!m_args.headless)
+        m_window = std::make_shared<Window>(m_args.windowResolution.x, m_args.windowResolution.y);
 
     m_device = std::make_shared<Device>(m_window);
 
     RendererInitParams params{
         "offscreen.vert.spv", "offscreen.frag.spv", 
-        "cull.comp.spv", 
+        "cull.comp.spv", "cullBatched.comp.spv",
+        "offscreenGrid.vert.spv", "offscreenGrid.frag.spv",
         "quad.vert.spv", "quad.frag.spv", 
-        "novelView.comp.spv",
+        "novelView.comp.spv", "novelViewTiles.comp.spv", "depthPyramid.comp.spv", "novelViewUpsample.comp.spv",
+        "metrics.comp.spv", "metricsReduce.comp.spv",
         "points.vert.spv", "points.frag.spv",
         m_args.windowResolution, m_args.novelResolution,
         m_args.viewGridResolution
@@ -103,11 +121,14 @@ void Application::init()
     m_renderer = std::make_shared<Renderer>(m_device, m_window, params);
     m_renderer->setNovelViewSamplingType(m_samplingType);
 
-    m_secondaryWindow = std::make_shared<Window>(m_args.windowResolution.x, m_args.windowResolution.y, false);
-    m_secondaryWindow->createWindowSurface(m_device->getInstance());
-    glfwSetWindowCloseCallback(m_secondaryWindow->getWindow(), secondaryWindowCloseCallback);
+    if (!m_args.headless)
+    {
+        m_secondaryWindow = std::make_shared<Window>(m_args.windowResolution.x, m_args.windowResolution.y, false);
+        m_secondaryWindow->createWindowSurface(m_device->getInstance());
+        glfwSetWindowCloseCallback(m_secondaryWindow->getWindow(), secondaryWindowCloseCallback);
 
-    m_renderer->addSecondaryWindow(m_secondaryWindow);
+        m_renderer->addSecondaryWindow(m_secondaryWindow);
+    }
 
     createScene();
     createMainView();
@@ -115,27 +136,18 @@ void Application::init()
     VkExtent2D vmRes = m_renderer->getViewMatrixFramebuffer()->getResolution();
     m_viewGrid = std::make_shared<ViewGrid>(m_device, glm::vec2(vmRes.width, vmRes.height), m_config, 
         m_renderer->getViewDescriptorSetLayout(), m_renderer->getViewDescriptorPool(), m_cameraCube);
+    m_configGridSize = glm::ivec2(m_viewGrid->getGridSize());
     
     m_viewsFov = m_config.gridFov;
 
     m_renderer->initDescriptorResources();
     
-    initImgui();
-    renderViewMatrix(m_viewGrid, m_renderer->getViewMatrixFramebuffer(), false);
-
-    m_viewMatrixScreenshotImage = std::make_shared<Image>(m_device, m_args.viewGridResolution, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    m_viewMatrixScreenshotImage->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-
-    m_novelViewScreenshotImage = std::make_shared<Image>(m_device, m_args.novelResolution, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    m_novelViewScreenshotImage->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+    if (!m_args.headless)
+        initImgui();
 
-    m_actualViewScreenshotImage = std::make_shared<Image>(m_device, m_args.novelResolution, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    m_actualViewScreenshotImage->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+    renderViewMatrix(m_viewGrid, m_renderer->getViewMatrixFramebuffer(), false);
 
-    m_prevTime = glfwGetTime();
+    m_prevTime = getTime();
 
     m_numberOfViewsUsed = m_viewGrid->getViews().size();
 
@@ -145,7 +157,9 @@ void Application::init()
 
         if (!m_args.mseGt && m_args.evalType != Arguments::EvaluationType::GT)
         {
-            m_renderNovel = true;
+            // the MSE evaluation shows the ground truth and compares the novel view with it
+            m_compareNovelView = m_args.evalType == Arguments::EvaluationType::MSE;
+            m_renderNovel = !m_compareNovelView;
             m_samplingType = m_args.samplingType;
             m_renderer->setNovelViewSamplingType(m_samplingType);
 
@@ -162,10 +176,14 @@ void Application::init()
                 m_numberOfRaySamples = m_args.numberOfSamples;
             }
 
-            vkDeviceWaitIdle(m_device->getVkDevice());
+            // below 100 % the flat tiles are evaluated at a lower rate
+            m_novelViewQuality = m_args.quality / 100.f;
+            m_variableRate = m_args.quality < 100;
+
             renderViewMatrix(m_novelViewGrid, m_renderer->getOffscreenFramebuffer(), true);
-            vkDeviceWaitIdle(m_device->getVkDevice());
-            m_renderer->changeQuadRenderPassSource(m_renderer->getNovelImageInfo(), true);
+
+            if (m_renderNovel)
+                m_renderer->changeQuadRenderPassSourceToNovelView(true);
         }
     }
 }
@@ -188,6 +206,8 @@ void Application::draw()
 
     while (!glfwWindowShouldClose(m_window->getWindow()) && !m_terminate)
     {
+        TRACE_ZONE("Frame");
+
         // Choose respective resources, which will be rendered mainly.
         viewGrid = m_renderFromViews ? m_viewGrid : m_novelViewGrid;
         framebuffer = m_renderFromViews ? m_renderer->getViewMatrixFramebuffer()
@@ -196,7 +216,6 @@ void Application::draw()
         // Consume input and set flag to change scene resources.
         if (consumeInput())
         {
-            m_renderer->setSceneChanged(0);
             m_scene->setSceneChanged(true);
 
             if (m_novelSecondWindow)
@@ -206,6 +225,10 @@ void Application::draw()
         // Reconstruct matrices for the main views;
         viewGrid->reconstructMatrices();
 
+        // Render again the tiles of the view matrix whose views changed.
+        if (!m_pointClouds && (m_renderNovel || m_novelSecondWindow || m_compareNovelView))
+            updateViewMatrix();
+
         // Begin compute pass.
         if (!m_pointClouds)
         {
@@ -213,12 +236,13 @@ void Application::draw()
 
             if (m_evaluate)
             {
+                GpuZoneTotal total = m_renderer->getProfiler()->takeTotal("Evaluation compute");
                 if (m_evaluateFrames >= MAX_FRAMES_IN_FLIGHT)
                 {
-                    m_evaluateTotalDuration += m_renderer->collectQuery(true);
+                    m_evaluateTotalDuration += total.duration;
                 }
                 
-                m_renderer->startQuery(true);
+                m_renderer->beginGpuZone("Evaluation compute", true);
             }
 
             // Perform frustum culling when the novel view isn't rendered.
@@ -228,17 +252,18 @@ void Application::draw()
             }
             
             // Perform compute pass for extrapolating the novel view.
-            if (m_renderNovel || m_novelSecondWindow)
+            if (m_renderNovel || m_novelSecondWindow || m_compareNovelView)
             {
                 m_renderer->rayEvalComputePass(m_novelViewGrid, m_viewGrid, 
                     RayEvalParams{m_testPixels, m_testedPixel, m_numberOfRaySamples, 
                     m_automaticSampleCount, m_thresholdDepth, m_maxSampleDistance, 
-                    m_numberOfViewsUsed});
+                    m_numberOfViewsUsed, m_hierarchicalSampling, m_emptySpaceSkipping,
+                    m_temporalReuse, m_variableRate, m_novelViewQuality});
             }
 
             if (m_evaluate)
             {
-                m_renderer->endQuery(true);
+                m_renderer->endGpuZone(true);
             }
             
             // End compute pass and submit it.
@@ -258,12 +283,13 @@ void Application::draw()
 
         if (m_evaluate)
         {
+            GpuZoneTotal total = m_renderer->getProfiler()->takeTotal("Evaluation graphics");
             if (m_evaluateFrames >= MAX_FRAMES_IN_FLIGHT)
             {
-                m_evaluateTotalDuration += m_renderer->collectQuery();
+                m_evaluateTotalDuration += total.duration;
             }
             
-            m_renderer->startQuery();
+            m_renderer->beginGpuZone("Evaluation graphics");
         }
         
         // Render triangular scene into a offscreen framebuffer.
@@ -282,7 +308,7 @@ void Application::draw()
         }
 
         // Image memory barrier for novel view image.
-        if (m_renderNovel || m_novelSecondWindow)
+        if (m_renderNovel || m_novelSecondWindow || m_compareNovelView)
             m_renderer->setNovelViewBarrier();
         
         if (!m_renderNovel)
@@ -292,6 +318,10 @@ void Application::draw()
             else if (m_renderFromViews)
                 m_renderer->setViewMatrixFramebufferBarrier();
         }
+
+        // The offscreen framebuffer holds the ground truth of the novel view camera.
+        if (m_compareNovelView && !m_args.cpuMetrics && !m_renderNovel && !m_renderFromViews)
+            m_renderer->metricsPass(m_evaluateTotalMseSteps);
         
         // Renders the offscreen framebuffer or novel view into the swapchain framebuffer.
         m_renderer->beginRenderPass(m_renderer->getQuadRenderPass(), m_renderer->getQuadFramebuffer());
@@ -303,7 +333,7 @@ void Application::draw()
 
         if (m_evaluate)
         {
-            m_renderer->endQuery();
+            m_renderer->endGpuZone();
             m_evaluateFrames++;
         }
         
@@ -323,6 +353,9 @@ void Application::draw()
             m_renderer->endRenderPass();
         }
 
+        // Copies the screenshot and the evaluation images, they are saved once the frame finished.
+        recordReadbacks();
+
         // Ends render command buffer.
         m_renderer->endCommandBuffer();
         // Submit the frame and present it.
@@ -342,10 +375,209 @@ void Application::draw()
     vkDeviceWaitIdle(m_device->getVkDevice());
 }
 
+void Application::drawHeadless()
+{
+    double lastTime = getTime();
+    int frames = 0;
+    int lastFps = 0;
+
+    while (!m_terminate)
+    {
+        TRACE_ZONE("Frame");
+
+        drawHeadlessFrame();
+
+        countFps(frames, lastFps, lastTime);
+
+        handleGuiInputChanges();
+    }
+
+    vkDeviceWaitIdle(m_device->getVkDevice());
+}
+
+void Application::drawHeadlessFrame()
+{
+    std::shared_ptr<ViewGrid> viewGrid = m_renderFromViews ? m_viewGrid : m_novelViewGrid;
+    std::shared_ptr<Framebuffer> framebuffer = m_renderFromViews ? m_renderer->getViewMatrixFramebuffer()
+        : m_renderer->getOffscreenFramebuffer();
+
+    // Only the evaluation moves the camera when headless.
+    if (consumeInput())
+    {
+        m_scene->setSceneChanged(true);
+    }
+
+    viewGrid->reconstructMatrices();
+
+    // Compute pass - culling for the ground truth, ray evaluation for the novel view.
+    m_renderer->beginComputePass();
+
+    if (m_evaluate)
+    {
+        GpuZoneTotal total = m_renderer->getProfiler()->takeTotal("Evaluation compute");
+        if (m_evaluateFrames >= MAX_FRAMES_IN_FLIGHT && total.samples > 0)
+        {
+            m_lastComputeDuration = total.duration / total.samples;
+            m_evaluateTotalDuration += total.duration;
+        }
+
+        m_renderer->beginGpuZone("Evaluation compute", true);
+    }
+
+    if (!m_renderNovel)
+    {
+        m_renderer->cullComputePass(m_scene, viewGrid, (!m_renderFromViews));
+    }
+
+    if (m_renderNovel || m_compareNovelView)
+    {
+        m_renderer->rayEvalComputePass(m_novelViewGrid, m_viewGrid,
+            RayEvalParams{false, m_testedPixel, m_numberOfRaySamples,
+            m_automaticSampleCount, m_thresholdDepth, m_maxSampleDistance,
+            m_numberOfViewsUsed, m_hierarchicalSampling, m_emptySpaceSkipping, false,
+            m_variableRate, m_novelViewQuality});
+    }
+
+    if (m_evaluate)
+    {
+        m_renderer->endGpuZone(true);
+    }
+
+    m_renderer->endComputePass();
+    m_renderer->submitCompute();
+
+    // Graphics pass into the offscreen framebuffer, synchronized with the frame fence.
+    m_renderer->prepareOffscreenFrame();
+    m_renderer->beginCommandBuffer();
+
+    if (m_evaluate)
+    {
+        GpuZoneTotal total = m_renderer->getProfiler()->takeTotal("Evaluation graphics");
+        if (m_evaluateFrames >= MAX_FRAMES_IN_FLIGHT && total.samples > 0)
+        {
+            m_lastGraphicsDuration = total.duration / total.samples;
+            m_evaluateTotalDuration += total.duration;
+        }
+
+        m_renderer->beginGpuZone("Evaluation graphics");
+    }
+
+    if (!m_renderNovel)
+    {
+        m_renderer->beginRenderPass(m_renderer->getOffscreenRenderPass(), framebuffer);
+        m_renderer->renderPass(m_scene, viewGrid, m_viewGrid);
+        m_renderer->endRenderPass();
+
+        if (!m_renderFromViews)
+            m_renderer->setOffscreenFramebufferBarrier();
+        else
+            m_renderer->setViewMatrixFramebufferBarrier();
+    }
+
+    if (m_renderNovel || m_compareNovelView)
+    {
+        m_renderer->setNovelViewBarrier();
+    }
+
+    if (m_compareNovelView && !m_args.cpuMetrics && !m_renderNovel && !m_renderFromViews)
+    {
+        m_renderer->metricsPass(m_evaluateTotalMseSteps);
+    }
+
+    if (m_evaluate)
+    {
+        m_renderer->endGpuZone();
+        m_evaluateFrames++;
+    }
+
+    recordReadbacks();
+
+    m_renderer->endCommandBuffer();
+    m_renderer->submitOffscreenFrame();
+}
+
+int Application::runBenchmarkCase(const BenchmarkCase& benchCase, std::vector<BenchmarkFrame>& frames)
+{
+    if (!m_args.headless)
+        throw std::runtime_error("Benchmark cases can only be run headless.");
+
+    // the previous case may have resized the grid, a zero size goes back to the grid of the config
+    if (benchCase.gridSize.x > 0 && benchCase.gridSize.y > 0)
+        resizeViewGrid(benchCase.gridSize);
+    else
+        resizeViewGrid(m_configGridSize);
+
+    renderViewMatrix(m_viewGrid, m_renderer->getViewMatrixFramebuffer(), false);
+
+    int viewCount = m_viewGrid->getViews().size();
+
+    // same setup as the evaluation of the novel view
+    m_renderNovel = true;
+    m_samplingType = benchCase.samplingType;
+    m_renderer->setNovelViewSamplingType(m_samplingType);
+    m_numberOfRaySamples = benchCase.raySamples;
+    m_numberOfViewsUsed = (benchCase.maxViewsUsed > 0) ? std::min(benchCase.maxViewsUsed, viewCount) : viewCount;
+
+    renderViewMatrix(m_novelViewGrid, m_renderer->getOffscreenFramebuffer(), true);
+    m_renderer->changeQuadRenderPassSourceToNovelView(true);
+
+    m_evaluate = true;
+    m_evaluateFrames = 0;
+    m_evaluateTotalDuration = 0;
+
+    // the zones are read by the profiler once their frame finished, MAX_FRAMES_IN_FLIGHT frames later
+    std::vector<float> cpuDurations;
+    int frameCount = benchCase.warmupFrames + benchCase.measuredFrames + MAX_FRAMES_IN_FLIGHT;
+
+    for (int i = 0; i < frameCount; i++)
+    {
+        TRACE_ZONE("Frame");
+
+        auto start = std::chrono::steady_clock::now();
+        drawHeadlessFrame();
+        cpuDurations.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        int frame = i - MAX_FRAMES_IN_FLIGHT;
+        if (frame >= benchCase.warmupFrames)
+            frames.push_back(BenchmarkFrame{ cpuDurations[frame], m_lastComputeDuration, m_lastGraphicsDuration });
+    }
+
+    m_renderer->waitForFrames();
+    m_evaluate = false;
+
+    return viewCount;
+}
+
+void Application::resizeViewGrid(const glm::ivec2& gridSize)
+{
+    // the grid ignores the changes over MAX_VIEWS, the loops end once nothing changes
+    glm::vec2 size = m_viewGrid->getGridSize();
+    glm::vec2 previousSize(-1.f);
+
+    while (size != previousSize && size != glm::vec2(gridSize))
+    {
+        previousSize = size;
+
+        if (size.y < gridSize.y)
+            m_viewGrid->addRow();
+        else if (size.y > gridSize.y)
+            retireViews(m_viewGrid->removeRow());
+        else if (size.x < gridSize.x)
+            m_viewGrid->addColumn();
+        else if (size.x > gridSize.x)
+            retireViews(m_viewGrid->removeColumn());
+
+        size = m_viewGrid->getGridSize();
+    }
+}
+
 void Application::renderViewMatrix(std::shared_ptr<ViewGrid> grid, std::shared_ptr<Framebuffer> framebuffer, bool novelView)
 {
     grid->reconstructMatrices();
 
+    // The ray evaluation of the frames in flight may still sample the views on the compute queue.
+    m_renderer->waitForFrames();
+
     // Run the culling compute pass.
     m_renderer->beginComputePass();
     m_renderer->cullComputePass(m_scene, grid, novelView);
@@ -353,30 +585,74 @@ void Application::renderViewMatrix(std::shared_ptr<ViewGrid> grid, std::shared_p
     m_renderer->submitCompute();
 
     // Render the scene.
+    m_renderer->prepareOffscreenFrame();
     m_renderer->beginCommandBuffer();
     m_renderer->beginRenderPass(m_renderer->getOffscreenRenderPass(), framebuffer);
     m_renderer->renderPass(m_scene, grid, m_viewGrid);
     m_renderer->endRenderPass();
 
+    // Depth bounds of the views for the empty space skipping.
+    if (!novelView)
+        m_renderer->depthPyramidPass(grid);
+
     // Copy the data into the test framebuffer.
     m_renderer->copyOffscreenFrameBufferToSupp();
 
     m_renderer->endCommandBuffer();
     m_renderer->submitGraphics();
 
-    m_renderer->setSceneChanged(0);
-    m_renderer->setLightChanged(0);
+    if (!novelView)
+    {
+        grid->setViewsRendered();
+        m_viewMatrixSceneVersion = m_scene->getVersion();
+    }
+}
+
+void Application::updateViewMatrix()
+{
+    m_viewGrid->reconstructMatrices();
+
+    if (m_scene->getVersion() != m_viewMatrixSceneVersion)
+    {
+        m_viewGrid->setViewsDirty();
+        m_viewMatrixSceneVersion = m_scene->getVersion();
+    }
+
+    std::vector<std::shared_ptr<View>> dirtyViews = m_viewGrid->getDirtyViews();
+
+    if (dirtyViews.empty())
+        return;
+
+    // The camera geometry of a moved view is seen by the other views too.
+    if (m_scene->getRenderDebugGeometryFlag())
+    {
+        renderViewMatrix(m_viewGrid, m_renderer->getViewMatrixFramebuffer(), false);
+        return;
+    }
+
+    m_renderer->updateViewMatrix(m_scene, m_viewGrid, dirtyViews);
 
+    for (auto& view : dirtyViews)
+        view->setRendered();
 }
 
 bool Application::consumeInput()
 {
-    glfwPollEvents();
+    TRACE_ZONE("Input");
 
-    ImGuiIO& io = ImGui::GetIO();
-    if (!io.WantCaptureMouse && !io.WantCaptureKeyboard)
+    bool inputCaptured = false;
+
+    if (!m_args.headless)
+    {
+        glfwPollEvents();
+
+        ImGuiIO& io = ImGui::GetIO();
+        inputCaptured = io.WantCaptureMouse || io.WantCaptureKeyboard;
+    }
+
+    if (!inputCaptured)
     {
-        float now = glfwGetTime();
+        float now = getTime();
         float delta = now - m_prevTime;
         m_prevTime = now;
 
@@ -513,6 +789,10 @@ bool Application::consumeInput()
 
         m_intervalCounter = m_interval;
 
+        // There are no windows to take the input from.
+        if (m_args.headless)
+            return false;
+
         VkExtent2D fbSize = (m_renderFromViews) ? m_renderer->getViewMatrixFramebuffer()->getResolution() : m_renderer->getOffscreenFramebuffer()->getResolution();
         glm::vec2 windowSize = m_window->getResolution();
         glm::vec2 secondaryWindowSize = m_secondaryWindow->getResolution();
@@ -593,6 +873,8 @@ void Application::initImgui()
 
 void Application::renderImgui(int lastFps)
 {
+    TRACE_ZONE("ImGui");
+
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -602,6 +884,82 @@ void Application::renderImgui(int lastFps)
     std::string fpsStr = std::to_string(lastFps) + "fps";
     ImGui::Text(fpsStr.c_str(), "warning fix");
 
+    if (ImGui::CollapsingHeader("Device memory"))
+    {
+        MemoryAllocator::Stats stats = m_device->getAllocator()->getStats();
+        const float mib = 1024.f * 1024.f;
+
+        ImGui::Text("Reserved: %.1f MiB", stats.reservedBytes / mib);
+        ImGui::Text("Used: %.1f MiB", stats.usedBytes / mib);
+        ImGui::Text("Fragmented: %.1f MiB", stats.fragmentedBytes / mib);
+        ImGui::Text("Allocations: %u (%u device allocations)", stats.allocationCount, stats.deviceAllocationCount);
+    }
+
+    if (ImGui::CollapsingHeader("Frame stages"))
+    {
+        // from the submission until the CPU saw the timeline point, not the GPU time
+        const char* stageNames[] = { "Cull", "View matrix", "Ray evaluation", "Quad" };
+        for (int i = 0; i < static_cast<int>(FrameStage::COUNT); i++)
+        {
+            ImGui::Text("%s: %.2f ms", stageNames[i], m_renderer->getStageTiming(static_cast<FrameStage>(i)).latency);
+        }
+    }
+
+    if (ImGui::CollapsingHeader("GPU passes"))
+    {
+        std::shared_ptr<GpuProfiler> profiler = m_renderer->getProfiler();
+
+        // rolling statistics over the last GpuProfiler::WINDOW_SIZE samples of every zone
+        if (ImGui::BeginTable("GPU passes", 5))
+        {
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("Mean");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p95");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableHeadersRow();
+
+            for (auto& zone : profiler->getStats())
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", zone.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f ms", zone.mean);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f ms", zone.p50);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f ms", zone.p95);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f ms", zone.p99);
+            }
+
+            ImGui::EndTable();
+        }
+
+        if (ImGui::Button("Export CSV"))
+        {
+            std::filesystem::create_directories(PROFILE_FILES_LOC);
+            profiler->exportCsv(std::string(PROFILE_FILES_LOC) + "gpuPasses.csv");
+        }
+
+        ImGui::SameLine();
+
+        if (ImGui::Button("Export JSON"))
+        {
+            std::filesystem::create_directories(PROFILE_FILES_LOC);
+            profiler->exportJson(std::string(PROFILE_FILES_LOC) + "gpuPasses.json");
+        }
+
+        ImGui::SameLine();
+
+        if (ImGui::Button("Save trace"))
+        {
+            saveTrace("trace.json");
+        }
+    }
+
+
     if (ImGui::Button("Screenshot"))
     {
         m_screenshot = true;
@@ -672,6 +1030,13 @@ void Application::renderImgui(int lastFps)
             ImGui::Indent();
 
             ImGui::Checkbox("Automatic sample count", &m_automaticSampleCount);
+            ImGui::Checkbox("Hierarchical sampling", &m_hierarchicalSampling);
+            ImGui::Checkbox("Empty space skipping", &m_emptySpaceSkipping);
+            ImGui::Checkbox("Temporal reuse", &m_temporalReuse);
+            ImGui::Checkbox("Variable rate", &m_variableRate);
+
+            ImGui::Text("Quality / performance:");
+            ImGui::SliderFloat("Quality", &m_novelViewQuality, 0.f, 1.f);
 
             ImGui::Text("Number of ray samples:");
             ImGui::SliderInt("Samples", &m_numberOfRaySamples, MIN_RAY_SAMPLES, MAX_RAY_SAMPLES);
@@ -748,14 +1113,11 @@ void Application::renderImgui(int lastFps)
             {
                 m_scene->addDebugCameraGeometry(m_viewGrid->getViews());
                 m_scene->setSceneChanged(true);
-                m_renderer->setSceneChanged(0);
-
             }
             else
             {
                 m_scene->setRenderDebugGeometryFlag(false);
                 m_scene->setSceneChanged(true);
-                m_renderer->setSceneChanged(0);
             }
         }
         
@@ -767,9 +1129,6 @@ void Application::renderImgui(int lastFps)
             if (ImGui::DragFloat("FOV", &m_viewsFov, 1.f, 30.f, 120.f))
             {
                 m_viewGrid->setFov(m_viewsFov);
-                
-                if (!m_renderFromViews && (m_renderNovel || m_novelSecondWindow))
-                    m_reRenderViewMatrix = true;
             }
 
             ImGui::PopID();
@@ -789,7 +1148,7 @@ void Application::renderImgui(int lastFps)
 
             if (ImGui::Button("Remove row"))
             {
-                m_removeRow = 0;
+                m_removeRow = true;
             }
 
             if (ImGui::Button("Add column"))
@@ -801,7 +1160,7 @@ void Application::renderImgui(int lastFps)
 
             if (ImGui::Button("Remove column"))
             {
-                m_removeCol = 0;
+                m_removeCol = true;
             }
 
             int viewId = 0;
@@ -930,7 +1289,16 @@ void Application::renderImgui(int lastFps)
     ImGui::End();
 
     ImGui::Render();
+
+    m_renderer->beginGpuZone("ImGui");
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), m_renderer->getCommandBuffer(m_renderer->getCurrentFrame()));
+    m_renderer->endGpuZone();
+}
+
+void Application::saveTrace(const std::string& filename)
+{
+    std::filesystem::create_directories(PROFILE_FILES_LOC);
+    vke::utils::writeTrace(std::string(PROFILE_FILES_LOC) + filename);
 }
 
 void Application::cleanup()
@@ -963,29 +1331,38 @@ void Application::createScene()
     createModels();
 
     m_scene->setModels(m_device, m_renderer->getSceneComputeDescriptorSetLayout(),
-        m_renderer->getSceneComputeDescriptorPool(), m_models, m_vertices, m_indices);
+        m_renderer->getSceneComputeDescriptorPool(), m_models, *m_geometry);
+
+    // geometry is in the device buffers now, the host copy is not needed anymore
+    m_geometry->release();
 
     m_scene->hideModel(m_cameraCube);
 }
 
 void Application::createModels()
 {
+    m_geometry = std::make_shared<GeometryArena>();
+
     for (auto& modelPath : m_config.models)
     {
-        std::shared_ptr<Model> model = vke::utils::importModel(modelPath, m_vertices,
-            m_indices);
-        model->afterImportInit(m_device, m_renderer);
-
+        std::shared_ptr<Model> model = vke::utils::importModelCached(modelPath, *m_geometry);
         m_models.push_back(model);
     }
 
     m_models[m_models.size() - 1]->setModelMatrix(glm::scale(glm::mat4(1.f), glm::vec3(0.1f, 0.1f, 0.1f)));
 
-    m_cameraCube = vke::utils::importModel(m_config.viewGeometry,
-        m_vertices, m_indices);
-    m_cameraCube->afterImportInit(m_device, m_renderer);
+    m_cameraCube = vke::utils::importModelCached(m_config.viewGeometry, *m_geometry);
     m_models.push_back(m_cameraCube);
 
+    // decode and upload all the textures at once, the meshes only look up their ids afterwards
+    TextureLoader textureLoader(m_device);
+    textureLoader.loadTextures(m_models, m_renderer);
+
+    for (auto& model : m_models)
+    {
+        model->afterImportInit(m_device, m_renderer);
+    }
+
 #if DRAW_LIGHT
     m_light->afterImportInit(m_device, m_renderer);
     glm::mat4 lightMatrix = m_light->getModelMatrix();
@@ -997,24 +1374,33 @@ void Application::createModels()
 
 void Application::countFps(int& frames, int& lastFps, double& lastTime)
 {
-    double currentTime = glfwGetTime();
+    double currentTime = getTime();
     frames++;
     if (currentTime - lastTime >= 1.f)
     {
         lastFps = frames;
         frames = 0;
 
-        lastTime = glfwGetTime();
+        lastTime = getTime();
+
+        if (m_args.headless)
+            std::cout << lastFps << "fps" << std::endl;
     }
 }
 
+double Application::getTime() const
+{
+    if (!m_args.headless)
+        return glfwGetTime();
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
 void Application::handleGuiInputChanges()
 {
-    // Switches the source image for the on screen render pass.
+    // Switches the source image for the on screen render pass, one frame's descriptor set at a time.
     if (m_changeOffscreenTarget < MAX_FRAMES_IN_FLIGHT)
     {
-        vkDeviceWaitIdle(m_device->getVkDevice());
-        
         if (m_renderFromViews && !m_testPixels)
         {
             if (!m_depthOnly)
@@ -1028,7 +1414,7 @@ void Application::handleGuiInputChanges()
         }
         else if (m_renderNovel)
         {
-            m_renderer->changeQuadRenderPassSource(m_renderer->getNovelImageInfo());
+            m_renderer->changeQuadRenderPassSourceToNovelView();
         }
         else
         {
@@ -1041,7 +1427,7 @@ void Application::handleGuiInputChanges()
         m_changeOffscreenTarget++;
     }
 
-    if (m_novelSecondWindow && !m_secondaryWindow->getVisible())
+    if (m_novelSecondWindow && m_secondaryWindow && !m_secondaryWindow->getVisible())
     {
         m_secondWindowChanged = true;
     }
@@ -1049,106 +1435,29 @@ void Application::handleGuiInputChanges()
     // Turns on and off the secondary window rendering.
     if (m_secondWindowChanged)
     {
-        vkDeviceWaitIdle(m_device->getVkDevice());
+        m_renderer->waitForFrames();
         m_secondWindowChanged = false;
         m_novelSecondWindow = !m_novelSecondWindow;
         m_secondaryWindow->setVisible(m_novelSecondWindow);
     }
 
-    if (m_reRenderViewMatrix)
-    {
-        vkDeviceWaitIdle(m_device->getVkDevice());
-        renderViewMatrix(m_viewGrid, m_renderer->getViewMatrixFramebuffer(), false);
-        m_reRenderViewMatrix = false;
-        vkDeviceWaitIdle(m_device->getVkDevice());
-    }
-
-    if (m_imagesSaved && m_threadStarted)
+    uint32_t screenshotsWritten = m_screenshotsWritten.load();
+    if (screenshotsWritten != m_screenshotsShown)
     {
-        m_saveImageThread.join();
-        m_threadStarted = false;
-        m_viewMatrixScreenshotImage->unmap();
-        m_actualViewScreenshotImage->unmap();
-        m_novelViewScreenshotImage->unmap();
+        m_screenshotsShown = screenshotsWritten;
         m_screenshotSaved = 1;
     }
 
-    if (m_screenshot && !m_threadStarted)
+    if (m_removeRow)
     {
-        std::time_t t = std::time(nullptr);
-        std::tm tm = *std::localtime(&t);
-        std::ostringstream oss;
-        oss << std::put_time(&tm, "%d-%m-%Y_%H-%M-%S/");
-        std::string timeString = oss.str();
-        std::string screenshotFolder = std::string(SCREENSHOT_FILES_LOC) + timeString;
-        std::filesystem::create_directories(screenshotFolder);
-
-        VkCommandBuffer commandBuffer;
-        m_device->beginSingleCommands(commandBuffer);
-
-        m_device->copyImageToImage(m_renderer->getViewMatrixFramebuffer()->getColorImage(), m_viewMatrixScreenshotImage,
-            commandBuffer);
-        
-        m_device->copyImageToImage(m_renderer->getOffscreenFramebuffer()->getColorImage(), m_actualViewScreenshotImage,
-            commandBuffer);
-
-        m_device->copyImageToImage(m_renderer->getNovelViewImage(), m_novelViewScreenshotImage, commandBuffer);
-
-        m_device->endSingleCommands(commandBuffer);
-
-        m_viewMatrixScreenshotImage->map();
-        void* viewMatrixData = m_viewMatrixScreenshotImage->getMapped();
-        glm::ivec3 viewMatrixDims = glm::ivec3(m_viewMatrixScreenshotImage->getDims(), 4);
-
-        m_actualViewScreenshotImage->map();
-        void* actualViewData = m_actualViewScreenshotImage->getMapped();
-        glm::ivec3 actualViewDims = glm::ivec3(m_actualViewScreenshotImage->getDims(), 4);
-
-        m_novelViewScreenshotImage->map();
-        void* novelData = m_novelViewScreenshotImage->getMapped();
-        glm::ivec3 novelDims = glm::ivec3(m_novelViewScreenshotImage->getDims(), 4);
-
-        std::vector<SaveImageInfo> saveImageInfos = {
-            SaveImageInfo{screenshotFolder + "viewMatrix.ppm", viewMatrixDims, (uint8_t*)viewMatrixData},
-            SaveImageInfo{screenshotFolder + "gtView.ppm", actualViewDims, (uint8_t*)actualViewData},
-            SaveImageInfo{screenshotFolder + "novelView.ppm", novelDims, (uint8_t*)novelData}
-        };
-
-        m_imagesSaved = false;
-        m_threadStarted = true;
-        m_saveImageThread = std::thread(vke::utils::saveImagesThread, saveImageInfos, std::ref(m_imagesSaved));
-
-        vke::utils::saveConfig(screenshotFolder + "config.json", m_config, m_novelViewGrid, m_viewGrid);
-
-        m_screenshot = false;
+        retireViews(m_viewGrid->removeRow());
+        m_removeRow = false;
     }
 
-    if (m_removeRow < MAX_FRAMES_IN_FLIGHT)
+    if (m_removeCol)
     {
-        vkDeviceWaitIdle(m_device->getVkDevice());
-        if (MAX_FRAMES_IN_FLIGHT == 1)
-        {
-            m_viewGrid->removeRow(m_renderer->getCurrentFrame(), false);
-        }
-        else
-        {
-            m_viewGrid->removeRow(!m_renderer->getCurrentFrame(), m_removeRow == 0);
-        }
-        m_removeRow++;
-    }
-
-    if (m_removeCol < MAX_FRAMES_IN_FLIGHT)
-    {
-        vkDeviceWaitIdle(m_device->getVkDevice());
-        if (MAX_FRAMES_IN_FLIGHT == 1)
-        {
-            m_viewGrid->removeColumn(m_renderer->getCurrentFrame(), false);
-        }
-        else
-        {
-            m_viewGrid->removeColumn(!m_renderer->getCurrentFrame(), (m_removeCol == 0));
-        }
-        m_removeCol++;
+        retireViews(m_viewGrid->removeColumn());
+        m_removeCol = false;
     }
 
     if (m_evaluate)
@@ -1201,44 +1510,165 @@ void Application::handleGuiInputChanges()
 
         if (m_args.evalType == Arguments::EvaluationType::MSE)
         {
-            std::string folder = "";
-            std::shared_ptr<Image> srcImg = nullptr;
-            std::shared_ptr<Image> dstImg = nullptr;
+            evaluateMseFrame();
+        }
+    }
 
-            if (m_args.mseGt)
-            {
-                folder = std::string(SCREENSHOT_FILES_LOC) + "eval/gt/";
-                srcImg = m_renderer->getOffscreenFramebuffer()->getColorImage();
-                dstImg = m_actualViewScreenshotImage;
-            }
-            else
-            {
-                std::string heur = (m_args.samplingType == SamplingType::COLOR) ? 
-                    "_c" : (m_args.samplingType == SamplingType::DEPTH_ANGLE ?
-                        "_da" : "_d"); 
-                folder = std::string(SCREENSHOT_FILES_LOC) + "eval/novel" + heur + "/";
-                srcImg = m_renderer->getNovelViewImage();
-                dstImg = m_novelViewScreenshotImage;
-            }
+    // The last frames of the MSE evaluation are still in flight when the camera path ends.
+    if (m_compareNovelView && m_terminate)
+    {
+        printMetricsResults();
+        m_compareNovelView = false;
+    }
+}
+
+void Application::recordReadbacks()
+{
+    // only acquired from the compute queue when it was generated in the frame
+    bool novelView = m_renderNovel || m_novelSecondWindow || m_compareNovelView;
+
+    if (m_screenshot)
+    {
+        std::time_t t = std::time(nullptr);
+        std::tm tm = *std::localtime(&t);
+        std::ostringstream oss;
+        oss << std::put_time(&tm, "%d-%m-%Y_%H-%M-%S/");
+        std::string timeString = oss.str();
+        std::string screenshotFolder = std::string(SCREENSHOT_FILES_LOC) + timeString;
+        std::filesystem::create_directories(screenshotFolder);
+
+        std::vector<ReadbackSource> sources = { ReadbackSource::VIEW_MATRIX, ReadbackSource::OFFSCREEN };
+        std::vector<std::string> filenames = { "viewMatrix.ppm", "gtView.ppm" };
+
+        if (novelView)
+        {
+            sources.push_back(ReadbackSource::NOVEL_VIEW);
+            filenames.push_back("novelView.ppm");
+        }
+
+        m_renderer->readbackImages(sources, [this, screenshotFolder, filenames](const std::vector<ReadbackImage>& images)
+        {
+            std::vector<SaveImageInfo> saveImageInfos;
+            for (size_t i = 0; i < images.size(); i++)
+                saveImageInfos.push_back(SaveImageInfo{screenshotFolder + filenames[i], images[i].dims, images[i].data});
+
+            vke::utils::saveImages(saveImageInfos);
+            m_screenshotsWritten++;
+        });
+
+        vke::utils::saveConfig(screenshotFolder + "config.json", m_config, m_novelViewGrid, m_viewGrid);
+
+        m_screenshot = false;
+    }
+
+    if (!m_evaluate || m_args.evalType != Arguments::EvaluationType::MSE ||
+        m_evaluateTotalMseSteps == m_lastReadbackStep)
+        return;
+
+    // The separate ground truth run only writes its images.
+    bool readGt = m_args.mseGt || (m_compareNovelView && (m_args.dumpImages || m_args.cpuMetrics));
+    bool readNovel = !m_args.mseGt && (m_args.dumpImages || m_args.cpuMetrics);
+
+    if (!readGt && !readNovel)
+        return;
 
-            std::filesystem::create_directories(folder);
+    m_lastReadbackStep = m_evaluateTotalMseSteps;
 
-            VkCommandBuffer commandBuffer;
-            m_device->beginSingleCommands(commandBuffer);
-            m_device->copyImageToImage(srcImg, dstImg, commandBuffer);
-            m_device->endSingleCommands(commandBuffer);
+    std::vector<ReadbackSource> sources;
+    std::vector<std::string> filenames;
 
-            dstImg->map();
-            void* data = dstImg->getMapped();
-            glm::ivec3 dims = glm::ivec3(dstImg->getDims(), 4);
+    std::string heur = (m_args.samplingType == SamplingType::COLOR) ? 
+        "_c" : (m_args.samplingType == SamplingType::DEPTH_ANGLE ?
+            "_da" : "_d"); 
+    std::string quality = (m_args.quality < 100) ? "_q" + std::to_string(m_args.quality) : "";
+    std::string gtFolder = std::string(SCREENSHOT_FILES_LOC) + "eval/gt/";
+    std::string novelFolder = std::string(SCREENSHOT_FILES_LOC) + "eval/novel" + heur + quality + "/";
+    std::string filename = std::to_string(m_evaluateTotalMseSteps) + ".ppm";
 
-            std::vector<SaveImageInfo> saveImageInfos = {
-                SaveImageInfo{folder + std::to_string(m_evaluateTotalMseSteps) + ".ppm", dims, (uint8_t*)data}
-            };
+    if (readGt)
+    {
+        std::filesystem::create_directories(gtFolder);
+        sources.push_back(ReadbackSource::OFFSCREEN);
+        filenames.push_back(gtFolder + filename);
+    }
+
+    if (readNovel)
+    {
+        std::filesystem::create_directories(novelFolder);
+        sources.push_back(ReadbackSource::NOVEL_VIEW);
+        filenames.push_back(novelFolder + filename);
+    }
+
+    bool cpuMetrics = m_compareNovelView && m_args.cpuMetrics;
+    bool saveImages = m_args.mseGt || m_args.dumpImages;
+    uint32_t step = m_evaluateTotalMseSteps;
+
+    m_renderer->readbackImages(sources, [this, filenames, cpuMetrics, saveImages, step](
+        const std::vector<ReadbackImage>& images)
+    {
+        if (cpuMetrics)
+        {
+            ImageMetrics metrics = vke::utils::metricsFromSums(
+                vke::utils::computeMetricsSums(images[0].data, images[1].data, glm::ivec2(images[0].dims)));
+
+            std::lock_guard<std::mutex> lock(m_evalMetricsMutex);
+            m_evalMetrics[step] = metrics;
+        }
+
+        if (saveImages)
+        {
+            std::vector<SaveImageInfo> saveImageInfos;
+            for (size_t i = 0; i < images.size(); i++)
+                saveImageInfos.push_back(SaveImageInfo{filenames[i], images[i].dims, images[i].data});
 
             vke::utils::saveImages(saveImageInfos);
-            dstImg->unmap();
         }
+    });
+}
+
+void Application::evaluateMseFrame()
+{
+    if (!m_compareNovelView || m_args.cpuMetrics)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_evalMetricsMutex);
+    for (auto& [step, metrics] : m_renderer->collectMetrics())
+        m_evalMetrics[step] = metrics;
+}
+
+void Application::printMetricsResults()
+{
+    m_renderer->waitForFrames();
+    m_renderer->flushReadbacks();
+
+    std::lock_guard<std::mutex> lock(m_evalMetricsMutex);
+
+    if (!m_args.cpuMetrics)
+    {
+        for (auto& [step, metrics] : m_renderer->collectMetrics())
+            m_evalMetrics[step] = metrics;
+    }
+
+    std::vector<ImageMetrics> metrics;
+    for (auto& [step, stepMetrics] : m_evalMetrics)
+        metrics.push_back(stepMetrics);
+
+    ImageMetrics mean = vke::utils::averageMetrics(metrics);
+
+    std::cout << "-----EVALUATION RESULTS-----" << std::endl;
+    std::cout << "mse | psnr | ssim" << std::endl;
+    std::cout << mean.mse << " " << mean.psnr << " " << mean.ssim << std::endl;
+}
+
+void Application::retireViews(const std::vector<std::shared_ptr<View>>& views)
+{
+    for (auto& view : views)
+    {
+        m_renderer->deferDestroy([this, view]()
+        {
+            m_scene->destroyViewResources(view);
+            view->destroyVkResources();
+        });
     }
 }
 
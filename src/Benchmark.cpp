@@ -0,0 +1,222 @@
+/**
+ * @file Benchmark.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "Benchmark.h"
+#include "Application.h"
+#include "utils/Constants.h"
+
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace vke
+{
+
+namespace
+{
+
+const std::vector<std::pair<std::string, SamplingType>> samplingTypeNames = {
+    { "c", SamplingType::COLOR },
+    { "d", SamplingType::DEPTH_DIST },
+    { "da", SamplingType::DEPTH_ANGLE }
+};
+
+SamplingType parseSamplingType(const std::string& name)
+{
+    for (auto& [typeName, type] : samplingTypeNames)
+    {
+        if (typeName == name)
+            return type;
+    }
+
+    throw std::runtime_error("Unknown sampling type in the benchmark sweep: " + name);
+}
+
+std::string samplingTypeName(SamplingType type)
+{
+    for (auto& [typeName, samplingType] : samplingTypeNames)
+    {
+        if (samplingType == type)
+            return typeName;
+    }
+
+    return "";
+}
+
+nlohmann::json statistics(const std::vector<BenchmarkFrame>& frames, float BenchmarkFrame::* timing)
+{
+    if (frames.empty())
+        return nlohmann::json::object();
+
+    std::vector<float> sorted;
+    for (auto& frame : frames)
+        sorted.push_back(frame.*timing);
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&sorted](float p) {
+        return sorted[std::min(static_cast<size_t>(p * sorted.size()), sorted.size() - 1)];
+    };
+
+    float mean = 0.f;
+    for (float value : sorted)
+        mean += value;
+    mean /= sorted.size();
+
+    return { { "mean", mean }, { "p50", percentile(0.5f) }, { "p95", percentile(0.95f) }, { "p99", percentile(0.99f) } };
+}
+
+template<typename T>
+std::vector<T> getOr(const nlohmann::json& sweep, const std::string& key, const std::vector<T>& defaultValues)
+{
+    return sweep.contains(key) ? sweep[key].template get<std::vector<T>>() : defaultValues;
+}
+
+}
+
+Benchmark::Benchmark(const std::string& sweepFile)
+{
+    parseSweeps(sweepFile);
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+void Benchmark::run()
+{
+    // the framebuffers are created with the resolution, so every resolution gets its own application
+    std::vector<glm::ivec2> resolutions;
+    for (auto& benchCase : m_cases)
+    {
+        if (std::find(resolutions.begin(), resolutions.end(), benchCase.resolution) == resolutions.end())
+            resolutions.push_back(benchCase.resolution);
+    }
+
+    m_results.clear();
+
+    for (auto& resolution : resolutions)
+    {
+        Application::Arguments args{};
+        args.configFile = m_configFile;
+        args.windowResolution = resolution;
+        args.novelResolution = resolution;
+        args.viewGridResolution = glm::vec2(VIEW_MATRIX_WIDTH, VIEW_MATRIX_HEIGHT);
+        args.evalType = Application::Arguments::EvaluationType::_COUNT;
+        args.samplingType = SamplingType::COLOR;
+        args.headless = true;
+
+        Application application(args);
+
+        for (auto& benchCase : m_cases)
+        {
+            if (benchCase.resolution != resolution)
+                continue;
+
+            std::cout << "Benchmark case " << (m_results.size() + 1) << "/" << m_cases.size() << ": " << benchCase.sweep
+                << std::endl;
+
+            BenchmarkResult result{ benchCase, 0, {} };
+            result.viewCount = application.runBenchmarkCase(benchCase, result.frames);
+
+            m_results.push_back(result);
+        }
+    }
+}
+
+void Benchmark::saveResults(const std::string& filename) const
+{
+    nlohmann::json j;
+    j["config"] = m_configFile;
+    j["cases"] = nlohmann::json::array();
+
+    for (auto& result : m_results)
+    {
+        const BenchmarkCase& benchCase = result.benchCase;
+
+        nlohmann::json jCase;
+        jCase["sweep"] = benchCase.sweep;
+        jCase["gridSize"] = { benchCase.gridSize.x, benchCase.gridSize.y };
+        jCase["views"] = result.viewCount;
+        jCase["raySamples"] = benchCase.raySamples;
+        jCase["maxViewsUsed"] = benchCase.maxViewsUsed;
+        jCase["samplingType"] = samplingTypeName(benchCase.samplingType);
+        jCase["resolution"] = { benchCase.resolution.x, benchCase.resolution.y };
+
+        jCase["frames"] = nlohmann::json::array();
+        for (auto& frame : result.frames)
+        {
+            jCase["frames"].push_back({ { "cpu", frame.cpu }, { "gpuCompute", frame.gpuCompute },
+                { "gpuGraphics", frame.gpuGraphics } });
+        }
+
+        jCase["cpu"] = statistics(result.frames, &BenchmarkFrame::cpu);
+        jCase["gpuCompute"] = statistics(result.frames, &BenchmarkFrame::gpuCompute);
+        jCase["gpuGraphics"] = statistics(result.frames, &BenchmarkFrame::gpuGraphics);
+
+        j["cases"].push_back(jCase);
+    }
+
+    std::ofstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open file: " + filename);
+
+    file << j.dump(4);
+}
+
+const std::vector<BenchmarkCase>& Benchmark::getCases() const
+{
+    return m_cases;
+}
+
+void Benchmark::parseSweeps(const std::string& sweepFile)
+{
+    std::ifstream file(sweepFile);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open file: " + sweepFile);
+
+    nlohmann::json j = nlohmann::json::parse(file);
+
+    m_configFile = std::string(CONFIG_FILES_LOC) + j["config"].template get<std::string>();
+
+    int warmupFrames = j.value("warmupFrames", 10);
+    int measuredFrames = j.value("measuredFrames", 50);
+
+    for (auto& sweep : j["sweeps"])
+    {
+        std::string name = sweep.value("name", "sweep");
+
+        // a zero grid size keeps the grid of the config
+        std::vector<std::array<int, 2>> gridSizes = getOr<std::array<int, 2>>(sweep, "gridSizes", { { 0, 0 } });
+        std::vector<int> raySamples = getOr<int>(sweep, "raySamples", { 128 });
+        std::vector<int> maxViewsUsed = getOr<int>(sweep, "maxViewsUsed", { 0 });
+        std::vector<std::string> samplingTypes = getOr<std::string>(sweep, "samplingTypes", { "c" });
+        std::vector<std::array<int, 2>> resolutions = getOr<std::array<int, 2>>(sweep, "resolutions",
+            { { static_cast<int>(NOVEL_VIEW_WIDTH), static_cast<int>(NOVEL_VIEW_HEIGHT) } });
+
+        for (auto& resolution : resolutions)
+            for (auto& gridSize : gridSizes)
+                for (auto& samples : raySamples)
+                    for (auto& maxViews : maxViewsUsed)
+                        for (auto& samplingType : samplingTypes)
+                        {
+                            m_cases.push_back(BenchmarkCase{ name, glm::ivec2(gridSize[0], gridSize[1]), samples,
+                                maxViews, parseSamplingType(samplingType), glm::ivec2(resolution[0], resolution[1]),
+                                warmupFrames, measuredFrames });
+                        }
+    }
+
+    if (m_cases.empty())
+        throw std::runtime_error("No benchmark cases in: " + sweepFile);
+}
+
+}
\ No newline at end of file
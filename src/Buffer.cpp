@@ -9,6 +9,7 @@
 
 #include "Buffer.h"
 #include "Device.h"
+#include "MemoryAllocator.h"
 
 #include <cstring>
 
@@ -16,13 +17,18 @@ namespace vke
 {
 
 Buffer::Buffer(std::shared_ptr<Device> device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
-    : m_device(device), m_size(size), m_usage(usage), m_properties(properties)
+    : m_device(device), m_size(size), m_usage(usage), m_properties(properties), m_memoryMapped(nullptr)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // Buffers are read and written by both queues, without ownership transfers.
+    std::vector<uint32_t> queueFamilies;
+    bufferInfo.sharingMode = m_device->getSharingMode(queueFamilies);
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = queueFamilies.data();
 
     if (vkCreateBuffer(m_device->getVkDevice(), &bufferInfo, nullptr, &m_buffer) != VK_SUCCESS)
         throw std::runtime_error("failed to create vertex buffer");
@@ -30,16 +36,9 @@ Buffer::Buffer(std::shared_ptr<Device> device, VkDeviceSize size, VkBufferUsageF
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(m_device->getVkDevice(), m_buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = m_device->findMemoryType(memRequirements.memoryTypeBits, properties);
+    m_allocation = m_device->getAllocator()->allocate(memRequirements, properties, true);
 
-    if (vkAllocateMemory(m_device->getVkDevice(), &allocInfo, nullptr, &m_bufferMemory) != VK_SUCCESS)
-        throw std::runtime_error("failed to allocate vertex buffer memory.");
-    
-    //! TODO: Potentionally add OFFSET
-    vkBindBufferMemory(m_device->getVkDevice(), m_buffer, m_bufferMemory, 0);
+    vkBindBufferMemory(m_device->getVkDevice(), m_buffer, m_allocation.memory, m_allocation.offset);
 }
 
 Buffer::~Buffer()
@@ -55,10 +54,11 @@ void Buffer::destroyVkResources()
     if (m_buffer != VK_NULL_HANDLE)
     {
         vkDestroyBuffer(m_device->getVkDevice(), m_buffer, nullptr);
-        vkFreeMemory(m_device->getVkDevice(), m_bufferMemory, nullptr);
+        m_device->getAllocator()->free(m_allocation);
 
         m_buffer = VK_NULL_HANDLE;
-        m_bufferMemory = VK_NULL_HANDLE;
+        m_allocation = MemoryAllocation{};
+        m_memoryMapped = nullptr;
     }
 }
 
@@ -88,13 +88,16 @@ VkBuffer Buffer::getVkBuffer() const
 
 void Buffer::map()
 {
-    // TODO: whole size for now.
-    vkMapMemory(m_device->getVkDevice(), m_bufferMemory, 0, VK_WHOLE_SIZE, 0, &m_memoryMapped);
+    // host visible blocks stay mapped by the allocator
+    if (m_allocation.mapped == nullptr)
+        throw std::runtime_error("Error: mapping buffer that is not host visible.");
+
+    m_memoryMapped = m_allocation.mapped;
 }
 
 void Buffer::unmap()
 {
-    vkUnmapMemory(m_device->getVkDevice(), m_bufferMemory);
+    m_memoryMapped = nullptr;
 }
 
 void Buffer::copyMapped(void *data, size_t size)
@@ -11,6 +11,7 @@
 #include "Device.h"
 #include "Buffer.h"
 #include "Image.h"
+#include "MemoryAllocator.h"
 #include "utils/Callbacks.h"
 #include "utils/DebugHelpers.h"
 #include "utils/VulkanHelpers.h"
@@ -35,14 +36,27 @@ namespace vke
 {
 
 Device::Device(std::shared_ptr<Window> window)
+    : m_surface(VK_NULL_HANDLE), m_headless(window == nullptr)
 {
+    // No presentation is done in headless mode, so the swapchain extension is not required.
+    if (m_headless)
+    {
+        m_deviceExtensions.erase(std::remove(m_deviceExtensions.begin(), m_deviceExtensions.end(),
+            std::string(VK_KHR_SWAPCHAIN_EXTENSION_NAME)), m_deviceExtensions.end());
+    }
+
     createInstance();
     setupDebugMessenger();
-    createSurface(window);
+
+    if (!m_headless)
+        createSurface(window);
+
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
 
+    m_allocator = std::make_shared<MemoryAllocator>(m_device, m_physicalDevice);
+
     vkGetPhysicalDeviceFeatures(m_physicalDevice, &m_features);
 
     VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
@@ -74,6 +88,8 @@ Device::~Device()
 void Device::destroyVkResources()
 {
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    vkDestroyCommandPool(m_device, m_computeCommandPool, nullptr);
+    m_allocator->destroyVkResources();
     vkDestroyDevice(m_device, nullptr);
 
     // destroy surfaces
@@ -140,13 +156,15 @@ void Device::createLogicalDevice()
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    if (indices.computeFamily.has_value())
+        uniqueQueueFamilies.insert(indices.computeFamily.value());
 
     float queuePriority = 1.f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
     {
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+        queueCreateInfo.queueFamilyIndex = queueFamily;
         queueCreateInfo.queueCount = 1;
         queueCreateInfo.pQueuePriorities = &queuePriority;
         queueCreateInfos.push_back(queueCreateInfo);
@@ -155,9 +173,15 @@ void Device::createLogicalDevice()
     // VkPhysicalDeviceDynamicRenderingFeatures dynamicRendering{};
     // dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
     // dynamicRendering.dynamicRendering = VK_TRUE;
+    // the frame scheduler orders the submissions of both queues by timeline semaphores
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+
     VkPhysicalDeviceHostQueryResetFeatures hostQueryFeatures{};
     hostQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES;
     hostQueryFeatures.hostQueryReset = VK_TRUE;
+    hostQueryFeatures.pNext = &timelineFeatures;
 
     VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
     indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
@@ -192,7 +216,9 @@ void Device::createLogicalDevice()
 
     vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
-    vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_computeQueue);
+
+    // Falls back to the graphics queue, the compute work is then serialized with the graphics work.
+    vkGetDeviceQueue(m_device, indices.computeFamily.value_or(indices.graphicsFamily.value()), 0, &m_computeQueue);
 }
 
 void Device::createCommandPool()
@@ -208,6 +234,13 @@ void Device::createCommandPool()
     {
         throw std::runtime_error("failed to create command pool!");
     }
+
+    poolInfo.queueFamilyIndex = getComputeFamily();
+
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_computeCommandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create compute command pool!");
+    }
 }
 
 VkFormat Device::findDepthFormat()
@@ -275,11 +308,17 @@ void Device::pickPhysicalDevice()
 
 std::vector<const char *> Device::getRequiredExtensions()
 {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char*> extensions;
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    // GLFW is not initialized in headless mode and no surface extensions are needed.
+    if (!m_headless)
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (m_enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -313,6 +352,11 @@ VkCommandPool Device::getCommandPool() const
 return m_commandPool;
 }
 
+VkCommandPool Device::getComputeCommandPool() const
+{
+    return m_computeCommandPool;
+}
+
 VkQueue Device::getGraphicsQueue() const
 {
     return m_graphicsQueue;
@@ -343,6 +387,16 @@ VkFormat Device::getDepthFormat() const
     return m_depthFormat;
 }
 
+bool Device::isHeadless() const
+{
+    return m_headless;
+}
+
+std::shared_ptr<MemoryAllocator> Device::getAllocator() const
+{
+    return m_allocator;
+}
+
 QueueFamilyIndices Device::getQueueFamilies()
 {
     m_familyIndices = vke::utils::findQueueFamilies(m_physicalDevice, m_surface);
@@ -354,6 +408,33 @@ QueueFamilyIndices Device::getQueueFamilyIndices()
     return m_familyIndices;
 }
 
+uint32_t Device::getGraphicsFamily() const
+{
+    return m_familyIndices.graphicsFamily.value();
+}
+
+uint32_t Device::getComputeFamily() const
+{
+    return m_familyIndices.computeFamily.value_or(m_familyIndices.graphicsFamily.value());
+}
+
+bool Device::hasAsyncCompute() const
+{
+    return m_familyIndices.computeFamily.has_value();
+}
+
+VkSharingMode Device::getSharingMode(std::vector<uint32_t>& queueFamilies) const
+{
+    if (!hasAsyncCompute())
+    {
+        queueFamilies.clear();
+        return VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    queueFamilies = { getGraphicsFamily(), getComputeFamily() };
+    return VK_SHARING_MODE_CONCURRENT;
+}
+
 uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
     VkPhysicalDeviceMemoryProperties memProperties;
@@ -566,7 +647,7 @@ VkImageView Device::createImageView(VkImage image, VkFormat format, VkImageAspec
 
 void Device::createImageBarrier(VkCommandBuffer commandBuffer, VkAccessFlags src, VkAccessFlags dst, VkImageLayout oldL,
     VkImageLayout newL, VkImage image, VkImageAspectFlags imgAspectFlags, VkPipelineStageFlags srcStage,
-    VkPipelineStageFlags dstStage)
+    VkPipelineStageFlags dstStage, uint32_t srcFamily, uint32_t dstFamily)
 {
     VkImageMemoryBarrier imb{};
     imb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -576,8 +657,15 @@ void Device::createImageBarrier(VkCommandBuffer commandBuffer, VkAccessFlags src
     imb.subresourceRange = { imgAspectFlags, 0, 1, 0, 1 };
     imb.srcAccessMask = src;
     imb.dstAccessMask = dst;
-    imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imb.srcQueueFamilyIndex = srcFamily;
+    imb.dstQueueFamilyIndex = dstFamily;
+
+    // Both halves of an ownership transfer between the same family would be a plain barrier.
+    if (srcFamily == dstFamily)
+    {
+        imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
 
     vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imb);
 }
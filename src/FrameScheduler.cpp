@@ -0,0 +1,214 @@
+/**
+ * @file FrameScheduler.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "FrameScheduler.h"
+#include "Device.h"
+#include "utils/Trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vke
+{
+
+FrameScheduler::FrameScheduler(std::shared_ptr<Device> device)
+    : m_device(device), m_submittedValues{}, m_completedValues{}
+{
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    for (auto& timeline : m_timelines)
+    {
+        if (vkCreateSemaphore(m_device->getVkDevice(), &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+            throw std::runtime_error("failed to create timeline semaphore!");
+    }
+}
+
+FrameScheduler::~FrameScheduler()
+{
+}
+
+void FrameScheduler::destroyVkResources()
+{
+    for (auto& timeline : m_timelines)
+        vkDestroySemaphore(m_device->getVkDevice(), timeline, nullptr);
+}
+
+SchedulePoint FrameScheduler::submit(QueueType queue, FrameStage stage, VkCommandBuffer commandBuffer,
+    const std::vector<ScheduleDependency>& dependencies, const std::vector<VkSemaphore>& waitSemaphores,
+    const std::vector<VkPipelineStageFlags>& waitStages, const std::vector<VkSemaphore>& signalSemaphores)
+{
+    TRACE_ZONE("Submit");
+
+    // only the latest point of every timeline is waited for, points already reached are dropped
+    std::array<uint64_t, static_cast<size_t>(QueueType::COUNT)> waitValues{};
+    std::array<VkPipelineStageFlags, static_cast<size_t>(QueueType::COUNT)> dependencyStages{};
+
+    for (auto& dependency : dependencies)
+    {
+        size_t id = static_cast<size_t>(dependency.point.queue);
+        waitValues[id] = std::max(waitValues[id], dependency.point.value);
+        dependencyStages[id] |= dependency.stages;
+    }
+
+    std::vector<VkSemaphore> semaphores = waitSemaphores;
+    std::vector<VkPipelineStageFlags> stages = waitStages;
+    // values of the binary semaphores are ignored
+    std::vector<uint64_t> values(waitSemaphores.size(), 0);
+
+    for (size_t i = 0; i < m_timelines.size(); i++)
+    {
+        if (waitValues[i] == 0 || waitValues[i] <= getCompletedValue(static_cast<QueueType>(i)))
+            continue;
+
+        semaphores.push_back(m_timelines[i]);
+        stages.push_back(dependencyStages[i]);
+        values.push_back(waitValues[i]);
+    }
+
+    size_t queueId = static_cast<size_t>(queue);
+    SchedulePoint point{ queue, ++m_submittedValues[queueId] };
+
+    std::vector<VkSemaphore> signals = signalSemaphores;
+    signals.push_back(m_timelines[queueId]);
+    std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+    signalValues.push_back(point.value);
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(values.size());
+    timelineInfo.pWaitSemaphoreValues = values.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(semaphores.size());
+    submitInfo.pWaitSemaphores = semaphores.data();
+    submitInfo.pWaitDstStageMask = stages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signals.size());
+    submitInfo.pSignalSemaphores = signals.data();
+
+    if (vkQueueSubmit(getQueue(queue), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("failed to submit command buffer!");
+
+    m_pendingStages.push_back(PendingStage{ stage, point, std::chrono::steady_clock::now() });
+
+    return point;
+}
+
+void FrameScheduler::wait(const std::vector<SchedulePoint>& points)
+{
+    std::array<uint64_t, static_cast<size_t>(QueueType::COUNT)> waitValues{};
+    for (auto& point : points)
+    {
+        size_t id = static_cast<size_t>(point.queue);
+        waitValues[id] = std::max(waitValues[id], point.value);
+    }
+
+    std::vector<VkSemaphore> semaphores;
+    std::vector<uint64_t> values;
+    for (size_t i = 0; i < m_timelines.size(); i++)
+    {
+        if (waitValues[i] == 0 || waitValues[i] <= m_completedValues[i])
+            continue;
+
+        semaphores.push_back(m_timelines[i]);
+        values.push_back(waitValues[i]);
+    }
+
+    if (semaphores.empty())
+        return;
+
+    TRACE_ZONE("Timeline wait");
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+    waitInfo.pSemaphores = semaphores.data();
+    waitInfo.pValues = values.data();
+
+    if (vkWaitSemaphores(m_device->getVkDevice(), &waitInfo, UINT64_MAX) != VK_SUCCESS)
+        throw std::runtime_error("failed to wait for timeline semaphores!");
+
+    collectTimings();
+}
+
+void FrameScheduler::waitIdle()
+{
+    wait({ getLastPoint(QueueType::GRAPHICS), getLastPoint(QueueType::COMPUTE) });
+}
+
+bool FrameScheduler::isReached(const SchedulePoint& point)
+{
+    return point.value <= getCompletedValue(point.queue);
+}
+
+void FrameScheduler::collectTimings()
+{
+    for (size_t i = 0; i < m_timelines.size(); i++)
+        getCompletedValue(static_cast<QueueType>(i));
+
+    auto now = std::chrono::steady_clock::now();
+
+    // the submissions of different queues finish out of order
+    auto it = m_pendingStages.begin();
+    while (it != m_pendingStages.end())
+    {
+        if (it->point.value > m_completedValues[static_cast<size_t>(it->point.queue)])
+        {
+            it++;
+            continue;
+        }
+
+        StageTiming& timing = m_stageTimings[static_cast<size_t>(it->stage)];
+        timing.value = it->point.value;
+        timing.latency = std::chrono::duration<float, std::milli>(now - it->submitted).count();
+        timing.completed = now;
+
+        it = m_pendingStages.erase(it);
+    }
+}
+
+SchedulePoint FrameScheduler::getLastPoint(QueueType queue) const
+{
+    return SchedulePoint{ queue, m_submittedValues[static_cast<size_t>(queue)] };
+}
+
+const StageTiming& FrameScheduler::getStageTiming(FrameStage stage) const
+{
+    return m_stageTimings[static_cast<size_t>(stage)];
+}
+
+uint64_t FrameScheduler::getCompletedValue(QueueType queue)
+{
+    size_t id = static_cast<size_t>(queue);
+
+    // the counter only grows, the last read value is enough for the points behind it
+    if (m_completedValues[id] < m_submittedValues[id])
+        vkGetSemaphoreCounterValue(m_device->getVkDevice(), m_timelines[id], &m_completedValues[id]);
+
+    return m_completedValues[id];
+}
+
+VkQueue FrameScheduler::getQueue(QueueType queue) const
+{
+    return queue == QueueType::COMPUTE ? m_device->getComputeQueue() : m_device->getGraphicsQueue();
+}
+
+}
\ No newline at end of file
@@ -70,6 +70,11 @@ std::shared_ptr<Image> Framebuffer::getColorImage() const
     return m_colorImage;
 }
 
+std::shared_ptr<Image> Framebuffer::getDepthImage() const
+{
+    return m_depthImage;
+}
+
 VkDescriptorImageInfo Framebuffer::getColorImageInfo()
 {
     return VkDescriptorImageInfo{
@@ -117,11 +122,13 @@ void Framebuffer::createFramebuffer(std::shared_ptr<RenderPass> renderPass)
 
 void Framebuffer::createImages(std::shared_ptr<RenderPass> renderPass)
 {
+    // The offscreen views are sampled by the ray evaluation on the compute queue every frame,
+    // they are shared by both queue families instead of being transferred back and forth.
     if (m_colorImage == nullptr && !m_fromSwapchain)
     {
         m_colorImage = std::make_shared<Image>(m_device, glm::vec2(m_resolution.width, m_resolution.height), VK_FORMAT_R8G8B8A8_UNORM,
             VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true);
     
         m_colorImage->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
         m_colorImage->transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
@@ -136,7 +143,7 @@ void Framebuffer::createImages(std::shared_ptr<RenderPass> renderPass)
     {
         m_depthImage = std::make_shared<Image>(m_device, glm::vec2(m_resolution.width, m_resolution.height), m_device->getDepthFormat(),
             VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true);
         
         m_depthImage->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
         m_depthImage->transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
@@ -0,0 +1,109 @@
+/**
+ * @file GeometryArena.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vke
+{
+
+GeometryArena::GeometryArena()
+    : m_vertexCount(0), m_indexCount(0), m_released(false)
+{
+}
+
+void GeometryArena::append(std::shared_ptr<const void> owner, const Vertex* vertices, uint32_t vertexCount,
+    const uint32_t* indices, uint32_t indexCount)
+{
+    if (m_released)
+    {
+        throw std::runtime_error("Error: appending to a released geometry arena.");
+    }
+
+    m_chunks.push_back({ std::move(owner), vertices, vertexCount, indices, indexCount, m_vertexCount });
+
+    m_vertexCount += vertexCount;
+    m_indexCount += indexCount;
+}
+
+void GeometryArena::release()
+{
+    // the last reference to a cache unmaps it
+    std::vector<Chunk>().swap(m_chunks);
+
+    m_released = true;
+}
+
+const Vertex* GeometryArena::getVertices(uint32_t firstVertex) const
+{
+    checkReleased();
+
+    // chunks are sorted by their first vertex, find the last one starting at or before it
+    auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), firstVertex,
+        [](uint32_t vertex, const Chunk& chunk){ return vertex < chunk.firstVertex; });
+
+    if (it == m_chunks.begin() || firstVertex >= m_vertexCount)
+    {
+        throw std::runtime_error("Error: vertex out of the geometry arena.");
+    }
+
+    const Chunk& chunk = *(it - 1);
+
+    return chunk.vertices + (firstVertex - chunk.firstVertex);
+}
+
+void GeometryArena::copyVertices(Vertex* dst) const
+{
+    checkReleased();
+
+    for (auto& chunk : m_chunks)
+    {
+        std::memcpy(dst, chunk.vertices, sizeof(Vertex) * chunk.vertexCount);
+        dst += chunk.vertexCount;
+    }
+}
+
+void GeometryArena::copyIndices(uint32_t* dst) const
+{
+    checkReleased();
+
+    for (auto& chunk : m_chunks)
+    {
+        std::memcpy(dst, chunk.indices, sizeof(uint32_t) * chunk.indexCount);
+        dst += chunk.indexCount;
+    }
+}
+
+uint32_t GeometryArena::getVertexCount() const
+{
+    return m_vertexCount;
+}
+
+uint32_t GeometryArena::getIndexCount() const
+{
+    return m_indexCount;
+}
+
+bool GeometryArena::isReleased() const
+{
+    return m_released;
+}
+
+void GeometryArena::checkReleased() const
+{
+    if (m_released)
+    {
+        throw std::runtime_error("Error: reading a released geometry arena.");
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+/**
+ * @file GpuProfiler.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "GpuProfiler.h"
+#include "Device.h"
+#include "utils/Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace vke
+{
+
+GpuProfiler::GpuProfiler(std::shared_ptr<Device> device)
+    : m_device(device), m_pools(POOL_COUNT)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_device->getPhysicalDevice(), &properties);
+    m_timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device->getPhysicalDevice(), &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device->getPhysicalDevice(), &familyCount, families.data());
+
+    m_graphicsTimestamps = families[m_device->getGraphicsFamily()].timestampValidBits > 0;
+    m_computeTimestamps = families[m_device->getComputeFamily()].timestampValidBits > 0;
+
+    VkQueryPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolCreateInfo.queryCount = MAX_ZONES * 2;
+
+    for (auto& recording : m_pools)
+    {
+        if (vkCreateQueryPool(m_device->getVkDevice(), &poolCreateInfo, nullptr, &recording.pool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create profiler query pool!");
+
+        vkResetQueryPool(m_device->getVkDevice(), recording.pool, 0, MAX_ZONES * 2);
+    }
+
+    if (m_graphicsTimestamps)
+        calibrate();
+}
+
+GpuProfiler::~GpuProfiler()
+{
+}
+
+void GpuProfiler::destroyVkResources()
+{
+    for (auto& recording : m_pools)
+        vkDestroyQueryPool(m_device->getVkDevice(), recording.pool, nullptr);
+}
+
+void GpuProfiler::beginCommandBuffer(VkCommandBuffer commandBuffer, QueueType queue)
+{
+    collect();
+
+    // the command buffer is only recorded again after its last submission finished, a pool
+    // still pending was recorded without being submitted
+    auto previous = m_recordings.find(commandBuffer);
+    if (previous != m_recordings.end())
+    {
+        PoolRecording& recording = m_pools[previous->second];
+        if (recording.pending && !readPool(recording, false))
+        {
+            vkResetQueryPool(m_device->getVkDevice(), recording.pool, 0, recording.queryCount);
+            recording.pending = false;
+        }
+
+        m_recordings.erase(previous);
+    }
+
+    if ((queue == QueueType::COMPUTE && !m_computeTimestamps) || (queue == QueueType::GRAPHICS && !m_graphicsTimestamps))
+        return;
+
+    uint32_t poolId = m_nextPool;
+    m_nextPool = (m_nextPool + 1) % POOL_COUNT;
+
+    // more command buffers in flight than pools, only then the read waits
+    PoolRecording& recording = m_pools[poolId];
+    if (recording.pending)
+        readPool(recording, true);
+
+    for (auto it = m_recordings.begin(); it != m_recordings.end(); it++)
+    {
+        if (it->second == poolId)
+        {
+            m_recordings.erase(it);
+            break;
+        }
+    }
+
+    recording.zones.clear();
+    recording.openZones.clear();
+    recording.queryCount = 0;
+    recording.queue = queue;
+    recording.pending = true;
+
+    m_recordings[commandBuffer] = poolId;
+}
+
+void GpuProfiler::beginZone(VkCommandBuffer commandBuffer, const std::string& name)
+{
+    auto it = m_recordings.find(commandBuffer);
+    if (it == m_recordings.end())
+        return;
+
+    PoolRecording& recording = m_pools[it->second];
+
+    // the zones over the limit are dropped, the open ones still have to be closed
+    if (recording.queryCount + 2 > MAX_ZONES * 2)
+    {
+        recording.openZones.push_back(UINT32_MAX);
+        return;
+    }
+
+    recording.openZones.push_back(static_cast<uint32_t>(recording.zones.size()));
+    recording.zones.push_back(Zone{ name, recording.queryCount, recording.queryCount + 1 });
+    recording.queryCount += 2;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, recording.pool,
+        recording.zones.back().startQuery);
+}
+
+void GpuProfiler::endZone(VkCommandBuffer commandBuffer)
+{
+    auto it = m_recordings.find(commandBuffer);
+    if (it == m_recordings.end())
+        return;
+
+    PoolRecording& recording = m_pools[it->second];
+
+    if (recording.openZones.empty())
+        throw std::runtime_error("profiler zone ended without being started!");
+
+    uint32_t zoneId = recording.openZones.back();
+    recording.openZones.pop_back();
+
+    if (zoneId == UINT32_MAX)
+        return;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, recording.pool,
+        recording.zones[zoneId].endQuery);
+}
+
+void GpuProfiler::collect()
+{
+    for (auto& recording : m_pools)
+    {
+        if (recording.pending)
+            readPool(recording, false);
+    }
+}
+
+std::vector<GpuZoneStats> GpuProfiler::getStats() const
+{
+    std::vector<GpuZoneStats> stats;
+
+    for (auto& [name, samples] : m_samples)
+    {
+        if (samples.empty())
+            continue;
+
+        std::vector<float> sorted(samples.begin(), samples.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        auto percentile = [&sorted](float p) {
+            return sorted[std::min(static_cast<size_t>(p * sorted.size()), sorted.size() - 1)];
+        };
+
+        GpuZoneStats zone{};
+        zone.name = name;
+        zone.samples = static_cast<uint32_t>(samples.size());
+        zone.last = samples.back();
+
+        for (float sample : samples)
+            zone.mean += sample;
+        zone.mean /= samples.size();
+
+        zone.p50 = percentile(0.5f);
+        zone.p95 = percentile(0.95f);
+        zone.p99 = percentile(0.99f);
+
+        stats.push_back(zone);
+    }
+
+    return stats;
+}
+
+GpuZoneTotal GpuProfiler::takeTotal(const std::string& name)
+{
+    auto it = m_totals.find(name);
+    if (it == m_totals.end())
+        return GpuZoneTotal{};
+
+    GpuZoneTotal total = it->second;
+    it->second = GpuZoneTotal{};
+
+    return total;
+}
+
+void GpuProfiler::exportCsv(const std::string& filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open file: " + filename);
+
+    file << "zone,samples,last_ms,mean_ms,p50_ms,p95_ms,p99_ms" << std::endl;
+
+    for (auto& zone : getStats())
+    {
+        file << zone.name << "," << zone.samples << "," << zone.last << "," << zone.mean << ","
+            << zone.p50 << "," << zone.p95 << "," << zone.p99 << std::endl;
+    }
+}
+
+void GpuProfiler::exportJson(const std::string& filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open file: " + filename);
+
+    std::vector<GpuZoneStats> stats = getStats();
+
+    file << "{" << std::endl << "    \"zones\": [" << std::endl;
+
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const GpuZoneStats& zone = stats[i];
+
+        file << "        { \"name\": \"" << zone.name << "\", \"samples\": " << zone.samples
+            << ", \"last\": " << zone.last << ", \"mean\": " << zone.mean << ", \"p50\": " << zone.p50
+            << ", \"p95\": " << zone.p95 << ", \"p99\": " << zone.p99 << " }"
+            << ((i + 1 < stats.size()) ? "," : "") << std::endl;
+    }
+
+    file << "    ]" << std::endl << "}" << std::endl;
+}
+
+void GpuProfiler::calibrate()
+{
+    VkQueryPool pool = m_pools[0].pool;
+
+    VkCommandBuffer commandBuffer;
+    m_device->beginSingleCommands(commandBuffer);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, 0);
+
+    // the timestamp is written between the submit and the end of the wait
+    int64_t before = utils::traceNow();
+    m_device->endSingleCommands(commandBuffer);
+    int64_t after = utils::traceNow();
+
+    if (vkGetQueryPoolResults(m_device->getVkDevice(), pool, 0, 1, sizeof(uint64_t), &m_calibrationTicks,
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to read profiler calibration timestamp!");
+    }
+
+    vkResetQueryPool(m_device->getVkDevice(), pool, 0, 1);
+
+    m_calibrationTime = before + (after - before) / 2;
+    m_calibrated = true;
+}
+
+bool GpuProfiler::readPool(PoolRecording& recording, bool wait)
+{
+    if (recording.queryCount > 0)
+    {
+        // timestamp and availability of every query
+        std::vector<uint64_t> results(recording.queryCount * 2);
+
+        VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+        if (wait)
+            flags |= VK_QUERY_RESULT_WAIT_BIT;
+
+        VkResult result = vkGetQueryPoolResults(m_device->getVkDevice(), recording.pool, 0, recording.queryCount,
+            sizeof(uint64_t) * results.size(), results.data(), sizeof(uint64_t) * 2, flags);
+
+        if (result != VK_SUCCESS && result != VK_NOT_READY)
+            throw std::runtime_error("failed to read profiler query pool!");
+
+        // the end of an outer zone is written after the nested ones
+        for (uint32_t i = 0; i < recording.queryCount; i++)
+        {
+            if (results[i * 2 + 1] == 0)
+                return false;
+        }
+
+        auto toTraceTime = [this](uint64_t ticks) {
+            return m_calibrationTime + static_cast<int64_t>((static_cast<int64_t>(ticks - m_calibrationTicks)) * m_timestampPeriod);
+        };
+
+        for (auto& zone : recording.zones)
+        {
+            uint64_t start = results[zone.startQuery * 2];
+            uint64_t end = results[zone.endQuery * 2];
+
+            const char* name = addSample(zone.name, static_cast<float>((end - start) * m_timestampPeriod) / 1000000.f);
+
+            if (m_calibrated)
+                utils::traceGpuEvent(name, static_cast<uint32_t>(recording.queue), toTraceTime(start), toTraceTime(end));
+        }
+
+        vkResetQueryPool(m_device->getVkDevice(), recording.pool, 0, recording.queryCount);
+    }
+
+    recording.pending = false;
+
+    return true;
+}
+
+const char* GpuProfiler::addSample(const std::string& name, float duration)
+{
+    auto it = m_samples.try_emplace(name).first;
+
+    it->second.push_back(duration);
+    if (it->second.size() > WINDOW_SIZE)
+        it->second.pop_front();
+
+    GpuZoneTotal& total = m_totals[name];
+    total.duration += duration;
+    total.samples++;
+
+    // the keys of the map are never removed, the trace keeps pointers to them
+    return it->first.c_str();
+}
+
+}
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include "Image.h"
 #include "Device.h"
+#include "MemoryAllocator.h"
 
 #include <cstring>
 
@@ -16,9 +17,9 @@ namespace vke
 {
 
 Image::Image(std::shared_ptr<Device> device, glm::vec2 dims, VkFormat format, VkImageTiling tiling,
-    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImageLayout initialLayout)
+    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImageLayout initialLayout, bool concurrent)
     : m_dims(dims), m_device(device), m_format(format), m_tiling(tiling),
-    m_usage(usage), m_properties(properties), m_layout(initialLayout)
+    m_usage(usage), m_properties(properties), m_layout(initialLayout), m_memoryMapped(nullptr)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -35,6 +36,14 @@ Image::Image(std::shared_ptr<Device> device, glm::vec2 dims, VkFormat format, Vk
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    std::vector<uint32_t> queueFamilies;
+    if (concurrent)
+    {
+        imageInfo.sharingMode = m_device->getSharingMode(queueFamilies);
+        imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+        imageInfo.pQueueFamilyIndices = queueFamilies.data();
+    }
+
     if (vkCreateImage(m_device->getVkDevice(), &imageInfo, nullptr, &m_image) != VK_SUCCESS)
     {
         throw std::runtime_error("Failed creating image.");
@@ -43,15 +52,9 @@ Image::Image(std::shared_ptr<Device> device, glm::vec2 dims, VkFormat format, Vk
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(m_device->getVkDevice(), m_image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = m_device->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(m_device->getVkDevice(), &allocInfo, nullptr, &m_imageMemory) != VK_SUCCESS)
-        throw std::runtime_error("Failed allocating image memory");
+    m_allocation = m_device->getAllocator()->allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR);
 
-    vkBindImageMemory(m_device->getVkDevice(), m_image, m_imageMemory, 0);
+    vkBindImageMemory(m_device->getVkDevice(), m_image, m_allocation.memory, m_allocation.offset);
 }
 
 Image::~Image()
@@ -64,10 +67,11 @@ void Image::destroyVkResources()
     if (m_image != VK_NULL_HANDLE)
     {
         vkDestroyImage(m_device->getVkDevice(), m_image, nullptr);
-        vkFreeMemory(m_device->getVkDevice(), m_imageMemory, nullptr);
+        m_device->getAllocator()->free(m_allocation);
 
         m_image = VK_NULL_HANDLE;
-        m_imageMemory = VK_NULL_HANDLE;
+        m_allocation = MemoryAllocation{};
+        m_memoryMapped = nullptr;
     }
 }
 
@@ -84,12 +88,16 @@ VkImageView Image::createImageView(VkImageAspectFlags aspectMask)
 
 void Image::map()
 {
-    vkMapMemory(m_device->getVkDevice(), m_imageMemory, 0, VK_WHOLE_SIZE, 0, &m_memoryMapped);
+    // host visible blocks stay mapped by the allocator
+    if (m_allocation.mapped == nullptr)
+        throw std::runtime_error("Error: mapping image that is not host visible.");
+
+    m_memoryMapped = m_allocation.mapped;
 }
 
 void Image::unmap()
 {
-    vkUnmapMemory(m_device->getVkDevice(), m_imageMemory);
+    m_memoryMapped = nullptr;
 }
 
 VkImage Image::getVkImage() const
@@ -115,4 +123,9 @@ void *Image::getMapped()
 {
     return m_memoryMapped;
 }
+
+void Image::setVkImageLayout(VkImageLayout layout)
+{
+    m_layout = layout;
+}
 }
\ No newline at end of file
@@ -0,0 +1,360 @@
+/**
+ * @file ImageReadback.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "ImageReadback.h"
+#include "Buffer.h"
+#include "Device.h"
+#include "Image.h"
+#include "utils/Trace.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace vke
+{
+
+bool ImageReadback::WorkQueue::push(uint32_t slot)
+{
+    uint32_t currentTail = tail.load(std::memory_order_relaxed);
+    uint32_t nextTail = (currentTail + 1) % slots.size();
+
+    if (nextTail == head.load(std::memory_order_acquire))
+        return false;
+
+    slots[currentTail] = slot;
+    tail.store(nextTail, std::memory_order_release);
+
+    return true;
+}
+
+bool ImageReadback::WorkQueue::pop(uint32_t& slot)
+{
+    uint32_t currentHead = head.load(std::memory_order_relaxed);
+
+    if (currentHead == tail.load(std::memory_order_acquire))
+        return false;
+
+    slot = slots[currentHead];
+    head.store((currentHead + 1) % slots.size(), std::memory_order_release);
+
+    return true;
+}
+
+bool ImageReadback::WorkQueue::empty() const
+{
+    return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+}
+
+ImageReadback::ImageReadback(std::shared_ptr<Device> device, std::shared_ptr<FrameScheduler> scheduler,
+    uint32_t workerCount)
+    : m_device(device), m_scheduler(scheduler)
+{
+    workerCount = std::max(1u, workerCount);
+
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        m_threads.emplace_back(&ImageReadback::workerLoop, this, i);
+    }
+}
+
+ImageReadback::~ImageReadback()
+{
+    stopWorkers();
+}
+
+void ImageReadback::destroyVkResources()
+{
+    if (m_destroyed)
+        return;
+
+    flush();
+    stopWorkers();
+
+    for (auto& slot : m_slots)
+    {
+        if (slot.buffer)
+            slot.buffer->destroyVkResources();
+    }
+
+    m_destroyed = true;
+}
+
+void ImageReadback::copyImages(VkCommandBuffer commandBuffer, const std::vector<std::shared_ptr<Image>>& images,
+    VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, ReadbackJob job)
+{
+    TRACE_ZONE("Record readback");
+
+    uint32_t slotId = acquireSlot();
+    Slot& slot = m_slots[slotId];
+
+    VkDeviceSize size = 0;
+    for (auto& image : images)
+    {
+        glm::ivec2 dims = glm::ivec2(image->getDims());
+        size += static_cast<VkDeviceSize>(dims.x) * dims.y * 4;
+    }
+
+    // the buffers only grow, a free slot is not used by the GPU nor by a worker
+    if (!slot.buffer || slot.buffer->getSize() < size)
+    {
+        if (slot.buffer)
+            slot.buffer->destroyVkResources();
+
+        slot.buffer = std::make_unique<Buffer>(m_device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        slot.buffer->map();
+    }
+
+    uint8_t* mapped = static_cast<uint8_t*>(slot.buffer->getMapped());
+    VkDeviceSize offset = 0;
+
+    slot.images.clear();
+
+    for (auto& image : images)
+    {
+        glm::ivec2 dims = glm::ivec2(image->getDims());
+        VkImageLayout layout = image->getVkImageLayout();
+
+        m_device->createImageBarrier(commandBuffer, srcAccess, VK_ACCESS_TRANSFER_READ_BIT, layout,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT, srcStages,
+            VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { static_cast<uint32_t>(dims.x), static_cast<uint32_t>(dims.y), 1 };
+
+        vkCmdCopyImageToBuffer(commandBuffer, image->getVkImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            slot.buffer->getVkBuffer(), 1, &region);
+
+        // later passes of the frame may write the image again
+        m_device->createImageBarrier(commandBuffer, 0, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout, image->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+        slot.images.push_back(ReadbackImage{ mapped + offset, glm::ivec3(dims, 4) });
+        offset += static_cast<VkDeviceSize>(dims.x) * dims.y * 4;
+    }
+
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = slot.buffer->getVkBuffer();
+    hostBarrier.offset = 0;
+    hostBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    slot.job = job;
+    slot.state.store(SlotState::RECORDED, std::memory_order_relaxed);
+}
+
+void ImageReadback::submit(const SchedulePoint& point)
+{
+    for (auto& slot : m_slots)
+    {
+        if (slot.state.load(std::memory_order_relaxed) == SlotState::RECORDED)
+        {
+            slot.point = point;
+            slot.state.store(SlotState::SUBMITTED, std::memory_order_relaxed);
+        }
+    }
+}
+
+void ImageReadback::collect()
+{
+    for (uint32_t i = 0; i < SLOT_COUNT; i++)
+    {
+        Slot& slot = m_slots[i];
+
+        if (slot.state.load(std::memory_order_relaxed) != SlotState::SUBMITTED || !m_scheduler->isReached(slot.point))
+            continue;
+
+        slot.state.store(SlotState::PROCESSING, std::memory_order_relaxed);
+
+        // the slot is published to the worker by the release of the queue
+        WorkQueue& queue = *m_queues[m_nextWorker];
+        if (!queue.push(i))
+            throw std::runtime_error("readback work queue overflow!");
+
+        // taking the mutex orders the push with the check of a worker going to sleep
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+        }
+        queue.condition.notify_one();
+
+        m_nextWorker = (m_nextWorker + 1) % m_queues.size();
+    }
+}
+
+void ImageReadback::flush()
+{
+    TRACE_ZONE("Flush readbacks");
+
+    std::vector<SchedulePoint> points;
+    for (auto& slot : m_slots)
+    {
+        if (slot.state.load(std::memory_order_relaxed) == SlotState::SUBMITTED)
+            points.push_back(slot.point);
+    }
+
+    if (!points.empty())
+        m_scheduler->wait(points);
+
+    collect();
+
+    std::unique_lock<std::mutex> lock(m_freedMutex);
+    m_freedCondition.wait(lock, [this]
+    {
+        return std::none_of(m_slots.begin(), m_slots.end(), [](const Slot& slot)
+        {
+            return slot.state.load(std::memory_order_acquire) == SlotState::PROCESSING;
+        });
+    });
+}
+
+uint32_t ImageReadback::acquireSlot()
+{
+    while (true)
+    {
+        for (uint32_t i = 0; i < SLOT_COUNT; i++)
+        {
+            uint32_t slotId = (m_nextSlot + i) % SLOT_COUNT;
+
+            if (m_slots[slotId].state.load(std::memory_order_acquire) == SlotState::FREE)
+            {
+                m_nextSlot = (slotId + 1) % SLOT_COUNT;
+                return slotId;
+            }
+        }
+
+        TRACE_ZONE("Wait for readback slot");
+
+        // every slot is taken, the oldest submitted copy is waited for, otherwise the workers
+        const Slot* oldest = nullptr;
+        bool processing = false;
+
+        for (auto& slot : m_slots)
+        {
+            SlotState state = slot.state.load(std::memory_order_relaxed);
+
+            if (state == SlotState::SUBMITTED && (!oldest || slot.point.value < oldest->point.value))
+                oldest = &slot;
+
+            processing |= (state == SlotState::PROCESSING);
+        }
+
+        if (oldest)
+        {
+            m_scheduler->wait({ oldest->point });
+            collect();
+        }
+        else if (processing)
+        {
+            std::unique_lock<std::mutex> lock(m_freedMutex);
+            m_freedCondition.wait(lock, [this]
+            {
+                return std::any_of(m_slots.begin(), m_slots.end(), [](const Slot& slot)
+                {
+                    return slot.state.load(std::memory_order_acquire) == SlotState::FREE;
+                });
+            });
+        }
+        else
+        {
+            throw std::runtime_error("more image readbacks recorded without a submission than readback slots!");
+        }
+    }
+}
+
+void ImageReadback::stopWorkers()
+{
+    m_stop.store(true, std::memory_order_release);
+
+    for (auto& queue : m_queues)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+        }
+        queue->condition.notify_one();
+    }
+
+    for (auto& thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+
+    m_threads.clear();
+}
+
+void ImageReadback::workerLoop(uint32_t workerId)
+{
+    utils::setTraceThreadName("Readback " + std::to_string(workerId));
+
+    WorkQueue& queue = *m_queues[workerId];
+
+    while (true)
+    {
+        uint32_t slotId;
+        if (!queue.pop(slotId))
+        {
+            // the queues are drained by flush before the stop
+            if (m_stop.load(std::memory_order_acquire))
+                return;
+
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.condition.wait(lock, [&]{ return !queue.empty() || m_stop.load(std::memory_order_acquire); });
+            continue;
+        }
+
+        Slot& slot = m_slots[slotId];
+
+        {
+            TRACE_ZONE("Readback job");
+
+            // a failed job must not take the worker down with it
+            try
+            {
+                slot.job(slot.images);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Readback job failed: " << e.what() << std::endl;
+            }
+        }
+
+        slot.job = nullptr;
+        slot.state.store(SlotState::FREE, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(m_freedMutex);
+        }
+        m_freedCondition.notify_one();
+    }
+}
+
+}
\ No newline at end of file
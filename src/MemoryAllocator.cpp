@@ -0,0 +1,310 @@
+/**
+ * @file MemoryAllocator.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+
+VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment)
+{
+    return alignment > 1 ? (offset + alignment - 1) / alignment * alignment : offset;
+}
+
+}
+
+namespace vke
+{
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize)
+    : m_device(device), m_blockSize(blockSize), m_dedicatedBytes(0), m_dedicatedCount(0), m_allocationCount(0)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+    m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    destroyVkResources();
+}
+
+void MemoryAllocator::destroyVkResources()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    for (auto& pool : m_pools)
+    {
+        for (auto& block : pool.blocks)
+        {
+            if (block->mapped)
+                vkUnmapMemory(m_device, block->memory);
+            vkFreeMemory(m_device, block->memory, nullptr);
+        }
+
+        pool.blocks.clear();
+    }
+
+    // resources still alive after this point only release their handles
+    m_device = VK_NULL_HANDLE;
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+    bool linear)
+{
+    MemoryAllocation allocation{};
+    allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    allocation.size = requirements.size;
+    allocation.linear = linear;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (requirements.size > m_blockSize / 2)
+    {
+        allocation.memory = allocateDeviceMemory(requirements.size, allocation.memoryType, &allocation.mapped);
+        allocation.dedicated = true;
+
+        m_dedicatedBytes += requirements.size;
+        m_dedicatedCount++;
+        m_allocationCount++;
+
+        return allocation;
+    }
+
+    Pool& pool = getPool(allocation.memoryType, linear);
+
+    Block* target = nullptr;
+    for (auto& block : pool.blocks)
+    {
+        if (allocateFromBlock(*block, requirements.size, requirements.alignment, allocation.offset))
+        {
+            target = block.get();
+            break;
+        }
+    }
+
+    if (target == nullptr)
+    {
+        std::unique_ptr<Block> block = std::make_unique<Block>();
+
+        void* mapped = nullptr;
+        block->memory = allocateDeviceMemory(m_blockSize, allocation.memoryType, &mapped);
+        block->size = m_blockSize;
+        block->used = 0;
+        block->allocationCount = 0;
+        block->mapped = static_cast<char*>(mapped);
+        block->freeRanges[0] = m_blockSize;
+
+        allocateFromBlock(*block, requirements.size, requirements.alignment, allocation.offset);
+
+        target = block.get();
+        pool.blocks.push_back(std::move(block));
+    }
+
+    allocation.memory = target->memory;
+    allocation.mapped = target->mapped ? target->mapped + allocation.offset : nullptr;
+
+    m_allocationCount++;
+
+    return allocation;
+}
+
+void MemoryAllocator::free(const MemoryAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (allocation.memory == VK_NULL_HANDLE || m_device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    m_allocationCount--;
+
+    if (allocation.dedicated)
+    {
+        if (allocation.mapped)
+            vkUnmapMemory(m_device, allocation.memory);
+        vkFreeMemory(m_device, allocation.memory, nullptr);
+
+        m_dedicatedBytes -= allocation.size;
+        m_dedicatedCount--;
+
+        return;
+    }
+
+    Pool& pool = getPool(allocation.memoryType, allocation.linear);
+
+    auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [&](const std::unique_ptr<Block>& block)
+    {
+        return block->memory == allocation.memory;
+    });
+
+    if (it == pool.blocks.end())
+    {
+        throw std::runtime_error("Error: freeing memory that was not allocated by the allocator.");
+    }
+
+    Block& block = **it;
+    freeInBlock(block, allocation.offset, allocation.size);
+
+    // keep one empty block per pool, views are often removed and added again right after
+    if (block.allocationCount == 0)
+    {
+        bool otherEmpty = std::any_of(pool.blocks.begin(), pool.blocks.end(), [&](const std::unique_ptr<Block>& other)
+        {
+            return other.get() != &block && other->allocationCount == 0;
+        });
+
+        if (otherEmpty)
+        {
+            if (block.mapped)
+                vkUnmapMemory(m_device, block.memory);
+            vkFreeMemory(m_device, block.memory, nullptr);
+
+            pool.blocks.erase(it);
+        }
+    }
+}
+
+MemoryAllocator::Stats MemoryAllocator::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats{};
+    stats.reservedBytes = m_dedicatedBytes;
+    stats.usedBytes = m_dedicatedBytes;
+    stats.allocationCount = m_allocationCount;
+    stats.deviceAllocationCount = m_dedicatedCount;
+
+    for (auto& pool : m_pools)
+    {
+        for (auto& block : pool.blocks)
+        {
+            VkDeviceSize largestFree = 0;
+            for (auto& range : block->freeRanges)
+                largestFree = std::max(largestFree, range.second);
+
+            stats.reservedBytes += block->size;
+            stats.usedBytes += block->used;
+            stats.fragmentedBytes += block->size - block->used - largestFree;
+            stats.blockCount++;
+            stats.deviceAllocationCount++;
+        }
+    }
+
+    return stats;
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+    {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped)
+{
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        throw std::runtime_error("Failed allocating device memory.");
+
+    *mapped = nullptr;
+    if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+        {
+            vkFreeMemory(m_device, memory, nullptr);
+            throw std::runtime_error("Failed mapping device memory.");
+        }
+    }
+
+    return memory;
+}
+
+bool MemoryAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    // first fit, the padding in front of the aligned offset stays free
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); it++)
+    {
+        VkDeviceSize rangeStart = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second;
+        VkDeviceSize start = alignUp(rangeStart, alignment);
+
+        if (start + size > rangeEnd)
+        {
+            continue;
+        }
+
+        block.freeRanges.erase(it);
+
+        if (start > rangeStart)
+            block.freeRanges[rangeStart] = start - rangeStart;
+        if (start + size < rangeEnd)
+            block.freeRanges[start + size] = rangeEnd - start - size;
+
+        block.used += size;
+        block.allocationCount++;
+        offset = start;
+
+        return true;
+    }
+
+    return false;
+}
+
+void MemoryAllocator::freeInBlock(Block& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    block.used -= size;
+    block.allocationCount--;
+
+    auto next = block.freeRanges.lower_bound(offset);
+    if (next != block.freeRanges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+    }
+
+    if (next != block.freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+
+    block.freeRanges[offset] = size;
+}
+
+MemoryAllocator::Pool& MemoryAllocator::getPool(uint32_t memoryType, bool linear)
+{
+    return m_pools[memoryType * 2 + (linear ? 1 : 0)];
+}
+
+}
\ No newline at end of file
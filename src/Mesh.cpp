@@ -29,11 +29,11 @@
 namespace vke
 {
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, MeshInfo info)
+Mesh::Mesh(MeshInfo info)
     : m_modelMatrix{1.f},
     m_material(nullptr), m_info(info),
-    m_vertices(vertices), m_indices(indices),
-    m_bbCenter(0.f), m_bbRadius(0.f)   
+    m_bbCenter(0.f), m_bbRadius(0.f),
+    m_positionOffset(0.f), m_positionScale(1.f)
 {
 }
 
@@ -74,6 +74,8 @@ void Mesh::updateDescriptorData(std::vector<MeshShaderDataVertex>& vertexShaderD
 {
     vertexShaderData.push_back(MeshShaderDataVertex());
     vertexShaderData.back().model = m_modelMatrix;
+    vertexShaderData.back().positionOffset = glm::vec4(m_positionOffset, 0.f);
+    vertexShaderData.back().positionScale = glm::vec4(m_positionScale, 1.f);
 
     fragmentShaderData.push_back(MeshShaderDataFragment());
     if (m_material->hasTexture())
@@ -137,11 +139,22 @@ void Mesh::setBbProperties(const glm::vec3& center, float radius)
     m_bbRadius = radius;
 }
 
+void Mesh::setPositionQuantization(const glm::vec3& offset, const glm::vec3& scale)
+{
+    m_positionOffset = offset;
+    m_positionScale = scale;
+}
+
 std::shared_ptr<Material> Mesh::getMaterial() const
 {
     return m_material;
 }
 
+const Mesh::MeshInfo& Mesh::getMeshInfo() const
+{
+    return m_info;
+}
+
 glm::vec3 Mesh::getBbCenter() const
 {
     return m_bbCenter;
@@ -152,6 +165,16 @@ float Mesh::getBbRadius() const
     return m_bbRadius;
 }
 
+glm::vec3 Mesh::getPositionOffset() const
+{
+    return m_positionOffset;
+}
+
+glm::vec3 Mesh::getPositionScale() const
+{
+    return m_positionScale;
+}
+
 uint32_t Mesh::getDrawId() const
 {
     return m_drawId;
@@ -0,0 +1,248 @@
+/**
+ * @file MeshBvh.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "MeshBvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace vke
+{
+
+MeshBvh::MeshBvh()
+    : m_depth(0)
+{
+}
+
+void MeshBvh::build(const std::vector<glm::vec4>& spheres)
+{
+    m_spheres = spheres;
+    m_nodes.clear();
+    m_primitives.resize(spheres.size());
+    m_tasks.clear();
+    m_depth = 0;
+
+    if (spheres.empty())
+    {
+        return;
+    }
+
+    std::iota(m_primitives.begin(), m_primitives.end(), 0);
+
+    m_nodes.reserve(spheres.size() * 2);
+    m_nodes.push_back(BvhNodeCompute());
+    m_nodes[0].firstPrimitive = 0;
+    m_nodes[0].primitiveCount = static_cast<uint32_t>(spheres.size());
+
+    buildNode(0, 1);
+    createTasks();
+}
+
+void MeshBvh::buildNode(uint32_t nodeId, uint32_t depth)
+{
+    m_depth = std::max(m_depth, depth);
+
+    uint32_t first = m_nodes[nodeId].firstPrimitive;
+    uint32_t count = m_nodes[nodeId].primitiveCount;
+
+    glm::vec3 aabbMin(std::numeric_limits<float>::max());
+    glm::vec3 aabbMax(std::numeric_limits<float>::lowest());
+    glm::vec3 centroidMin = aabbMin;
+    glm::vec3 centroidMax = aabbMax;
+
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        const glm::vec4& sphere = m_spheres[m_primitives[i]];
+        glm::vec3 center(sphere);
+
+        aabbMin = glm::min(aabbMin, center - sphere.w);
+        aabbMax = glm::max(aabbMax, center + sphere.w);
+        centroidMin = glm::min(centroidMin, center);
+        centroidMax = glm::max(centroidMax, center);
+    }
+
+    m_nodes[nodeId].aabbMin = glm::vec4(aabbMin, 0.f);
+    m_nodes[nodeId].aabbMax = glm::vec4(aabbMax, 0.f);
+    m_nodes[nodeId].leftChild = 0;
+
+    if (count <= BVH_LEAF_SIZE)
+    {
+        return;
+    }
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent[axis])
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+
+    // median split keeps the tree balanced, the depth stays logarithmic for the traversal stack
+    uint32_t half = count / 2;
+    std::nth_element(m_primitives.begin() + first, m_primitives.begin() + first + half,
+        m_primitives.begin() + first + count, [&](uint32_t a, uint32_t b)
+    {
+        return m_spheres[a][axis] < m_spheres[b][axis];
+    });
+
+    uint32_t leftChild = static_cast<uint32_t>(m_nodes.size());
+    m_nodes[nodeId].leftChild = leftChild;
+
+    m_nodes.push_back(BvhNodeCompute());
+    m_nodes.back().firstPrimitive = first;
+    m_nodes.back().primitiveCount = half;
+
+    m_nodes.push_back(BvhNodeCompute());
+    m_nodes.back().firstPrimitive = first + half;
+    m_nodes.back().primitiveCount = count - half;
+
+    buildNode(leftChild, depth + 1);
+    buildNode(leftChild + 1, depth + 1);
+}
+
+void MeshBvh::createTasks()
+{
+    // expand the tree level by level while the next level still fits
+    m_tasks = { 0 };
+
+    while (true)
+    {
+        std::vector<uint32_t> nextTasks;
+        bool expanded = false;
+
+        for (auto task : m_tasks)
+        {
+            if (m_nodes[task].leftChild != 0)
+            {
+                nextTasks.push_back(m_nodes[task].leftChild);
+                nextTasks.push_back(m_nodes[task].leftChild + 1);
+                expanded = true;
+            }
+            else
+            {
+                nextTasks.push_back(task);
+            }
+        }
+
+        if (!expanded || nextTasks.size() > BVH_MAX_TASKS)
+        {
+            break;
+        }
+
+        m_tasks = nextTasks;
+    }
+}
+
+void MeshBvh::cull(const std::vector<glm::vec4>& frustumPlanes, std::vector<uint32_t>& visible) const
+{
+    visible.clear();
+
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    std::vector<uint32_t> stack = { 0 };
+
+    while (!stack.empty())
+    {
+        const BvhNodeCompute& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        Visibility visibility = classify(glm::vec3(node.aabbMin), glm::vec3(node.aabbMax), frustumPlanes);
+
+        if (visibility == Visibility::OUTSIDE)
+        {
+            continue;
+        }
+
+        if (visibility == Visibility::INSIDE)
+        {
+            visible.insert(visible.end(), m_primitives.begin() + node.firstPrimitive,
+                m_primitives.begin() + node.firstPrimitive + node.primitiveCount);
+            continue;
+        }
+
+        if (node.leftChild != 0)
+        {
+            stack.push_back(node.leftChild + 1);
+            stack.push_back(node.leftChild);
+            continue;
+        }
+
+        // same sphere test as the flat culling
+        for (uint32_t i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++)
+        {
+            const glm::vec4& sphere = m_spheres[m_primitives[i]];
+
+            bool culled = false;
+            for (auto& plane : frustumPlanes)
+            {
+                if (glm::dot(glm::vec4(glm::vec3(sphere), 1.f), plane) + sphere.w < 0.f)
+                {
+                    culled = true;
+                    break;
+                }
+            }
+
+            if (!culled)
+                visible.push_back(m_primitives[i]);
+        }
+    }
+}
+
+MeshBvh::Visibility MeshBvh::classify(const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+    const std::vector<glm::vec4>& frustumPlanes)
+{
+    Visibility visibility = Visibility::INSIDE;
+
+    for (auto& plane : frustumPlanes)
+    {
+        glm::vec3 normal(plane);
+
+        // corners furthest along and against the plane normal
+        glm::vec3 positive = glm::mix(aabbMin, aabbMax, glm::greaterThanEqual(normal, glm::vec3(0.f)));
+        glm::vec3 negative = glm::mix(aabbMax, aabbMin, glm::greaterThanEqual(normal, glm::vec3(0.f)));
+
+        if (glm::dot(positive, normal) + plane.w < 0.f)
+        {
+            return Visibility::OUTSIDE;
+        }
+
+        if (glm::dot(negative, normal) + plane.w < 0.f)
+        {
+            visibility = Visibility::INTERSECTING;
+        }
+    }
+
+    return visibility;
+}
+
+const std::vector<BvhNodeCompute>& MeshBvh::getNodes() const
+{
+    return m_nodes;
+}
+
+const std::vector<uint32_t>& MeshBvh::getPrimitives() const
+{
+    return m_primitives;
+}
+
+const std::vector<uint32_t>& MeshBvh::getTasks() const
+{
+    return m_tasks;
+}
+
+uint32_t MeshBvh::getDepth() const
+{
+    return m_depth;
+}
+
+}
\ No newline at end of file
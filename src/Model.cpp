@@ -34,6 +34,11 @@ std::vector<std::shared_ptr<Mesh>> Model::getMeshes() const
     return m_meshes;
 }
 
+std::vector<std::shared_ptr<Mesh>> Model::getTransparentMeshes() const
+{
+    return m_transparentMeshes;
+}
+
 size_t Model::getMeshesCount() const
 {
     return m_meshes.size();
@@ -13,8 +13,9 @@ namespace vke
 {
 
 RenderPass::RenderPass(std::shared_ptr<Device> device, VkFormat colorFormat, VkFormat depthFormat,
-    bool offscreen)
-    : m_device(device), m_colorFormat(colorFormat), m_depthFormat(depthFormat), m_offscreen(offscreen)
+    bool offscreen, bool load)
+    : m_device(device), m_colorFormat(colorFormat), m_depthFormat(depthFormat), m_offscreen(offscreen),
+    m_load(offscreen && load)
 {
     createRenderPass();
 }
@@ -48,6 +49,13 @@ void RenderPass::createRenderPass()
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    // the offscreen attachments are left in the shader read layout by the previous pass
+    if (m_load)
+    {
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
     
     if (m_offscreen)
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -71,6 +79,13 @@ void RenderPass::createRenderPass()
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE ;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (m_load)
+    {
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
     depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     if (m_offscreen)
@@ -92,7 +107,7 @@ void RenderPass::createRenderPass()
 
     if (m_offscreen)
     {
-        colorDependencies.resize(4);
+        colorDependencies.resize(5);
 
         colorDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
         colorDependencies[0].dstSubpass = 0;
@@ -125,6 +140,15 @@ void RenderPass::createRenderPass()
         colorDependencies[3].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         colorDependencies[3].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
         colorDependencies[3].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        // the ray evaluation of the previous frame may still sample the attachments
+        colorDependencies[4].srcSubpass = VK_SUBPASS_EXTERNAL;
+        colorDependencies[4].dstSubpass = 0;
+        colorDependencies[4].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        colorDependencies[4].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        colorDependencies[4].srcAccessMask = 0;
+        colorDependencies[4].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        colorDependencies[4].dependencyFlags = 0;
     }
     else
     {
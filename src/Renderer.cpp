@@ -20,6 +20,7 @@
 #include "RenderPass.h"
 #include "Framebuffer.h"
 #include "pipelines/GraphicsPipeline.h"
+#include "utils/Trace.h"
 #include "pipelines/ComputePipeline.h"
 #include "descriptors/SetLayout.h"
 #include "descriptors/Pool.h"
@@ -28,6 +29,8 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+
 // #define RAY_EVAL_DEBUG
 
 #define INTERPOLATE_PIXELS_X 1.f
@@ -37,25 +40,38 @@ namespace vke
 {
 
 Renderer::Renderer(std::shared_ptr<Device> device, std::shared_ptr<Window> window, const RendererInitParams& params)
-    : m_device(device), m_window(window), m_currentFrame(0), m_fubos(MAX_FRAMES_IN_FLIGHT),
+    : m_device(device), m_window(window), m_headless(window == nullptr),
+    m_batchedCulling(device->getFeatures().shaderStorageBufferArrayDynamicIndexing),
+    m_gridRendering(m_batchedCulling && device->getFeatures().shaderClipDistance), m_renderPassExtent{0, 0}, m_currentFrame(0), m_frameNumber(0), m_fubos(MAX_FRAMES_IN_FLIGHT),
     m_vssbos(MAX_FRAMES_IN_FLIGHT), m_fssbos(MAX_FRAMES_IN_FLIGHT), m_cssbos(MAX_FRAMES_IN_FLIGHT),
-    m_creubo(MAX_FRAMES_IN_FLIGHT), m_cressbo(MAX_FRAMES_IN_FLIGHT), m_creDebugSsbo(MAX_FRAMES_IN_FLIGHT), 
-    m_quadubo(MAX_FRAMES_IN_FLIGHT), m_generalDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_materialDescriptorSets(MAX_FRAMES_IN_FLIGHT),
+    m_bvhssbos(MAX_FRAMES_IN_FLIGHT), m_bvhPrimitiveSsbos(MAX_FRAMES_IN_FLIGHT), m_bvhVersions(MAX_FRAMES_IN_FLIGHT, 0),
+    m_creubo(MAX_FRAMES_IN_FLIGHT), m_cressbo(MAX_FRAMES_IN_FLIGHT), m_viewTableSsbos(MAX_FRAMES_IN_FLIGHT),
+    m_creDebugSsbo(MAX_FRAMES_IN_FLIGHT), 
+    m_tileViewsSsbos(MAX_FRAMES_IN_FLIGHT), m_depthPyramidViewSsbos(MAX_FRAMES_IN_FLIGHT), m_depthPyramidCapacity(0),
+    m_quadubo(MAX_FRAMES_IN_FLIGHT), m_generalDescriptorSets(MAX_FRAMES_IN_FLIGHT),
+    m_materialDescriptorSets(MAX_FRAMES_IN_FLIGHT),
     m_computeDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_computeRayEvalDescriptorSets(MAX_FRAMES_IN_FLIGHT),
-    m_quadDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_sceneFramesUpdated(0), m_lightsFramesUpdated(0),
+    m_depthPyramidDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_metricsDescriptorSets(MAX_FRAMES_IN_FLIGHT),
+    m_metricsPartialSsbos(MAX_FRAMES_IN_FLIGHT), m_metricsSsbos(MAX_FRAMES_IN_FLIGHT),
+    m_metricsFrames(MAX_FRAMES_IN_FLIGHT, UINT64_MAX), m_metricsIds(MAX_FRAMES_IN_FLIGHT, 0), m_quadDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_sceneDirtySlots(0), m_lightDirtySlots(0), m_cullDirtySlots(0),
+    m_temporalHistoryValid(false), m_temporalFrame(0), m_prevRayEvalParams{},
+    m_graphicsPoints(MAX_FRAMES_IN_FLIGHT), m_computePoints(MAX_FRAMES_IN_FLIGHT), m_computeStage(FrameStage::CULL),
+    m_viewMatrixCommandBuffers(MAX_FRAMES_IN_FLIGHT),
     m_swapChainImageIndices(MAX_FRAMES_IN_FLIGHT), m_secondarySwapchain(nullptr), m_secondaryQuadubo(MAX_FRAMES_IN_FLIGHT),
     m_secondaryQuadDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_pointsDescriptorsets(MAX_FRAMES_IN_FLIGHT),
-    m_pointsUbo(MAX_FRAMES_IN_FLIGHT), m_pointsSsbo(MAX_FRAMES_IN_FLIGHT),
-    m_timestampQueryGraphPools(MAX_FRAMES_IN_FLIGHT), m_timestampQueryCompPools(MAX_FRAMES_IN_FLIGHT), 
-    m_startComputeQuery(MAX_FRAMES_IN_FLIGHT), m_startGraphicsQuery(MAX_FRAMES_IN_FLIGHT),
-    m_endComputeQuery(MAX_FRAMES_IN_FLIGHT), m_endGraphicsQuery(MAX_FRAMES_IN_FLIGHT)
+    m_pointsUbo(MAX_FRAMES_IN_FLIGHT), m_pointsSsbo(MAX_FRAMES_IN_FLIGHT)
 {
     createCommandBuffers();
     createComputeCommandBuffers();
     createDescriptors();
     createRenderResources(params);
     createPipeline(params);
-    createQueryResources();
+
+    createViewMatrixUpdateResources();
+
+    m_scheduler = std::make_shared<FrameScheduler>(m_device);
+    m_profiler = std::make_shared<GpuProfiler>(m_device);
+    m_readback = std::make_shared<ImageReadback>(m_device, m_scheduler);
 }
 
 Renderer::~Renderer()
@@ -64,33 +80,60 @@ Renderer::~Renderer()
 
 void Renderer::destroyVkResources()
 {
+    destroyRetiredResources(true);
+
     // cleanup also other pointers
-    m_swapChain->destroyVkResources();
-    m_secondarySwapchain->destroyVkResources();
+    if (m_swapChain)
+        m_swapChain->destroyVkResources();
+    
+    if (m_secondarySwapchain)
+        m_secondarySwapchain->destroyVkResources();
+
+    // the pending jobs still wait for their timeline points
+    m_readback->destroyVkResources();
+    m_scheduler->destroyVkResources();
+    m_profiler->destroyVkResources();
+    vkFreeCommandBuffers(m_device->getVkDevice(), m_device->getCommandPool(),
+        static_cast<uint32_t>(m_viewMatrixCommandBuffers.size()), m_viewMatrixCommandBuffers.data());
 
     m_offscreenFramebuffer->destroyVkResources();
     m_viewMatrixFramebuffer->destroyVkResources();
     
     m_offscreenPipeline->destroyVkResources();
+    m_offscreenGridPipeline->destroyVkResources();
     m_cullPipeline->destroyVkResources();
+    m_cullBatchedPipeline->destroyVkResources();
     m_raysEvalPipeline->destroyVkResources();
+    m_tileViewsPipeline->destroyVkResources();
+    m_depthPyramidPipeline->destroyVkResources();
+    m_upsamplePipeline->destroyVkResources();
+    m_metricsPipeline->destroyVkResources();
+    m_metricsReducePipeline->destroyVkResources();
     m_quadPipeline->destroyVkResources();
     m_pointCloudPipeline->destroyVkResources();
 
     m_quadRenderPass->destroyVkResources();
     m_offscreenRenderPass->destroyVkResources();
+    m_offscreenLoadRenderPass->destroyVkResources();
 
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         vkFreeCommandBuffers(m_device->getVkDevice(), m_device->getCommandPool(), 1, &m_commandBuffers[i]);
-        vkFreeCommandBuffers(m_device->getVkDevice(), m_device->getCommandPool(), 1, &m_computeCommandBuffers[i]);
+        vkFreeCommandBuffers(m_device->getVkDevice(), m_device->getComputeCommandPool(), 1, &m_computeCommandBuffers[i]);
     
         m_fubos[i]->destroyVkResources();
         m_vssbos[i]->destroyVkResources();
         m_fssbos[i]->destroyVkResources();
         m_cssbos[i]->destroyVkResources();
+        m_bvhssbos[i]->destroyVkResources();
+        m_bvhPrimitiveSsbos[i]->destroyVkResources();
         m_creubo[i]->destroyVkResources();
         m_cressbo[i]->destroyVkResources();
+        m_viewTableSsbos[i]->destroyVkResources();
+        m_tileViewsSsbos[i]->destroyVkResources();
+        m_depthPyramidViewSsbos[i]->destroyVkResources();
+        m_metricsPartialSsbos[i]->destroyVkResources();
+        m_metricsSsbos[i]->destroyVkResources();
 
 #ifdef RAY_EVAL_DEBUG
         m_creDebugSsbo[i]->destroyVkResources();
@@ -100,9 +143,6 @@ void Renderer::destroyVkResources()
         m_secondaryQuadubo[i]->destroyVkResources();
         m_pointsUbo[i]->destroyVkResources();
         m_pointsSsbo[i]->destroyVkResources();
-
-        vkDestroyQueryPool(m_device->getVkDevice(), m_timestampQueryCompPools[i], nullptr);
-        vkDestroyQueryPool(m_device->getVkDevice(), m_timestampQueryGraphPools[i], nullptr);
     }
 
     for (auto& texture : m_textures)
@@ -112,8 +152,14 @@ void Renderer::destroyVkResources()
         texture->destroyVkResources();
 
     m_novelImageSampler->destroyVkResources();
-    vkDestroyImageView(m_device->getVkDevice(), m_novelImageView, nullptr);
-    m_novelImage->destroyVkResources();
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyImageView(m_device->getVkDevice(), m_novelImageViews[i], nullptr);
+        m_novelImages[i]->destroyVkResources();
+    }
+
+    m_depthPyramidSsbo->destroyVkResources();
+    m_temporalHistorySsbo->destroyVkResources();
 
     m_testPixelSampler->destroyVkResources();
     vkDestroyImageView(m_device->getVkDevice(), m_testPixelImageView, nullptr);
@@ -124,7 +170,11 @@ void Renderer::destroyVkResources()
     m_materialSetLayout->destroyVkResources();
     m_computeSetLayout->destroyVkResources();
     m_computeSceneSetLayout->destroyVkResources();
+    m_computeBatchSetLayout->destroyVkResources();
+    m_gridViewSetLayout->destroyVkResources();
     m_computeRayEvalSetLayout->destroyVkResources();
+    m_depthPyramidSetLayout->destroyVkResources();
+    m_metricsSetLayout->destroyVkResources();
     m_quadSetLayout->destroyVkResources();
     m_secondaryQuadSetLayout->destroyVkResources();
     m_pointsSetLayout->destroyVkResources();
@@ -134,7 +184,11 @@ void Renderer::destroyVkResources()
     m_materialPool->destroyVkResources();
     m_computePool->destroyVkResources();
     m_computeScenePool->destroyVkResources();
+    m_computeBatchPool->destroyVkResources();
+    m_gridViewPool->destroyVkResources();
     m_computeRayEvalPool->destroyVkResources();
+    m_depthPyramidPool->destroyVkResources();
+    m_metricsPool->destroyVkResources();
     m_quadPool->destroyVkResources();
     m_secondaryQuadPool->destroyVkResources();
     m_pointsPool->destroyVkResources();
@@ -208,11 +262,15 @@ void Renderer::initDescriptorResources()
             m_computePool);
 
         std::vector<VkDescriptorBufferInfo> bufferInfos = {
-            m_cssbos[i]->getInfo()
+            m_cssbos[i]->getInfo(),
+            m_bvhssbos[i]->getInfo(),
+            m_bvhPrimitiveSsbos[i]->getInfo()
         };
 
         std::vector<uint32_t> bufferBinding = {
-            1
+            1,
+            2,
+            3
         };
 
 
@@ -228,6 +286,10 @@ void Renderer::initDescriptorResources()
         std::vector<VkDescriptorBufferInfo> bufferInfos = {
             m_creubo[i]->getInfo(),
             m_cressbo[i]->getInfo(),
+            m_tileViewsSsbos[i]->getInfo(),
+            m_depthPyramidSsbo->getInfo(),
+            m_temporalHistorySsbo->getInfo(),
+            m_viewTableSsbos[i]->getInfo(),
 #ifdef RAY_EVAL_DEBUG
             m_creDebugSsbo[i]->getInfo()
 #endif
@@ -236,6 +298,10 @@ void Renderer::initDescriptorResources()
         std::vector<uint32_t> bufferBinding = {
             0,
             1,
+            7,
+            8,
+            9,
+            10,
 #ifdef RAY_EVAL_DEBUG
             2,
 #endif
@@ -246,7 +312,7 @@ void Renderer::initDescriptorResources()
         std::vector<VkDescriptorImageInfo> imageInfos = {
             m_viewMatrixFramebuffer->getColorImageInfo(),
             m_viewMatrixFramebuffer->getDepthImageInfo(),
-            getNovelImageInfo(),
+            getNovelImageInfo(i),
             getTestPixelImageInfo()
         };
 
@@ -257,6 +323,62 @@ void Renderer::initDescriptorResources()
         m_computeRayEvalDescriptorSets[i]->updateImages(imageBinding, imageInfos);
     }
 
+    // Depth pyramid
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_depthPyramidDescriptorSets[i] = std::make_shared<DescriptorSet>(m_device, m_depthPyramidSetLayout,
+            m_depthPyramidPool);
+
+        std::vector<VkDescriptorImageInfo> imageInfos = {
+            m_viewMatrixFramebuffer->getDepthImageInfo()
+        };
+
+        std::vector<uint32_t> imageBinding = {
+            0
+        };
+
+        m_depthPyramidDescriptorSets[i]->updateImages(imageBinding, imageInfos);
+
+        std::vector<VkDescriptorBufferInfo> bufferInfos = {
+            m_depthPyramidViewSsbos[i]->getInfo(),
+            m_depthPyramidSsbo->getInfo()
+        };
+
+        std::vector<uint32_t> bufferBinding = {
+            1, 2
+        };
+
+        m_depthPyramidDescriptorSets[i]->updateBuffers(bufferBinding, bufferInfos);
+    }
+
+    // Image metrics
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_metricsDescriptorSets[i] = std::make_shared<DescriptorSet>(m_device, m_metricsSetLayout, m_metricsPool);
+
+        std::vector<VkDescriptorImageInfo> imageInfos = {
+            m_offscreenFramebuffer->getColorImageInfo(),
+            getNovelImageInfo(i)
+        };
+
+        std::vector<uint32_t> imageBinding = {
+            0, 1
+        };
+
+        m_metricsDescriptorSets[i]->updateImages(imageBinding, imageInfos);
+
+        std::vector<VkDescriptorBufferInfo> bufferInfos = {
+            m_metricsPartialSsbos[i]->getInfo(),
+            m_metricsSsbos[i]->getInfo()
+        };
+
+        std::vector<uint32_t> bufferBinding = {
+            2, 3
+        };
+
+        m_metricsDescriptorSets[i]->updateBuffers(bufferBinding, bufferInfos);
+    }
+
     // Quad
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
@@ -294,7 +416,7 @@ void Renderer::initDescriptorResources()
         m_secondaryQuadDescriptorSets[i]->updateBuffers(bufferBinding, bufferInfos);
 
         imageInfos = {
-            getNovelImageInfo()
+            getNovelImageInfo(i)
         };
 
         m_secondaryQuadDescriptorSets[i]->updateImages(imageBinding, imageInfos, 0);
@@ -338,6 +460,8 @@ void Renderer::initDescriptorResources()
 void Renderer::cullComputePass(const std::shared_ptr<Scene> &scene, const std::shared_ptr<ViewGrid>& viewGrid,
     bool novelViews)
 {
+    m_profiler->beginZone(m_computeCommandBuffers[m_currentFrame], "Culling");
+
     updateCullComputeDescriptorData(scene);
 
     std::vector<std::shared_ptr<View>> views = viewGrid->getViews();
@@ -357,8 +481,249 @@ void Renderer::cullComputePass(const std::shared_ptr<Scene> &scene, const std::s
             }
         }
 
-        recordComputeCommandBuffer(m_computeCommandBuffers[m_currentFrame], scene, view);
+        if (!m_batchedCulling)
+            recordComputeCommandBuffer(m_computeCommandBuffers[m_currentFrame], scene, view);
+    }
+
+    if (m_batchedCulling)
+    {
+        if (!scene->gridResourcesExist(viewGrid))
+            scene->createGridResources(viewGrid, m_device, m_computeBatchSetLayout, m_computeBatchPool,
+                m_gridViewSetLayout, m_gridViewPool);
+
+        scene->updateGridResources(viewGrid, views, m_currentFrame);
+
+        recordBatchedComputeCommandBuffer(m_computeCommandBuffers[m_currentFrame], scene, viewGrid);
+    }
+
+    m_profiler->endZone(m_computeCommandBuffers[m_currentFrame]);
+}
+
+void Renderer::depthPyramidPass(const std::shared_ptr<ViewGrid>& viewGrid)
+{
+    std::vector<std::shared_ptr<View>> views = viewGrid->getViews();
+
+    recordDepthPyramid(m_commandBuffers[m_currentFrame], views, views);
+}
+
+void Renderer::recordDepthPyramid(VkCommandBuffer commandBuffer, const std::vector<std::shared_ptr<View>>& views,
+    const std::vector<std::shared_ptr<View>>& pyramidViews)
+{
+    // same order and offsets as the ray eval view data, only the given views are dispatched
+    std::vector<DepthPyramidViewCompute> dispatchedViews;
+    glm::vec2 maxRes(0.f);
+    uint32_t pyramidOffset = 0;
+
+    for (int i = 0; i < views.size(); i++)
+    {
+        glm::vec2 res = views[i]->getResolution();
+        glm::vec2 offset = views[i]->getViewportStart();
+
+        if (std::find(pyramidViews.begin(), pyramidViews.end(), views[i]) != pyramidViews.end())
+        {
+            DepthPyramidViewCompute pyramidView{};
+            pyramidView.resOffset = glm::vec4(res.x, res.y, offset.x, offset.y);
+            pyramidView.pyramidOffset = pyramidOffset;
+
+            dispatchedViews.push_back(pyramidView);
+            maxRes = glm::max(maxRes, res);
+        }
+
+        pyramidOffset += getDepthPyramidSize(res);
+    }
+
+    if (pyramidOffset > m_depthPyramidCapacity)
+    {
+        throw std::runtime_error("Depth pyramid of the view grid does not fit into its buffer.");
     }
+
+    if (dispatchedViews.empty())
+    {
+        return;
+    }
+
+    m_depthPyramidViewSsbos[m_currentFrame]->copyMapped(dispatchedViews.data(),
+        sizeof(DepthPyramidViewCompute) * dispatchedViews.size());
+
+    VkImageAspectFlags depthAspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (m_device->getDepthFormat() >= VK_FORMAT_D16_UNORM_S8_UINT)
+        depthAspectFlags |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    m_device->createImageBarrier(commandBuffer, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        m_viewMatrixFramebuffer->getDepthImage()->getVkImage(), depthAspectFlags,
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    VkDescriptorSet depthPyramidSet = m_depthPyramidDescriptorSets[m_currentFrame]->getDescriptorSet();
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthPyramidPipeline->getPipelineLayout(),
+        0, 1, &depthPyramidSet, 0, nullptr);
+
+    m_depthPyramidPipeline->bind(commandBuffer);
+
+    m_profiler->beginZone(commandBuffer, "Depth pyramid");
+
+    // earlier dispatches of this queue may still read the pyramid, the ray evaluation on the compute
+    // queue is ordered by the timeline dependencies of the submission instead
+    VkBufferMemoryBarrier pyramidReadBarrier{};
+    pyramidReadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    pyramidReadBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    pyramidReadBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    pyramidReadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidReadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidReadBarrier.buffer = m_depthPyramidSsbo->getVkBuffer();
+    pyramidReadBarrier.offset = 0;
+    pyramidReadBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr, 1, &pyramidReadBarrier, 0, nullptr);
+
+    // one workgroup per view block of the coarsest level
+    float blockSize = DEPTH_PYRAMID_BASE * DEPTH_PYRAMID_GROUP_SIZE;
+    vkCmdDispatch(commandBuffer, std::ceil(maxRes.x / blockSize), std::ceil(maxRes.y / blockSize), dispatchedViews.size());
+
+    m_profiler->endZone(commandBuffer);
+
+    VkBufferMemoryBarrier depthPyramidBarrier{};
+    depthPyramidBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    depthPyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    depthPyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    depthPyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthPyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthPyramidBarrier.buffer = m_depthPyramidSsbo->getVkBuffer();
+    depthPyramidBarrier.offset = 0;
+    depthPyramidBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr, 1, &depthPyramidBarrier, 0, nullptr);
+
+    // the novel view history was evaluated against the old views
+    m_temporalHistoryValid = false;
+}
+
+void Renderer::updateViewMatrix(const std::shared_ptr<Scene>& scene, const std::shared_ptr<ViewGrid>& viewGrid,
+    const std::vector<std::shared_ptr<View>>& views)
+{
+    if (views.empty())
+    {
+        return;
+    }
+
+    TRACE_ZONE("View matrix update");
+
+    // the uniform data of the views and the culled draws of this frame slot are written by the CPU,
+    // the frame which used the slot last has to be finished, as before every frame
+    m_scheduler->wait({ m_graphicsPoints[m_currentFrame], m_computePoints[m_currentFrame] });
+
+    std::vector<std::shared_ptr<View>> gridViews = viewGrid->getViews();
+    updateDescriptorData(scene, gridViews, gridViews);
+
+    // only a few views are culled, the CPU traversal of the BVH is cheaper than a compute submit
+    scene->updateBvh();
+
+    for (auto& view : views)
+    {
+        view->updateDescriptorData(m_currentFrame);
+
+        if (!scene->viewResourcesExist(view))
+            scene->createViewResources(view, m_device, m_computeSceneSetLayout, m_computeScenePool);
+
+        VkDrawIndexedIndirectCommand* commands = scene->getViewDrawData(view, m_currentFrame);
+
+        if (view->getFrustumCull())
+        {
+            scene->checkMeshesVisible(view->getCamera(), commands);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < scene->getDrawCount(); i++)
+                commands[i].instanceCount = (commands[i].indexCount != 0) ? 1 : 0;
+        }
+    }
+
+    // the slot's last frame was submitted after its view matrix render, so the buffer is free
+    VkCommandBuffer commandBuffer = m_viewMatrixCommandBuffers[m_currentFrame];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin view matrix command buffer!");
+
+    m_profiler->beginCommandBuffer(commandBuffer, QueueType::GRAPHICS);
+    m_profiler->beginZone(commandBuffer, "View matrix");
+
+    VkExtent2D res = m_viewMatrixFramebuffer->getResolution();
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = m_offscreenLoadRenderPass->getRenderPass();
+    renderPassInfo.framebuffer = m_viewMatrixFramebuffer->getFramebuffer();
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = res;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    // the tiles are cleared the same way as the whole framebuffer by the full render
+    std::array<VkClearAttachment, 2> clearAttachments{};
+    clearAttachments[0].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    clearAttachments[0].colorAttachment = 0;
+    clearAttachments[0].clearValue.color = { {0.f, 0.f, 0.f, 1.f} };
+    clearAttachments[1].aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    clearAttachments[1].clearValue.depthStencil = { 1.f, 0 };
+
+    std::vector<VkClearRect> clearRects;
+    for (auto& view : views)
+    {
+        glm::vec2 viewportStart = view->getViewportStart();
+        glm::vec2 viewResolution = view->getResolution();
+
+        VkClearRect clearRect{};
+        clearRect.rect.offset = { (int32_t)viewportStart.x, (int32_t)viewportStart.y };
+        clearRect.rect.extent = { (uint32_t)viewResolution.x, (uint32_t)viewResolution.y };
+        clearRect.baseArrayLayer = 0;
+        clearRect.layerCount = 1;
+
+        clearRects.push_back(clearRect);
+    }
+
+    vkCmdClearAttachments(commandBuffer, clearAttachments.size(), clearAttachments.data(), clearRects.size(),
+        clearRects.data());
+
+    for (auto& view : views)
+    {
+        glm::vec2 viewportStart = view->getViewportStart();
+        glm::vec2 viewResolution = view->getResolution();
+
+        setViewport(viewportStart, viewResolution, commandBuffer);
+        setScissor(viewportStart, viewResolution, commandBuffer);
+
+        recordCommandBuffer(commandBuffer, scene, view);
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    m_profiler->endZone(commandBuffer);
+
+    recordDepthPyramid(commandBuffer, gridViews, views);
+
+    m_device->copyImageToImage(m_viewMatrixFramebuffer->getColorImage(), m_testPixelImage, commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to record view matrix command buffer!");
+
+    // the previous render of the view matrix and the ray evaluation of the other frames in flight
+    // may still use the view matrix, the tiles are written once they finished instead of blocking the CPU
+    std::vector<ScheduleDependency> dependencies = {
+        ScheduleDependency{ m_viewMatrixPoint, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT }
+    };
+
+    for (auto& point : m_computePoints)
+        dependencies.push_back(ScheduleDependency{ point, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT });
+
+    m_viewMatrixPoint = m_scheduler->submit(QueueType::GRAPHICS, FrameStage::VIEW_MATRIX, commandBuffer, dependencies);
 }
 
 void Renderer::rayEvalComputePass(const std::shared_ptr<ViewGrid>& novelViewGrid, 
@@ -367,21 +732,72 @@ void Renderer::rayEvalComputePass(const std::shared_ptr<ViewGrid>& novelViewGrid
     std::vector<std::shared_ptr<View>> novelViews = novelViewGrid->getViews();
     std::vector<std::shared_ptr<View>> views = viewGrid->getViews();
 
+    m_computeStage = FrameStage::RAY_EVAL;
+    m_profiler->beginZone(m_computeCommandBuffers[m_currentFrame], "Ray evaluation");
+
     updateRayEvalComputeDescriptorData(novelViews, views, params);
 
-    glm::vec2 res = m_novelImage->getDims();
+    glm::vec2 res = m_novelImages[m_currentFrame]->getDims();
+    glm::uvec2 tileCount = getRayEvalTileCount();
 
-    m_device->createImageBarrier(m_computeCommandBuffers[m_currentFrame], 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
-        VK_IMAGE_LAYOUT_GENERAL, m_novelImage->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    // the quad pass that sampled this image finished before beginComputePass returned, the whole
+    // image is written again so its contents and the ownership of the graphics queue are discarded
+    m_device->createImageBarrier(m_computeCommandBuffers[m_currentFrame], 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_GENERAL, m_novelImages[m_currentFrame]->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
     VkDescriptorSet rayEvalSet = m_computeRayEvalDescriptorSets[m_currentFrame]->getDescriptorSet();
 
+    // all the ray eval pipelines share the layout, the set stays bound for every pass
     vkCmdBindDescriptorSets(m_computeCommandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, m_raysEvalPipeline->getPipelineLayout(),
         0, 1, &rayEvalSet, 0, nullptr);
-    
+
+    // the previous ray eval wrote the half of the history this one reads
+    VkBufferMemoryBarrier historyBarrier{};
+    historyBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    historyBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    historyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    historyBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    historyBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    historyBarrier.buffer = m_temporalHistorySsbo->getVkBuffer();
+    historyBarrier.offset = 0;
+    historyBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(m_computeCommandBuffers[m_currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &historyBarrier, 0, nullptr);
+
+    // candidate views and the evaluation rate of every tile, the rays then only test those views
+    m_tileViewsPipeline->bind(m_computeCommandBuffers[m_currentFrame]);
+
+    vkCmdDispatch(m_computeCommandBuffers[m_currentFrame], tileCount.x, tileCount.y, 1);
+
+    VkBufferMemoryBarrier tileViewsBarrier = historyBarrier;
+    tileViewsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    tileViewsBarrier.buffer = m_tileViewsSsbos[m_currentFrame]->getVkBuffer();
+
+    vkCmdPipelineBarrier(m_computeCommandBuffers[m_currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &tileViewsBarrier, 0, nullptr);
+
     m_raysEvalPipeline->bind(m_computeCommandBuffers[m_currentFrame]);
 
-    vkCmdDispatch(m_computeCommandBuffers[m_currentFrame], std::ceil(((double)res.x / INTERPOLATE_PIXELS_X) / 32.f), std::ceil(((double)res.y / INTERPOLATE_PIXELS_Y) / 32.f), 1);
+    vkCmdDispatch(m_computeCommandBuffers[m_currentFrame], tileCount.x, tileCount.y, 1);
+
+    if (params.variableRate)
+    {
+        // the skipped pixels are interpolated from the samples written to the history
+        vkCmdPipelineBarrier(m_computeCommandBuffers[m_currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &historyBarrier, 0, nullptr);
+
+        m_upsamplePipeline->bind(m_computeCommandBuffers[m_currentFrame]);
+
+        vkCmdDispatch(m_computeCommandBuffers[m_currentFrame], tileCount.x, tileCount.y, 1);
+    }
+
+    // release to the graphics queue, setNovelViewBarrier is the matching acquire
+    m_device->createImageBarrier(m_computeCommandBuffers[m_currentFrame], VK_ACCESS_SHADER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_GENERAL,
+        VK_IMAGE_LAYOUT_GENERAL, m_novelImages[m_currentFrame]->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_device->getComputeFamily(), m_device->getGraphicsFamily());
+
+    m_profiler->endZone(m_computeCommandBuffers[m_currentFrame]);
 
 #ifdef RAY_EVAL_DEBUG
     ViewEvalDebugCompute* evalData = (ViewEvalDebugCompute*)m_creDebugSsbo[m_currentFrame]->getMapped();
@@ -410,6 +826,25 @@ void Renderer::renderPass(const std::shared_ptr<Scene> &scene, const std::shared
     if (updateData)
         updateDescriptorData(scene, views, viewMatrix);
 
+    m_profiler->beginZone(m_commandBuffers[m_currentFrame], "Scene");
+
+    // the debug camera geometry is only in the per-view draws
+    if (m_gridRendering && scene->gridResourcesExist(viewGrid) && !scene->getRenderDebugGeometryFlag())
+    {
+        glm::vec2 framebufferResolution(m_renderPassExtent.width, m_renderPassExtent.height);
+
+        if (updateData)
+            scene->updateGridRenderData(viewGrid, views, m_currentFrame, framebufferResolution);
+
+        setViewport(glm::vec2(0, 0), framebufferResolution);
+        setScissor(glm::vec2(0, 0), framebufferResolution);
+
+        recordGridCommandBuffer(m_commandBuffers[m_currentFrame], scene, viewGrid);
+
+        m_profiler->endZone(m_commandBuffers[m_currentFrame]);
+        return;
+    }
+
     for (auto& view : views)
     {
         if (updateData)
@@ -423,6 +858,8 @@ void Renderer::renderPass(const std::shared_ptr<Scene> &scene, const std::shared
 
         recordCommandBuffer(m_commandBuffers[m_currentFrame], scene, view);
     }
+
+    m_profiler->endZone(m_commandBuffers[m_currentFrame]);
 }
 
 void Renderer::quadRenderPass(glm::vec2 windowResolution, bool depthOnly, bool secondaryWindow)
@@ -430,6 +867,8 @@ void Renderer::quadRenderPass(glm::vec2 windowResolution, bool depthOnly, bool s
     if (!secondaryWindow)
         updateQuadDescriptorData(depthOnly);
 
+    m_profiler->beginZone(m_commandBuffers[m_currentFrame], "Quad");
+
     setViewport(glm::vec2(0, 0), windowResolution);
     setScissor(glm::vec2(0, 0), windowResolution);
 
@@ -444,6 +883,110 @@ void Renderer::quadRenderPass(glm::vec2 windowResolution, bool depthOnly, bool s
     vkCmdBindDescriptorSets(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_quadPipeline->getPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr);
 
     vkCmdDraw(m_commandBuffers[m_currentFrame], 3, 1, 0, 0);
+
+    m_profiler->endZone(m_commandBuffers[m_currentFrame]);
+}
+
+void Renderer::metricsPass(uint32_t id)
+{
+    VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
+
+    // both images were made readable to the fragment shaders, the reduction reads them in compute
+    VkMemoryBarrier imagesBarrier{};
+    imagesBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    imagesBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imagesBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &imagesBarrier, 0, nullptr, 0, nullptr);
+
+    VkDescriptorSet metricsSet = m_metricsDescriptorSets[m_currentFrame]->getDescriptorSet();
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_metricsPipeline->getPipelineLayout(),
+        0, 1, &metricsSet, 0, nullptr);
+
+    m_profiler->beginZone(commandBuffer, "Metrics");
+
+    VkExtent2D res = m_offscreenFramebuffer->getResolution();
+
+    m_metricsPipeline->bind(commandBuffer);
+    vkCmdDispatch(commandBuffer, std::ceil(res.width / static_cast<float>(METRICS_GROUP_SIZE)),
+        std::ceil(res.height / static_cast<float>(METRICS_GROUP_SIZE)), 1);
+
+    VkBufferMemoryBarrier partialBarrier{};
+    partialBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    partialBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    partialBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    partialBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    partialBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    partialBarrier.buffer = m_metricsPartialSsbos[m_currentFrame]->getVkBuffer();
+    partialBarrier.offset = 0;
+    partialBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr, 1, &partialBarrier, 0, nullptr);
+
+    // same layout, the descriptor set stays bound
+    m_metricsReducePipeline->bind(commandBuffer);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+    m_profiler->endZone(commandBuffer);
+
+    VkBufferMemoryBarrier metricsBarrier = partialBarrier;
+    metricsBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    metricsBarrier.buffer = m_metricsSsbos[m_currentFrame]->getVkBuffer();
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &metricsBarrier, 0, nullptr);
+
+    m_metricsFrames[m_currentFrame] = m_frameNumber;
+    m_metricsIds[m_currentFrame] = id;
+}
+
+std::vector<std::pair<uint32_t, ImageMetrics>> Renderer::collectMetrics()
+{
+    std::vector<std::pair<uint32_t, ImageMetrics>> metrics;
+
+    // the oldest frame is the one of the current slot
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        int frame = (m_currentFrame + i) % MAX_FRAMES_IN_FLIGHT;
+
+        // recorded but not submitted yet, the slot still holds the point of its previous frame
+        if (m_metricsFrames[frame] >= m_frameNumber || !m_scheduler->isReached(m_graphicsPoints[frame]))
+            continue;
+
+        MetricsSumsCompute sums = *static_cast<MetricsSumsCompute*>(m_metricsSsbos[frame]->getMapped());
+        metrics.push_back({ m_metricsIds[frame], utils::metricsFromSums(sums) });
+
+        m_metricsFrames[frame] = UINT64_MAX;
+    }
+
+    return metrics;
+}
+
+void Renderer::readbackImages(const std::vector<ReadbackSource>& sources, ReadbackJob job)
+{
+    std::vector<std::shared_ptr<Image>> images;
+    for (auto& source : sources)
+    {
+        if (source == ReadbackSource::VIEW_MATRIX)
+            images.push_back(m_viewMatrixFramebuffer->getColorImage());
+        else if (source == ReadbackSource::OFFSCREEN)
+            images.push_back(m_offscreenFramebuffer->getColorImage());
+        else
+            images.push_back(m_novelImages[m_currentFrame]);
+    }
+
+    // the framebuffers were rendered or sampled, the novel view was sampled or reduced
+    m_readback->copyImages(m_commandBuffers[m_currentFrame], images, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        job);
+}
+
+void Renderer::flushReadbacks()
+{
+    m_readback->flush();
 }
 
 void Renderer::pointsRenderPass(const std::shared_ptr<ViewGrid>& mainView, const std::shared_ptr<ViewGrid>& viewGrid,
@@ -453,6 +996,8 @@ void Renderer::pointsRenderPass(const std::shared_ptr<ViewGrid>& mainView, const
 
     updatePointsDescriptorData(view, viewGrid, pointsParams);
 
+    m_profiler->beginZone(m_commandBuffers[m_currentFrame], "Point cloud");
+
     setViewport(glm::vec2(0, 0), mainView->getResolution());
     setScissor(glm::vec2(0, 0), mainView->getResolution());
 
@@ -462,9 +1007,12 @@ void Renderer::pointsRenderPass(const std::shared_ptr<ViewGrid>& mainView, const
     vkCmdBindDescriptorSets(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pointCloudPipeline->getPipelineLayout(), 0, 1, &pointsSet, 0, nullptr);
 
     vkCmdDraw(m_commandBuffers[m_currentFrame], pointsParams.resolution.x * pointsParams.resolution.y, 1, 0, 0);
+
+    m_profiler->endZone(m_commandBuffers[m_currentFrame]);
 }
 
-void Renderer::setViewport(const glm::vec2& viewportStart, const glm::vec2& viewportResolution)
+void Renderer::setViewport(const glm::vec2& viewportStart, const glm::vec2& viewportResolution,
+    VkCommandBuffer commandBuffer)
 {
     VkViewport viewport{};
     viewport.x = viewportStart.x;
@@ -473,23 +1021,28 @@ void Renderer::setViewport(const glm::vec2& viewportStart, const glm::vec2& view
     viewport.height = viewportResolution.y;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(m_commandBuffers[m_currentFrame], 0, 1, &viewport);
+    vkCmdSetViewport(commandBuffer != VK_NULL_HANDLE ? commandBuffer : m_commandBuffers[m_currentFrame], 0, 1, &viewport);
 }
 
-void Renderer::setScissor(const glm::vec2& viewportStart, const glm::vec2& viewportResolution)
+void Renderer::setScissor(const glm::vec2& viewportStart, const glm::vec2& viewportResolution,
+    VkCommandBuffer commandBuffer)
 {
     VkRect2D scissor{};
     scissor.offset = { (int32_t)viewportStart.x, (int32_t)viewportStart.y };
     scissor.extent = { (uint32_t)viewportResolution.x, (uint32_t)viewportResolution.y };
-    vkCmdSetScissor(m_commandBuffers[m_currentFrame], 0, 1, &scissor);
+    vkCmdSetScissor(commandBuffer != VK_NULL_HANDLE ? commandBuffer : m_commandBuffers[m_currentFrame], 0, 1, &scissor);
 }
 
 void Renderer::prepareFrame(const std::shared_ptr<Scene>& scene, std::shared_ptr<Window> window,
     WindowParams& params)
 {
+    TRACE_ZONE("Prepare frame");
+
     // Graphics part
-    VkFence currentFence = m_swapChain->getFenceId(m_currentFrame);
-    vkWaitForFences(m_device->getVkDevice(), 1, &currentFence, VK_TRUE, UINT64_MAX);
+    m_scheduler->wait({ m_graphicsPoints[m_currentFrame] });
+    m_scheduler->collectTimings();
+
+    destroyRetiredResources();
 
     VkSemaphore currentImageAvailableSemaphore = m_swapChain->getImageAvailableSemaphore(m_currentFrame);
     
@@ -506,8 +1059,6 @@ void Renderer::prepareFrame(const std::shared_ptr<Scene>& scene, std::shared_ptr
     if (params.result != VK_SUCCESS || params.secondaryResult != VK_SUCCESS)
         return;
 
-    vkResetFences(m_device->getVkDevice(), 1, &currentFence);
-
     VkCommandBuffer currentCommandBuffer = m_commandBuffers[m_currentFrame];
 
     vkResetCommandBuffer(currentCommandBuffer, 0);
@@ -518,7 +1069,6 @@ void Renderer::submitFrame(bool secondarySwapchain, bool waitForCompute)
     VkCommandBuffer currentCommandBuffer = m_commandBuffers[m_currentFrame];
 
     VkSemaphore currentImageAvailableSemaphore = m_swapChain->getImageAvailableSemaphore(m_currentFrame);
-    VkFence currentFence = m_swapChain->getFenceId(m_currentFrame);
         
     std::vector<VkSemaphore> waitSemaphores = {
         currentImageAvailableSemaphore
@@ -534,83 +1084,83 @@ void Renderer::submitFrame(bool secondarySwapchain, bool waitForCompute)
         waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
     }
 
+    // culled draws are read as indirect arguments
+    std::vector<ScheduleDependency> dependencies;
     if (waitForCompute)
-    {
-        waitSemaphores.push_back(m_swapChain->getComputeFinishedSemaphore(m_currentFrame));
-        waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
-    }
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = waitSemaphores.size();
-    submitInfo.pWaitSemaphores = waitSemaphores.data();
-    submitInfo.pWaitDstStageMask = waitStages.data();
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &currentCommandBuffer;
-
-    VkSemaphore currentRenderFinishedSemaphore = m_swapChain->getRenderFinishedSemaphore(m_currentFrame);
-    VkSemaphore signalSemaphores[] = {currentRenderFinishedSemaphore};
+        dependencies.push_back(ScheduleDependency{ m_computePoints[m_currentFrame], VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT });
 
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    std::vector<VkSemaphore> signalSemaphores = {
+        m_swapChain->getRenderFinishedSemaphore(m_currentFrame)
+    };
 
-    VkResult res = vkQueueSubmit(m_device->getGraphicsQueue(), 1, &submitInfo, currentFence);
-    if (res != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to submit draw command buffer!");
-    }
+    m_graphicsPoints[m_currentFrame] = m_scheduler->submit(QueueType::GRAPHICS, FrameStage::QUAD, currentCommandBuffer,
+        dependencies, waitSemaphores, waitStages, signalSemaphores);
+    m_readback->submit(m_graphicsPoints[m_currentFrame]);
 }
 
 void Renderer::submitGraphics()
 {
     VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
-    VkCommandBuffer currentCommandBuffer = commandBuffer;
-
-    VkFence currentFence = m_swapChain->getFenceId(m_currentFrame);
-    VkSemaphore currentComputeFinishedSemaphore = m_swapChain->getComputeFinishedSemaphore(m_currentFrame);
 
-    VkSemaphore waitSemaphores[] = {
-        currentComputeFinishedSemaphore
-    };
-    VkPipelineStageFlags waitStages[] = { 
-        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+    std::vector<ScheduleDependency> dependencies = {
+        ScheduleDependency{ m_computePoints[m_currentFrame], VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT }
     };
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &currentCommandBuffer;
+    // the rendered views are sampled by the next ray evaluation, which can run on another queue
+    m_graphicsPoints[m_currentFrame] = m_scheduler->submit(QueueType::GRAPHICS, FrameStage::VIEW_MATRIX, commandBuffer,
+        dependencies);
+    m_viewMatrixPoint = m_graphicsPoints[m_currentFrame];
+    m_readback->submit(m_graphicsPoints[m_currentFrame]);
 
-    VkResult res = vkQueueSubmit(m_device->getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-    if (res != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to submit draw command buffer!");
-    }
+    // the next frame must not reuse the command buffer while it is executed
+    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_frameNumber++;
 }
 
-void Renderer::submitCompute()
+void Renderer::prepareOffscreenFrame()
 {
-    VkFence currentComputeFence = m_swapChain->getComputeFenceId(m_currentFrame);
+    TRACE_ZONE("Prepare frame");
 
-    VkSemaphore currentComputeFinishedSemaphore = m_swapChain->getComputeFinishedSemaphore(m_currentFrame);
+    m_scheduler->wait({ m_graphicsPoints[m_currentFrame] });
+    m_scheduler->collectTimings();
 
-    VkSubmitInfo computeSubmitInfo{};
-    computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    computeSubmitInfo.commandBufferCount = 1;
-    computeSubmitInfo.pCommandBuffers = &m_computeCommandBuffers[m_currentFrame];
-    computeSubmitInfo.signalSemaphoreCount = 1;
-    computeSubmitInfo.pSignalSemaphores = &currentComputeFinishedSemaphore;
+    destroyRetiredResources();
 
-    VkResult res = vkQueueSubmit(m_device->getComputeQueue(), 1, &computeSubmitInfo, currentComputeFence);
-    if (res != VK_SUCCESS)
-        throw std::runtime_error("failed to submit compute command buffer");
+    vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
+}
+
+void Renderer::submitOffscreenFrame(bool waitForCompute)
+{
+    VkCommandBuffer currentCommandBuffer = m_commandBuffers[m_currentFrame];
+
+    std::vector<ScheduleDependency> dependencies;
+    if (waitForCompute)
+        dependencies.push_back(ScheduleDependency{ m_computePoints[m_currentFrame], VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT });
+
+    m_graphicsPoints[m_currentFrame] = m_scheduler->submit(QueueType::GRAPHICS, FrameStage::QUAD, currentCommandBuffer,
+        dependencies);
+    m_readback->submit(m_graphicsPoints[m_currentFrame]);
+
+    // There is no present in headless mode, so the frame is advanced here.
+    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_frameNumber++;
+}
+
+void Renderer::submitCompute()
+{
+    // the ray evaluation reads the views of the last view matrix render, the culling does not
+    std::vector<ScheduleDependency> dependencies;
+    if (m_computeStage == FrameStage::RAY_EVAL)
+        dependencies.push_back(ScheduleDependency{ m_viewMatrixPoint, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+
+    m_computePoints[m_currentFrame] = m_scheduler->submit(QueueType::COMPUTE, m_computeStage,
+        m_computeCommandBuffers[m_currentFrame], dependencies);
 }
 
 void Renderer::presentFrame(std::shared_ptr<Window> window, WindowParams& params)
 {
+    TRACE_ZONE("Present");
+
     VkSemaphore currentRenderFinishedSemaphore = m_swapChain->getRenderFinishedSemaphore(m_currentFrame);
     VkSemaphore signalSemaphores[] = {currentRenderFinishedSemaphore};
 
@@ -652,6 +1202,7 @@ void Renderer::presentFrame(std::shared_ptr<Window> window, WindowParams& params
     // }
 
     m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_frameNumber++;
 }
 
 void Renderer::changeQuadRenderPassSource(VkDescriptorImageInfo imageInfo, bool allFrames)
@@ -664,6 +1215,9 @@ void Renderer::changeQuadRenderPassSource(VkDescriptorImageInfo imageInfo, bool
         1
     };
 
+    // the sets must not be updated while a pending frame uses them
+    waitForFrames(allFrames);
+
     if (allFrames)
     {
         for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
@@ -678,6 +1232,27 @@ void Renderer::changeQuadRenderPassSource(VkDescriptorImageInfo imageInfo, bool
 
 }
 
+void Renderer::changeQuadRenderPassSourceToNovelView(bool allFrames)
+{
+    std::vector<uint32_t> imageBinding{
+        1
+    };
+
+    waitForFrames(allFrames);
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        if (!allFrames && i != m_currentFrame)
+            continue;
+
+        std::vector<VkDescriptorImageInfo> imageInfos{
+            getNovelImageInfo(i)
+        };
+
+        m_quadDescriptorSets[i]->updateImages(imageBinding, imageInfos, 0);
+    }
+}
+
 void Renderer::copyOffscreenFrameBufferToSupp()
 {
     m_device->copyImageToImage(m_viewMatrixFramebuffer->getColorImage(), m_testPixelImage, m_commandBuffers[m_currentFrame]);
@@ -804,18 +1379,18 @@ std::shared_ptr<Framebuffer> Renderer::getViewMatrixFramebuffer() const
     return m_viewMatrixFramebuffer;
 }
 
-VkDescriptorImageInfo Renderer::getNovelImageInfo() const
+VkDescriptorImageInfo Renderer::getNovelImageInfo(uint32_t frame) const
 {
     return VkDescriptorImageInfo{
         m_novelImageSampler->getVkSampler(),
-        m_novelImageView,
-        m_novelImage->getVkImageLayout()
+        m_novelImageViews[frame],
+        m_novelImages[frame]->getVkImageLayout()
     };
 }
 
 std::shared_ptr<Image> Renderer::getNovelViewImage() const
 {
-    return m_novelImage;
+    return m_novelImages[(m_currentFrame + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT];
 }
 
 VkDescriptorImageInfo Renderer::getTestPixelImageInfo() const
@@ -827,23 +1402,26 @@ VkDescriptorImageInfo Renderer::getTestPixelImageInfo() const
     };
 }
 
-SamplingType Renderer::getNovelViewSamplingType() const
+const StageTiming& Renderer::getStageTiming(FrameStage stage) const
 {
-    return m_novelViewSamplingType;
+    return m_scheduler->getStageTiming(stage);
 }
 
-void Renderer::setSceneChanged(int sceneChanged)
+std::shared_ptr<GpuProfiler> Renderer::getProfiler() const
 {
-    m_sceneFramesUpdated = sceneChanged;
+    return m_profiler;
 }
 
-void Renderer::setLightChanged(int lightChanged)
+SamplingType Renderer::getNovelViewSamplingType() const
 {
-    m_lightsFramesUpdated = lightChanged;
+    return m_novelViewSamplingType;
 }
 
 void Renderer::setNovelViewSamplingType(SamplingType samplingType)
 {
+    if (samplingType != m_novelViewSamplingType)
+        m_temporalHistoryValid = false;
+
     m_novelViewSamplingType = samplingType;
 }
 
@@ -875,10 +1453,10 @@ void Renderer::addSecondaryWindow(std::shared_ptr<Window> window)
 void Renderer::beginComputePass()
 {
     // Compute part
-    VkFence currentComputeFence = m_swapChain->getComputeFenceId(m_currentFrame);
-    vkWaitForFences(m_device->getVkDevice(), 1, &currentComputeFence, VK_TRUE, UINT64_MAX);
-
-    vkResetFences(m_device->getVkDevice(), 1, &currentComputeFence);
+    // the compute queue runs ahead of the graphics queue, the frame which last used the novel view
+    // image and the culled draws of this slot must have finished as well
+    m_scheduler->wait({ m_computePoints[m_currentFrame], m_graphicsPoints[m_currentFrame] });
+    m_computeStage = FrameStage::CULL;
 
     vkResetCommandBuffer(m_computeCommandBuffers[m_currentFrame], 0);
 
@@ -887,6 +1465,8 @@ void Renderer::beginComputePass()
 
     if (vkBeginCommandBuffer(m_computeCommandBuffers[m_currentFrame], &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("failed to begin compute command buffer");
+
+    m_profiler->beginCommandBuffer(m_computeCommandBuffers[m_currentFrame], QueueType::COMPUTE);
 }
 
 void Renderer::endComputePass()
@@ -908,6 +1488,9 @@ void Renderer::beginCommandBuffer()
     {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
+
+    m_profiler->beginCommandBuffer(commandBuffer, QueueType::GRAPHICS);
+    m_readback->collect();
 }
 
 void Renderer::beginRenderPass(std::shared_ptr<RenderPass> renderPass, std::shared_ptr<Framebuffer> framebuffer)
@@ -920,6 +1503,7 @@ void Renderer::beginRenderPass(std::shared_ptr<RenderPass> renderPass, std::shar
     renderPassInfo.renderPass = renderPass->getRenderPass();
 
     VkExtent2D res = framebuffer->getResolution();
+    m_renderPassExtent = res;
 
     renderPassInfo.framebuffer = framebuffer->getFramebuffer();
     renderPassInfo.renderArea.offset = {0, 0};
@@ -938,7 +1522,8 @@ void Renderer::beginRenderPass(std::shared_ptr<RenderPass> renderPass, std::shar
 void Renderer::setNovelViewBarrier()
 {
     m_device->createImageBarrier(m_commandBuffers[m_currentFrame], 0, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
-        VK_IMAGE_LAYOUT_GENERAL, m_novelImage->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        VK_IMAGE_LAYOUT_GENERAL, m_novelImages[m_currentFrame]->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, m_device->getComputeFamily(), m_device->getGraphicsFamily());
 }
 
 void Renderer::setOffscreenFramebufferBarrier()
@@ -972,53 +1557,14 @@ void Renderer::endCommandBuffer()
     }
 }
 
-float Renderer::collectQuery(bool compute)
+void Renderer::beginGpuZone(const std::string& name, bool compute)
 {
-    int previousFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-
-    uint64_t* results = (uint64_t*)malloc(sizeof(uint64_t) * (m_timestampCount / 2.f));
-    vkGetQueryPoolResults(m_device->getVkDevice(), (compute) ? m_timestampQueryCompPools[previousFrame] : m_timestampQueryGraphPools[previousFrame],
-        0, m_timestampCount / 2.f, sizeof(uint64_t) * (m_timestampCount / 2.f), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
-    
-    vkResetQueryPool(m_device->getVkDevice(), (compute) ? m_timestampQueryCompPools[previousFrame] : m_timestampQueryGraphPools[previousFrame],
-        0, m_timestampCount / 2.f);
-
-    uint64_t elapsed = (compute) ? results[m_endComputeQuery[previousFrame]] - results[m_startComputeQuery[previousFrame]] :
-        results[m_endGraphicsQuery[previousFrame]] - results[m_startGraphicsQuery[previousFrame]];
-    uint64_t elapsedNanoseconds = (uint64_t)(elapsed * m_timestampPeriod);
-
-    // std::cout << ((compute) ? "Compute: " : "Graphics: ") << ((float)elapsedNanoseconds / 1000000.f) << std::endl;
-// 
-    // static float highest = 0;
-// 
-    // highest = ((float)elapsedNanoseconds / 1000000.f > highest) ? (float)elapsedNanoseconds / 1000000.f : highest;
-// 
-    // std::cout << highest << std::endl;
-
-    return (float)elapsedNanoseconds / 1000000.f;
+    m_profiler->beginZone(compute ? m_computeCommandBuffers[m_currentFrame] : m_commandBuffers[m_currentFrame], name);
 }
 
-void Renderer::startQuery(bool compute)
+void Renderer::endGpuZone(bool compute)
 {
-    if (compute)
-        vkCmdWriteTimestamp(m_computeCommandBuffers[m_currentFrame], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryCompPools[m_currentFrame], m_startComputeQuery[m_currentFrame]);
-    else
-        vkCmdWriteTimestamp(m_commandBuffers[m_currentFrame], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryGraphPools[m_currentFrame], m_startGraphicsQuery[m_currentFrame]);
-}
-
-void Renderer::endQuery(bool compute)
-{
-    if (compute)
-    {
-        m_endComputeQuery[m_currentFrame] = 1;
-        vkCmdWriteTimestamp(m_computeCommandBuffers[m_currentFrame], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryCompPools[m_currentFrame], m_endComputeQuery[m_currentFrame]);
-    }
-    else
-    {
-        m_endGraphicsQuery[m_currentFrame] = 1;
-        vkCmdWriteTimestamp(m_commandBuffers[m_currentFrame], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryGraphPools[m_currentFrame], m_endGraphicsQuery[m_currentFrame]);
-    }
-
+    m_profiler->endZone(compute ? m_computeCommandBuffers[m_currentFrame] : m_commandBuffers[m_currentFrame]);
 }
 
 void Renderer::createCommandBuffers()
@@ -1043,7 +1589,7 @@ void Renderer::createComputeCommandBuffers()
 
     VkCommandBufferAllocateInfo computeAllocInfo{};
     computeAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    computeAllocInfo.commandPool = m_device->getCommandPool();
+    computeAllocInfo.commandPool = m_device->getComputeCommandPool();
     computeAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     computeAllocInfo.commandBufferCount = (uint32_t)m_computeCommandBuffers.size();
 
@@ -1192,6 +1738,14 @@ void Renderer::createDescriptors()
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
         m_cssbos[i]->map();
 
+        m_bvhssbos[i] = std::make_unique<Buffer>(m_device, sizeof(BvhHeaderCompute) + sizeof(BvhNodeCompute) * 2 * MAX_SBOS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        m_bvhssbos[i]->map();
+
+        m_bvhPrimitiveSsbos[i] = std::make_unique<Buffer>(m_device, sizeof(uint32_t) * MAX_SBOS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        m_bvhPrimitiveSsbos[i]->map();
+
         m_creubo[i] = std::make_unique<Buffer>(m_device, sizeof(RayEvalUniformBuffer), 
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
         m_creubo[i]->map();
@@ -1200,6 +1754,10 @@ void Renderer::createDescriptors()
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
         m_cressbo[i]->map();
 
+        m_viewTableSsbos[i] = std::make_unique<Buffer>(m_device, sizeof(ViewEvalTableCompute),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        m_viewTableSsbos[i]->map();
+
 #ifdef RAY_EVAL_DEBUG
         m_creDebugSsbo[i] = std::make_unique<Buffer>(m_device, sizeof(ViewEvalDebugCompute) * MAX_RESOLUTION_LINEAR, 
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
@@ -1211,10 +1769,16 @@ void Renderer::createDescriptors()
     // Compute general
     VkDescriptorSetLayoutBinding cssboLayoutBinding = createDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
         1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding bvhLayoutBinding = createDescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding bvhPrimitivesLayoutBinding = createDescriptorSetLayoutBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
 
     std::vector<VkDescriptorSetLayoutBinding> computeGeneralLayoutBindings = {
         // cuboLayoutBinding,
-        cssboLayoutBinding
+        cssboLayoutBinding,
+        bvhLayoutBinding,
+        bvhPrimitivesLayoutBinding
     };
 
     m_computeSetLayout = std::make_shared<DescriptorSetLayout>(m_device, computeGeneralLayoutBindings);
@@ -1232,15 +1796,18 @@ void Renderer::createDescriptors()
     //  Compute scene
     VkDescriptorSetLayoutBinding drawLayoutBinding = createDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
         1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding drawTemplateLayoutBinding = createDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
 
     std::vector<VkDescriptorSetLayoutBinding> computeSceneLayoutBindings = {
-        drawLayoutBinding
+        drawLayoutBinding,
+        drawTemplateLayoutBinding
     };
 
     m_computeSceneSetLayout = std::make_shared<DescriptorSetLayout>(m_device, computeSceneLayoutBindings);
 
     VkDescriptorPoolSize drawPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * static_cast<uint32_t>(MAX_SBOS));
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * static_cast<uint32_t>(MAX_SBOS) * 2);
     
     std::vector<VkDescriptorPoolSize> computeSceneSizes = {
         drawPoolSize
@@ -1248,6 +1815,59 @@ void Renderer::createDescriptors()
     m_computeScenePool = std::make_shared<DescriptorPool>(m_device, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 
         static_cast<uint32_t>(MAX_VIEWS + 1), 0, computeSceneSizes);
 
+    // Compute batched cull, draw buffers of all the grid views and their frustums
+    VkDescriptorSetLayoutBinding batchDrawsLayoutBinding = createDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        MAX_VIEWS, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding batchViewsLayoutBinding = createDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding batchGridDrawsLayoutBinding = createDescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding batchGridInstancesLayoutBinding = createDescriptorSetLayoutBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding batchDrawTemplateLayoutBinding = createDescriptorSetLayoutBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    std::vector<VkDescriptorSetLayoutBinding> computeBatchLayoutBindings = {
+        batchDrawsLayoutBinding,
+        batchViewsLayoutBinding,
+        batchGridDrawsLayoutBinding,
+        batchGridInstancesLayoutBinding,
+        batchDrawTemplateLayoutBinding
+    };
+
+    m_computeBatchSetLayout = std::make_shared<DescriptorSetLayout>(m_device, computeBatchLayoutBindings);
+
+    VkDescriptorPoolSize batchPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * static_cast<uint32_t>(MAX_CULL_GRIDS) * static_cast<uint32_t>(MAX_VIEWS + 4));
+
+    std::vector<VkDescriptorPoolSize> computeBatchSizes = {
+        batchPoolSize
+    };
+    m_computeBatchPool = std::make_shared<DescriptorPool>(m_device, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) *
+        static_cast<uint32_t>(MAX_CULL_GRIDS), 0, computeBatchSizes);
+
+    //! Grid rendering, matrices of all the grid views and the view of every instance
+    VkDescriptorSetLayoutBinding gridViewsLayoutBinding = createDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+    VkDescriptorSetLayoutBinding gridInstancesLayoutBinding = createDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_VERTEX_BIT);
+
+    std::vector<VkDescriptorSetLayoutBinding> gridViewLayoutBindings = {
+        gridViewsLayoutBinding,
+        gridInstancesLayoutBinding
+    };
+
+    m_gridViewSetLayout = std::make_shared<DescriptorSetLayout>(m_device, gridViewLayoutBindings);
+
+    VkDescriptorPoolSize gridViewPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * static_cast<uint32_t>(MAX_CULL_GRIDS) * 2);
+
+    std::vector<VkDescriptorPoolSize> gridViewSizes = {
+        gridViewPoolSize
+    };
+    m_gridViewPool = std::make_shared<DescriptorPool>(m_device, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) *
+        static_cast<uint32_t>(MAX_CULL_GRIDS), 0, gridViewSizes);
+
     // Compute raygen
     VkDescriptorSetLayoutBinding uboRayGenLayoutBinding = createDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
         1, VK_SHADER_STAGE_COMPUTE_BIT);
@@ -1265,6 +1885,14 @@ void Renderer::createDescriptors()
         1, VK_SHADER_STAGE_COMPUTE_BIT);
     VkDescriptorSetLayoutBinding testPixelRayGenLayoutBinding = createDescriptorSetLayoutBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
         1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding tileViewsRayGenLayoutBinding = createDescriptorSetLayoutBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding depthPyramidRayGenLayoutBinding = createDescriptorSetLayoutBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding historyRayGenLayoutBinding = createDescriptorSetLayoutBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding viewTableRayGenLayoutBinding = createDescriptorSetLayoutBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1, VK_SHADER_STAGE_COMPUTE_BIT);
 
     std::vector<VkDescriptorSetLayoutBinding> computeRayGenLayoutBindings = {
         uboRayGenLayoutBinding,
@@ -1275,7 +1903,11 @@ void Renderer::createDescriptors()
         viewsFramebRayGenLayoutBinding,
         viewsFramebDepthRayGenLayoutBinding,
         novelFramebRayGenLayoutBinding,
-        testPixelRayGenLayoutBinding
+        testPixelRayGenLayoutBinding,
+        tileViewsRayGenLayoutBinding,
+        depthPyramidRayGenLayoutBinding,
+        historyRayGenLayoutBinding,
+        viewTableRayGenLayoutBinding
     };
 
     m_computeRayEvalSetLayout = std::make_shared<DescriptorSetLayout>(m_device, computeRayGenLayoutBindings);
@@ -1296,6 +1928,14 @@ void Renderer::createDescriptors()
         static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
     VkDescriptorPoolSize testPixelbRayGenPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
         static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    VkDescriptorPoolSize tileViewsRayGenPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    VkDescriptorPoolSize depthPyramidRayGenPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    VkDescriptorPoolSize historyRayGenPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    VkDescriptorPoolSize viewTableRayGenPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
     
 
     std::vector<VkDescriptorPoolSize> computeRayGenSizes = {
@@ -1307,12 +1947,77 @@ void Renderer::createDescriptors()
         viewsFramebRayGenPoolSize,
         viewsFramebDepthRayGenPoolSize,
         novelFramebRayGenPoolSize,
-        testPixelbRayGenPoolSize
+        testPixelbRayGenPoolSize,
+        tileViewsRayGenPoolSize,
+        depthPyramidRayGenPoolSize,
+        historyRayGenPoolSize,
+        viewTableRayGenPoolSize
     };
 
     m_computeRayEvalPool = std::make_shared<DescriptorPool>(m_device, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), 0,
         computeRayGenSizes);
 
+    // Depth pyramid
+    VkDescriptorSetLayoutBinding depthPyramidDepthLayoutBinding = createDescriptorSetLayoutBinding(0,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding depthPyramidViewsLayoutBinding = createDescriptorSetLayoutBinding(1,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding depthPyramidLayoutBinding = createDescriptorSetLayoutBinding(2,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    std::vector<VkDescriptorSetLayoutBinding> depthPyramidLayoutBindings = {
+        depthPyramidDepthLayoutBinding,
+        depthPyramidViewsLayoutBinding,
+        depthPyramidLayoutBinding
+    };
+
+    m_depthPyramidSetLayout = std::make_shared<DescriptorSetLayout>(m_device, depthPyramidLayoutBindings);
+
+    VkDescriptorPoolSize depthPyramidDepthPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    VkDescriptorPoolSize depthPyramidBuffersPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2);
+
+    std::vector<VkDescriptorPoolSize> depthPyramidSizes = {
+        depthPyramidDepthPoolSize,
+        depthPyramidBuffersPoolSize
+    };
+
+    m_depthPyramidPool = std::make_shared<DescriptorPool>(m_device, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), 0,
+        depthPyramidSizes);
+
+    // Image metrics
+    VkDescriptorSetLayoutBinding metricsGtLayoutBinding = createDescriptorSetLayoutBinding(0,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding metricsNovelLayoutBinding = createDescriptorSetLayoutBinding(1,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding metricsPartialLayoutBinding = createDescriptorSetLayoutBinding(2,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    VkDescriptorSetLayoutBinding metricsLayoutBinding = createDescriptorSetLayoutBinding(3,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    std::vector<VkDescriptorSetLayoutBinding> metricsLayoutBindings = {
+        metricsGtLayoutBinding,
+        metricsNovelLayoutBinding,
+        metricsPartialLayoutBinding,
+        metricsLayoutBinding
+    };
+
+    m_metricsSetLayout = std::make_shared<DescriptorSetLayout>(m_device, metricsLayoutBindings);
+
+    VkDescriptorPoolSize metricsImagesPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2);
+    VkDescriptorPoolSize metricsBuffersPoolSize = createPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2);
+
+    std::vector<VkDescriptorPoolSize> metricsSizes = {
+        metricsImagesPoolSize,
+        metricsBuffersPoolSize
+    };
+
+    m_metricsPool = std::make_shared<DescriptorPool>(m_device, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), 0,
+        metricsSizes);
+
     // quad
     VkDescriptorSetLayoutBinding quboLayoutBinding = createDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
         1, VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -1413,28 +2118,88 @@ void Renderer::createRenderResources(const RendererInitParams& params)
 {
     VkFormat depthFormat = m_device->getDepthFormat();
 
-    m_swapChain = std::make_shared<SwapChain>(m_device, m_window->getExtent(), m_window->getSurface());
-    m_quadRenderPass = std::make_shared<RenderPass>(m_device, m_swapChain->getImageFormat(), depthFormat);
-    m_swapChain->initializeFramebuffers(m_quadRenderPass);
+    if (!m_headless)
+    {
+        m_swapChain = std::make_shared<SwapChain>(m_device, m_window->getExtent(), m_window->getSurface());
+        m_quadRenderPass = std::make_shared<RenderPass>(m_device, m_swapChain->getImageFormat(), depthFormat);
+        m_swapChain->initializeFramebuffers(m_quadRenderPass);
+    }
+    else
+    {
+        // The quad pass is never recorded headless, the render pass only keeps the quad pipeline valid.
+        m_quadRenderPass = std::make_shared<RenderPass>(m_device, VK_FORMAT_R8G8B8A8_UNORM, depthFormat);
+    }
 
     m_offscreenRenderPass = std::make_shared<RenderPass>(m_device, VK_FORMAT_R8G8B8A8_UNORM,
         depthFormat, true);
 
+    m_offscreenLoadRenderPass = std::make_shared<RenderPass>(m_device, VK_FORMAT_R8G8B8A8_UNORM,
+        depthFormat, true, true);
+
     m_offscreenFramebuffer = std::make_shared<Framebuffer>(m_device, m_offscreenRenderPass,
         VkExtent2D{(uint32_t)params.novelResolution.x, (uint32_t)params.novelResolution.y});
 
     m_viewMatrixFramebuffer = std::make_shared<Framebuffer>(m_device, m_offscreenRenderPass,
         VkExtent2D{(uint32_t)params.viewGridResolution.x, (uint32_t)params.viewGridResolution.y});
 
-    m_novelImage = std::make_shared<Image>(m_device, params.novelResolution, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    m_novelImage->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-    m_novelImageView = m_novelImage->createImageView(VK_IMAGE_ASPECT_COLOR_BIT);
+    m_novelImages.resize(MAX_FRAMES_IN_FLIGHT);
+    m_novelImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_novelImages[i] = std::make_shared<Image>(m_device, params.novelResolution, VK_FORMAT_R8G8B8A8_UNORM,
+            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        m_novelImages[i]->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+        m_novelImageViews[i] = m_novelImages[i]->createImageView(VK_IMAGE_ASPECT_COLOR_BIT);
+    }
     m_novelImageSampler = std::make_shared<Sampler>(m_device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
         VK_SAMPLER_MIPMAP_MODE_LINEAR);
 
+    glm::uvec2 tileCount = getRayEvalTileCount();
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_tileViewsSsbos[i] = std::make_unique<Buffer>(m_device, sizeof(TileViewsCompute) * tileCount.x * tileCount.y,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        m_depthPyramidViewSsbos[i] = std::make_unique<Buffer>(m_device, sizeof(DepthPyramidViewCompute) * MAX_VIEWS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        m_depthPyramidViewSsbos[i]->map();
+    }
+
+    // one partial sum per metrics workgroup of the novel view
+    glm::uvec2 metricsGroups = (glm::uvec2(params.novelResolution) + glm::uvec2(METRICS_GROUP_SIZE - 1)) /
+        glm::uvec2(METRICS_GROUP_SIZE);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_metricsPartialSsbos[i] = std::make_unique<Buffer>(m_device,
+            sizeof(MetricsSumsCompute) * metricsGroups.x * metricsGroups.y,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        m_metricsSsbos[i] = std::make_unique<Buffer>(m_device, sizeof(MetricsSumsCompute),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_metricsSsbos[i]->map();
+    }
+
+    // Views tile the atlas in at most MAX_VIEWS columns and rows, every one of them rounds its levels up
+    m_depthPyramidCapacity = 0;
+    for (int level = 0; level < DEPTH_PYRAMID_LEVELS; level++)
+    {
+        uint32_t cell = DEPTH_PYRAMID_BASE << level;
+        m_depthPyramidCapacity += (static_cast<uint32_t>(params.viewGridResolution.x) / cell + MAX_VIEWS) *
+            (static_cast<uint32_t>(params.viewGridResolution.y) / cell + MAX_VIEWS);
+    }
+
+    m_depthPyramidSsbo = std::make_unique<Buffer>(m_device, sizeof(glm::vec2) * m_depthPyramidCapacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // two halves of the ray eval grid, one is read while the other one is written
+    uint32_t historySize = tileCount.x * tileCount.y * RAY_EVAL_TILE_SIZE * RAY_EVAL_TILE_SIZE;
+    m_temporalHistorySsbo = std::make_unique<Buffer>(m_device, sizeof(TemporalHistoryCompute) * historySize * 2,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // copied into on the graphics queue, the tested pixel is drawn into it by the compute queue
     m_testPixelImage = std::make_shared<Image>(m_device, params.viewGridResolution, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, true);
     m_testPixelImage->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
     m_testPixelImageView = m_testPixelImage->createImageView(VK_IMAGE_ASPECT_COLOR_BIT);
     m_testPixelSampler = std::make_shared<Sampler>(m_device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
@@ -1451,6 +2216,8 @@ void Renderer::createRenderResources(const RendererInitParams& params)
 
 void Renderer::createPipeline(const RendererInitParams& params)
 {
+    TRACE_ZONE("Pipeline creation");
+
     std::vector<VkDescriptorSetLayout> offscreenGraphicsSetLayouts = {
         m_descriptorSetLayout->getLayout(),
         m_materialSetLayout->getLayout(),
@@ -1463,6 +2230,17 @@ void Renderer::createPipeline(const RendererInitParams& params)
         m_viewSetLayout->getLayout()
     };
 
+    std::vector<VkDescriptorSetLayout> offscreenGridSetLayouts = {
+        m_descriptorSetLayout->getLayout(),
+        m_materialSetLayout->getLayout(),
+        m_gridViewSetLayout->getLayout()
+    };
+
+    std::vector<VkDescriptorSetLayout> computeBatchedSetLayouts = {
+        m_computeSetLayout->getLayout(),
+        m_computeBatchSetLayout->getLayout()
+    };
+
     std::vector<VkDescriptorSetLayout> quadSetLayout = {
         m_quadSetLayout->getLayout(),
         m_secondaryQuadSetLayout->getLayout()
@@ -1479,6 +2257,9 @@ void Renderer::createPipeline(const RendererInitParams& params)
     m_offscreenPipeline = std::make_shared<GraphicsPipeline>(m_device, m_offscreenRenderPass->getRenderPass(), params.vertexShaderFile,
         params.fragmentShaderFile, offscreenGraphicsSetLayouts);
 
+    m_offscreenGridPipeline = std::make_shared<GraphicsPipeline>(m_device, m_offscreenRenderPass->getRenderPass(),
+        params.gridVertexShaderFile, params.gridFragmentShaderFile, offscreenGridSetLayouts);
+
     m_quadPipeline = std::make_shared<GraphicsPipeline>(m_device, m_quadRenderPass->getRenderPass(), params.quadVertexShaderFile,
         params.quadFragmentShaderFile, quadSetLayout, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, false, false);
     
@@ -1487,30 +2268,92 @@ void Renderer::createPipeline(const RendererInitParams& params)
 
     m_cullPipeline = std::make_shared<ComputePipeline>(m_device, params.computeShaderFile, computeSetLayouts);
 
+    m_cullBatchedPipeline = std::make_shared<ComputePipeline>(m_device, params.computeBatchedShaderFile,
+        computeBatchedSetLayouts);
+
     m_raysEvalPipeline = std::make_shared<ComputePipeline>(m_device, params.computeRaysEvalShaderFile, computeRaysEvalSetLayout);
+
+    m_tileViewsPipeline = std::make_shared<ComputePipeline>(m_device, params.computeTileViewsShaderFile, computeRaysEvalSetLayout);
+
+    m_upsamplePipeline = std::make_shared<ComputePipeline>(m_device, params.novelViewUpsampleShaderFile, computeRaysEvalSetLayout);
+
+    std::vector<VkDescriptorSetLayout> depthPyramidSetLayout = {
+        m_depthPyramidSetLayout->getLayout()
+    };
+
+    m_depthPyramidPipeline = std::make_shared<ComputePipeline>(m_device, params.depthPyramidShaderFile, depthPyramidSetLayout);
+
+    std::vector<VkDescriptorSetLayout> metricsSetLayout = {
+        m_metricsSetLayout->getLayout()
+    };
+
+    m_metricsPipeline = std::make_shared<ComputePipeline>(m_device, params.metricsShaderFile, metricsSetLayout);
+    m_metricsReducePipeline = std::make_shared<ComputePipeline>(m_device, params.metricsReduceShaderFile, metricsSetLayout);
 }
 
-void Renderer::createQueryResources()
+void Renderer::createViewMatrixUpdateResources()
 {
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(m_device->getPhysicalDevice(), &properties);
-    m_timestampPeriod = properties.limits.timestampPeriod;
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_device->getCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(m_viewMatrixCommandBuffers.size());
 
-    VkQueryPoolCreateInfo poolCreateInfo{};
-    poolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-    poolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-    poolCreateInfo.queryCount = 2;
+    if (vkAllocateCommandBuffers(m_device->getVkDevice(), &allocInfo, m_viewMatrixCommandBuffers.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate view matrix command buffer!");
+    }
+}
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+void Renderer::deferDestroy(std::function<void()> destroy)
+{
+    m_deferredDestroys.emplace_back(m_frameNumber, destroy);
+}
+
+void Renderer::waitForFrames(bool allFrames)
+{
+    if (allFrames)
     {
-        vkCreateQueryPool(m_device->getVkDevice(), &poolCreateInfo, nullptr, &m_timestampQueryGraphPools[i]);
-        vkCreateQueryPool(m_device->getVkDevice(), &poolCreateInfo, nullptr, &m_timestampQueryCompPools[i]);
+        m_scheduler->waitIdle();
+        return;
+    }
 
-        vkResetQueryPool(m_device->getVkDevice(), m_timestampQueryCompPools[i], 0, m_timestampCount / 2.f);
-        vkResetQueryPool(m_device->getVkDevice(), m_timestampQueryGraphPools[i], 0, m_timestampCount / 2.f);
+    m_scheduler->wait({ m_graphicsPoints[m_currentFrame], m_computePoints[m_currentFrame] });
+}
+
+void Renderer::destroyRetiredResources(bool all)
+{
+    // frames submitted before the retirement are finished once the frame slots went around once
+    while (!m_deferredDestroys.empty() &&
+        (all || m_deferredDestroys.front().first + MAX_FRAMES_IN_FLIGHT <= m_frameNumber))
+    {
+        m_deferredDestroys.front().second();
+        m_deferredDestroys.pop_front();
     }
 }
 
+uint32_t Renderer::getDepthPyramidSize(const glm::vec2& res)
+{
+    uint32_t size = 0;
+    for (int level = 0; level < DEPTH_PYRAMID_LEVELS; level++)
+    {
+        uint32_t cell = DEPTH_PYRAMID_BASE << level;
+        size += ((static_cast<uint32_t>(res.x) + cell - 1) / cell) * ((static_cast<uint32_t>(res.y) + cell - 1) / cell);
+    }
+
+    return size;
+}
+
+glm::uvec2 Renderer::getRayEvalTileCount() const
+{
+    glm::vec2 res = m_novelImages[0]->getDims();
+
+    return glm::uvec2(
+        std::ceil((res.x / INTERPOLATE_PIXELS_X) / RAY_EVAL_TILE_SIZE),
+        std::ceil((res.y / INTERPOLATE_PIXELS_Y) / RAY_EVAL_TILE_SIZE)
+    );
+}
+
 void Renderer::handleResizeWindow(bool main)
 {    
     if (main)
@@ -1544,6 +2387,23 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, const std::sha
     scene->draw(view, commandBuffer, m_currentFrame);
 }
 
+void Renderer::recordGridCommandBuffer(VkCommandBuffer commandBuffer, const std::shared_ptr<Scene>& scene,
+    const std::shared_ptr<ViewGrid>& viewGrid)
+{
+    m_offscreenGridPipeline->bind(commandBuffer);
+
+    VkDescriptorSet descriptorSet = m_generalDescriptorSets[m_currentFrame]->getDescriptorSet();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_offscreenGridPipeline->getPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr);
+
+    VkDescriptorSet textureSet = m_materialDescriptorSets[m_currentFrame]->getDescriptorSet();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_offscreenGridPipeline->getPipelineLayout(), 1, 1, &textureSet, 0, nullptr);
+
+    VkDescriptorSet gridSet = scene->getGridRenderDescriptorSet(viewGrid, m_currentFrame)->getDescriptorSet();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_offscreenGridPipeline->getPipelineLayout(), 2, 1, &gridSet, 0, nullptr);
+
+    scene->drawGrid(viewGrid, commandBuffer, m_currentFrame);
+}
+
 void Renderer::recordComputeCommandBuffer(VkCommandBuffer commandBuffer, const std::shared_ptr<Scene>& scene,
     const std::shared_ptr<View>& view)
 {
@@ -1558,22 +2418,38 @@ void Renderer::recordComputeCommandBuffer(VkCommandBuffer commandBuffer, const s
     scene->dispatch(view, commandBuffer, m_cullPipeline->getPipelineLayout(), m_currentFrame);
 }
 
+void Renderer::recordBatchedComputeCommandBuffer(VkCommandBuffer commandBuffer, const std::shared_ptr<Scene>& scene,
+    const std::shared_ptr<ViewGrid>& viewGrid)
+{
+    VkDescriptorSet computeSet = m_computeDescriptorSets[m_currentFrame]->getDescriptorSet();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullBatchedPipeline->getPipelineLayout(), 0, 1,
+        &computeSet, 0, nullptr);
+
+    m_cullBatchedPipeline->bind(commandBuffer);
+
+    scene->dispatchBatched(viewGrid, commandBuffer, m_cullBatchedPipeline->getPipelineLayout(), m_currentFrame);
+}
+
 void Renderer::updateDescriptorData(const std::shared_ptr<Scene>& scene, const std::vector<std::shared_ptr<View>>& views,
     const std::vector<std::shared_ptr<View>>& viewMatrix)
 {
-    if (scene->lightChanged())
+    TRACE_ZONE("Descriptor data");
+
+    collectSceneChanges(scene);
+
+    // called more than once per frame when the view matrix is updated, the slot is written only once
+    uint32_t slotBit = 1u << m_currentFrame;
+
+    if (m_lightDirtySlots & slotBit)
     {
         UniformDataFragment fubo{};
         fubo.lightPos = scene->getLightPos();
         m_fubos[m_currentFrame]->copyMapped(&fubo, sizeof(UniformDataFragment));
 
-        m_lightsFramesUpdated++;
-
-        if (m_lightsFramesUpdated == MAX_FRAMES_IN_FLIGHT)
-            scene->setLightChanged(false);
+        m_lightDirtySlots &= ~slotBit;
     }
 
-    if (scene->sceneChanged())
+    if (m_sceneDirtySlots & slotBit)
     {
         std::vector<MeshShaderDataVertex> vssboData;
         std::vector<MeshShaderDataFragment> fssboData;
@@ -1597,16 +2473,17 @@ void Renderer::updateDescriptorData(const std::shared_ptr<Scene>& scene, const s
         m_vssbos[m_currentFrame]->copyMapped(vssboData.data(), sizeof(MeshShaderDataVertex) * vssboData.size());
         m_fssbos[m_currentFrame]->copyMapped(fssboData.data(), sizeof(MeshShaderDataFragment) * fssboData.size());
 
-        m_sceneFramesUpdated++;
-
-        if (m_sceneFramesUpdated == MAX_FRAMES_IN_FLIGHT)
-            scene->setSceneChanged(false);
+        m_sceneDirtySlots &= ~slotBit;
     }
 }
 
 void Renderer::updateCullComputeDescriptorData(const std::shared_ptr<Scene> &scene)
 {
-    if (scene->sceneChanged())
+    collectSceneChanges(scene);
+
+    uint32_t slotBit = 1u << m_currentFrame;
+
+    if (m_cullDirtySlots & slotBit)
     {
         std::vector<MeshShaderDataCompute> cssboData;
 
@@ -1619,14 +2496,58 @@ void Renderer::updateCullComputeDescriptorData(const std::shared_ptr<Scene> &sce
             model->updateComputeDescriptorData(cssboData, true);
 
         m_cssbos[m_currentFrame]->copyMapped(cssboData.data(), sizeof(MeshShaderDataCompute) * cssboData.size());
+
+        m_cullDirtySlots &= ~slotBit;
+    }
+
+    // the tree only changes with the geometry, camera movement keeps the uploaded one
+    scene->updateBvh();
+
+    if (m_bvhVersions[m_currentFrame] != scene->getBvhVersion())
+    {
+        const MeshBvh& bvh = scene->getBvh();
+
+        const std::vector<BvhNodeCompute>& nodes = bvh.getNodes();
+        const std::vector<uint32_t>& tasks = bvh.getTasks();
+        const std::vector<uint32_t>& primitives = bvh.getPrimitives();
+
+        BvhHeaderCompute* header = static_cast<BvhHeaderCompute*>(m_bvhssbos[m_currentFrame]->getMapped());
+        header->nodeCount = static_cast<uint32_t>(nodes.size());
+        header->taskCount = static_cast<uint32_t>(tasks.size());
+        std::copy(tasks.begin(), tasks.end(), header->tasks);
+        std::copy(nodes.begin(), nodes.end(), reinterpret_cast<BvhNodeCompute*>(header + 1));
+
+        m_bvhPrimitiveSsbos[m_currentFrame]->copyMapped((void*)primitives.data(), sizeof(uint32_t) * primitives.size());
+
+        m_bvhVersions[m_currentFrame] = scene->getBvhVersion();
+    }
+}
+
+void Renderer::collectSceneChanges(const std::shared_ptr<Scene>& scene)
+{
+    const uint32_t allSlots = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+
+    if (scene->sceneChanged())
+    {
+        m_sceneDirtySlots = allSlots;
+        m_cullDirtySlots = allSlots;
+        scene->setSceneChanged(false);
+    }
+
+    if (scene->lightChanged())
+    {
+        m_lightDirtySlots = allSlots;
+        scene->setLightChanged(false);
     }
 }
 
 void Renderer::updateRayEvalComputeDescriptorData(const std::vector<std::shared_ptr<View>>& novelViews,
         const std::vector<std::shared_ptr<View>>& views, const RayEvalParams& params)
 {
+    TRACE_ZONE("Ray eval descriptor data");
+
     std::shared_ptr<Camera> mainCamera = novelViews[0]->getCamera();
-    glm::vec2 res = m_novelImage->getDims();
+    glm::vec2 res = m_novelImages[0]->getDims();
     VkExtent2D offscreenFbRes = m_viewMatrixFramebuffer->getResolution();
 
     RayEvalUniformBuffer creuData{};
@@ -1641,11 +2562,53 @@ void Renderer::updateRayEvalComputeDescriptorData(const std::vector<std::shared_
     creuData.numOfRaySamples = params.numOfRaySamples;
     creuData.automaticSampleCount = params.automaticSampleCount;
     creuData.maxViewsUsed = params.maxViewsUsed;
+    creuData.hierarchicalSampling = params.hierarchicalSampling;
+    creuData.emptySpaceSkipping = params.emptySpaceSkipping;
+    creuData.temporalReuse = params.temporalReuse;
+    creuData.variableRate = params.variableRate;
+    creuData.rateThreshold = (1.f - glm::clamp(params.quality, 0.f, 1.f)) * VARIABLE_RATE_MAX_VARIANCE;
+
+    // the variable rate decides from the history of the previous frame as well
+    if (params.temporalReuse || params.variableRate)
+    {
+        // the history only holds for the same evaluation of the same views
+        const RayEvalParams& prev = m_prevRayEvalParams;
+        bool sameEvaluation = (prev.temporalReuse || prev.variableRate) && prev.numOfRaySamples == params.numOfRaySamples &&
+            prev.automaticSampleCount == params.automaticSampleCount && prev.maxViewsUsed == params.maxViewsUsed &&
+            prev.hierarchicalSampling == params.hierarchicalSampling &&
+            prev.emptySpaceSkipping == params.emptySpaceSkipping;
+
+        glm::uvec2 tileCount = getRayEvalTileCount();
+        glm::uvec2 historyRes = tileCount * static_cast<uint32_t>(RAY_EVAL_TILE_SIZE);
+        uint32_t historySize = historyRes.x * historyRes.y;
+
+        creuData.viewProj = mainCamera->getProjection() * mainCamera->getView();
+        creuData.prevInvView = m_prevNovelInvView;
+        creuData.prevInvProj = m_prevNovelInvProj;
+        creuData.historyRes = historyRes;
+        creuData.historyRead = (m_temporalFrame % 2) * historySize;
+        creuData.historyWrite = ((m_temporalFrame + 1) % 2) * historySize;
+        creuData.frameIndex = m_temporalFrame;
+        creuData.historyValid = m_temporalHistoryValid && sameEvaluation;
+
+        m_prevNovelInvView = creuData.invView;
+        m_prevNovelInvProj = creuData.invProj;
+        m_temporalHistoryValid = true;
+        m_temporalFrame++;
+    }
+    else
+    {
+        m_temporalHistoryValid = false;
+    }
+
+    m_prevRayEvalParams = params;
 
     m_creubo[m_currentFrame]->copyMapped(&creuData, sizeof(RayEvalUniformBuffer));
 
     std::vector<ViewEvalDataCompute> cressbo(views.size());
+    ViewEvalTableCompute viewTable{};
 
+    uint32_t depthPyramidOffset = 0;
     for (int i = 0; i < views.size(); i++)
     {
         std::vector<glm::vec4> planes = views[i]->getCamera()->getFrustumPlanes();
@@ -1662,11 +2625,22 @@ void Renderer::updateRayEvalComputeDescriptorData(const std::vector<std::shared_
         cressbo[i].resOffset.z = offset.x;
         cressbo[i].resOffset.w = offset.y;
         cressbo[i].nearFar = views[i]->getNearFar();
+        cressbo[i].depthPyramidOffset = depthPyramidOffset;
+        depthPyramidOffset += getDepthPyramidSize(res);
         glm::vec3 viewDir = views[i]->getCamera()->getTransfViewDir();
         cressbo[i].viewDir = glm::vec4(viewDir.x, viewDir.y, viewDir.z, 0.f);
+
+        // NDC to the atlas uv of the view tile in one multiply-add
+        glm::vec2 uvScale = res / (2.f * creuData.viewsTotalRes);
+        glm::vec2 uvBias = (res / 2.f + offset) / creuData.viewsTotalRes;
+
+        viewTable.viewProj[i] = cressbo[i].proj * cressbo[i].view;
+        viewTable.invViewProj[i] = cressbo[i].invView * cressbo[i].invProj;
+        viewTable.uvScaleBias[i] = glm::vec4(uvScale, uvBias);
     }
 
     m_cressbo[m_currentFrame]->copyMapped(cressbo.data(), sizeof(ViewEvalDataCompute) * cressbo.size());
+    m_viewTableSsbos[m_currentFrame]->copyMapped(&viewTable, sizeof(ViewEvalTableCompute));
 
 }
 
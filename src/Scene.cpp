@@ -13,11 +13,16 @@
 #include "Buffer.h"
 #include "Camera.h"
 #include "View.h"
+#include "GeometryArena.h"
 #include "descriptors/SetLayout.h"
 #include "descriptors/Set.h"
 #include "descriptors/Pool.h"
 #include "utils/Structs.h"
 #include "utils/Constants.h"
+#include "utils/Math.h"
+
+#include <algorithm>
+#include <stdexcept>
 
 namespace vke
 {
@@ -25,6 +30,9 @@ namespace vke
 Scene::Scene()
     : m_drawCount(0),
     m_sceneChanged(true),
+    m_version(0),
+    m_bvhDirty(true),
+    m_bvhVersion(0),
     m_lightChanged(true),
     m_renderDebugCameraGeometry(false),
     m_reinitializeDebugCameraGeometry(true),
@@ -47,22 +55,48 @@ void Scene::destroyVkResources()
         for (auto& buff : kv.second)
             buff->destroyVkResources();
     }
+
+    m_gridDrawTemplateBuffer->destroyVkResources();
+
+    for (auto& kv : m_gridCullMap)
+    {
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            kv.second.cullBuffers[i]->destroyVkResources();
+            kv.second.drawBuffers[i]->destroyVkResources();
+            kv.second.instanceBuffers[i]->destroyVkResources();
+            kv.second.viewBuffers[i]->destroyVkResources();
+        }
+    }
 }
 
 void Scene::setModels(const std::shared_ptr<Device>& device, std::shared_ptr<DescriptorSetLayout> descriptorSetLayout,
     std::shared_ptr<DescriptorPool> descriptorPool, std::vector<std::shared_ptr<Model>> models,
-    const std::vector<Vertex>& vertices, const std::vector<uint32_t> indices)
+    const GeometryArena& geometry)
 {
+    if (geometry.isReleased())
+    {
+        throw std::runtime_error("Error: scene geometry was already released.");
+    }
+
     m_models = models;
 
-    createVertexBuffer(device, vertices);
-    createIndexBuffer(device, indices);
+    createVertexBuffer(device, geometry);
+    createIndexBuffer(device, geometry);
     createIndirectDrawBuffer(device);
+
+    m_bvhDirty = true;
+    updateBvh();
+
+    m_version++;
 }
 
 void Scene::setLightChanged(bool lightChanged)
 {
     m_lightChanged = lightChanged;
+
+    if (lightChanged)
+        m_version++;
 }
 
 void Scene::setSceneChanged(bool sceneChanged)
@@ -95,21 +129,146 @@ bool Scene::sceneChanged() const
     return m_sceneChanged;
 }
 
+uint32_t Scene::getVersion() const
+{
+    return m_version;
+}
+
+uint32_t Scene::getBvhVersion() const
+{
+    return m_bvhVersion;
+}
+
 bool Scene::viewResourcesExist(std::shared_ptr<View> view)
 {
     return m_computeDescriptorsMap.find(view) != m_computeDescriptorsMap.end();
 }
 
+void Scene::updateBvh()
+{
+    if (!m_bvhDirty)
+    {
+        return;
+    }
+
+    // same order as the draws and the cull shader data
+    std::vector<MeshShaderDataCompute> computeData;
+
+    for (auto& model : m_models)
+        model->updateComputeDescriptorData(computeData);
+
+    for (auto& model : m_models)
+        model->updateComputeDescriptorData(computeData, true);
+
+    std::vector<glm::vec4> spheres(computeData.size());
+    for (size_t i = 0; i < computeData.size(); i++)
+    {
+        spheres[i] = computeData[i].boundingSphere;
+    }
+
+    m_bvh.build(spheres);
+    m_bvhDirty = false;
+    m_bvhVersion++;
+}
+
+const MeshBvh& Scene::getBvh() const
+{
+    return m_bvh;
+}
+
+void Scene::checkMeshesVisible(std::shared_ptr<Camera> camera, VkDrawIndexedIndirectCommand* commands) const
+{
+    std::vector<uint32_t> visible;
+    m_bvh.cull(camera->getFrustumPlanes(), visible);
+
+    // the GPU culling may have cleared the commands of the previous frames, they are restored from the template
+    const VkDrawIndexedIndirectCommand* templateCommands = (const VkDrawIndexedIndirectCommand*)m_indirectDrawBuffer->getMapped();
+
+    for (uint32_t i = 0; i < m_drawCount; i++)
+    {
+        commands[i] = templateCommands[i];
+        commands[i].instanceCount = 0;
+    }
+
+    for (auto drawId : visible)
+    {
+        commands[drawId].instanceCount = (commands[drawId].indexCount != 0) ? 1 : 0;
+    }
+}
+
 void Scene::dispatch(std::shared_ptr<View> view, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
     uint32_t currentFrame)
 {
     // VkDescriptorSet computeSet = m_computeDescriptorSets[currentFrame]->getDescriptorSet();
     // vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &computeSet, 0, nullptr);
     
+    clearViewDraws(commandBuffer, { view }, currentFrame);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+        0, nullptr, 0, nullptr);
+
     VkDescriptorSet computeSet = m_computeDescriptorsMap[view][currentFrame]->getDescriptorSet();
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &computeSet, 0, nullptr);
 
-    vkCmdDispatch(commandBuffer, 256, 1, 1);
+    // one invocation per BVH task subtree
+    uint32_t taskCount = static_cast<uint32_t>(m_bvh.getTasks().size());
+    vkCmdDispatch(commandBuffer, (taskCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+}
+
+void Scene::dispatchBatched(std::shared_ptr<ViewGrid> grid, VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+    uint32_t currentFrame)
+{
+    GridCullResources& resources = m_gridCullMap[grid];
+
+    // the culling counts the visible views into the instance counts of the grid draw stream
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(VkDrawIndexedIndirectCommand) * m_drawCount;
+
+    if (copyRegion.size > 0)
+    {
+        vkCmdCopyBuffer(commandBuffer, m_gridDrawTemplateBuffer->getVkBuffer(), resources.drawBuffers[currentFrame]->getVkBuffer(),
+            1, &copyRegion);
+    }
+
+    clearViewDraws(commandBuffer, resources.boundViews[currentFrame], currentFrame);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+        0, nullptr, 0, nullptr);
+
+    VkDescriptorSet computeSet = resources.descriptorSets[currentFrame]->getDescriptorSet();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &computeSet, 0, nullptr);
+
+    uint32_t viewCount = static_cast<uint32_t>(resources.boundViews[currentFrame].size());
+
+    uint32_t taskCount = static_cast<uint32_t>(m_bvh.getTasks().size());
+    vkCmdDispatch(commandBuffer, (taskCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, viewCount, 1);
+}
+
+void Scene::clearViewDraws(VkCommandBuffer commandBuffer, const std::vector<std::shared_ptr<View>>& views,
+    uint32_t currentFrame)
+{
+    // only the mesh draws are culled, the debug camera draws behind them are kept
+    VkDeviceSize size = sizeof(VkDrawIndexedIndirectCommand) * m_drawCount;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    for (auto& view : views)
+    {
+        vkCmdFillBuffer(commandBuffer, m_indirectBuffersMap[view][currentFrame]->getVkBuffer(), 0, size, 0);
+    }
 }
 
 void Scene::draw(std::shared_ptr<View> view, VkCommandBuffer commandBuffer,
@@ -131,6 +290,19 @@ void Scene::draw(std::shared_ptr<View> view, VkCommandBuffer commandBuffer,
         sizeof(VkDrawIndexedIndirectCommand));
 }
 
+void Scene::drawGrid(std::shared_ptr<ViewGrid> grid, VkCommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    VkBuffer vertexBuffers[] = { m_vertexBuffer->getVkBuffer() };
+    VkDeviceSize offsets[] = { 0 };
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getVkBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+    vkCmdDrawIndexedIndirect(commandBuffer, m_gridCullMap[grid].drawBuffers[currentFrame]->getVkBuffer(), 0, m_drawCount,
+        sizeof(VkDrawIndexedIndirectCommand));
+}
+
 void Scene::createViewResources(std::shared_ptr<View> view, const std::shared_ptr<Device>& device,
         std::shared_ptr<DescriptorSetLayout> descriptorSetLayout, std::shared_ptr<DescriptorPool> descriptorPool)
 {
@@ -154,11 +326,13 @@ void Scene::createViewResources(std::shared_ptr<View> view, const std::shared_pt
         descriptorArray[i] = std::make_shared<DescriptorSet>(device, descriptorSetLayout, descriptorPool);
 
         std::vector<VkDescriptorBufferInfo> bufferInfos = {
-            drawBufferArray[i]->getInfo()
+            drawBufferArray[i]->getInfo(),
+            m_indirectDrawBuffer->getInfo()
         };
 
         std::vector<uint32_t> bufferBinding = {
-            0
+            0,
+            1
         };
 
 
@@ -169,6 +343,164 @@ void Scene::createViewResources(std::shared_ptr<View> view, const std::shared_pt
     m_indirectBuffersMap[view] = drawBufferArray;
 }
 
+void Scene::destroyViewResources(std::shared_ptr<View> view)
+{
+    auto it = m_indirectBuffersMap.find(view);
+    if (it == m_indirectBuffersMap.end())
+    {
+        return;
+    }
+
+    for (auto& buff : it->second)
+        buff->destroyVkResources();
+
+    // the pool does not free single sets, they are reclaimed with it
+    m_indirectBuffersMap.erase(it);
+    m_computeDescriptorsMap.erase(view);
+}
+
+void Scene::createGridResources(std::shared_ptr<ViewGrid> grid, const std::shared_ptr<Device>& device,
+    std::shared_ptr<DescriptorSetLayout> descriptorSetLayout, std::shared_ptr<DescriptorPool> descriptorPool,
+    std::shared_ptr<DescriptorSetLayout> renderSetLayout, std::shared_ptr<DescriptorPool> renderPool)
+{
+    if (m_gridCullMap.find(grid) != m_gridCullMap.end())
+    {
+        return;
+    }
+
+    GridCullResources resources;
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        resources.cullBuffers[i] = std::make_shared<Buffer>(device, sizeof(GridCullDataCompute),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        resources.cullBuffers[i]->map();
+
+        VkDeviceSize drawCount = std::max(m_drawCount, 1u);
+
+        resources.drawBuffers[i] = std::make_shared<Buffer>(device, sizeof(VkDrawIndexedIndirectCommand) * drawCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        resources.instanceBuffers[i] = std::make_shared<Buffer>(device, sizeof(uint32_t) * drawCount * MAX_VIEWS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        resources.viewBuffers[i] = std::make_shared<Buffer>(device, sizeof(GridViewDataVertex) * MAX_VIEWS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        resources.viewBuffers[i]->map();
+
+        resources.descriptorSets[i] = std::make_shared<DescriptorSet>(device, descriptorSetLayout, descriptorPool);
+
+        std::vector<VkDescriptorBufferInfo> bufferInfos = {
+            resources.cullBuffers[i]->getInfo(),
+            resources.drawBuffers[i]->getInfo(),
+            resources.instanceBuffers[i]->getInfo(),
+            m_indirectDrawBuffer->getInfo()
+        };
+
+        std::vector<uint32_t> bufferBinding = {
+            1,
+            2,
+            3,
+            4
+        };
+
+        resources.descriptorSets[i]->updateBuffers(bufferBinding, bufferInfos);
+
+        resources.renderDescriptorSets[i] = std::make_shared<DescriptorSet>(device, renderSetLayout, renderPool);
+
+        std::vector<VkDescriptorBufferInfo> renderBufferInfos = {
+            resources.viewBuffers[i]->getInfo(),
+            resources.instanceBuffers[i]->getInfo()
+        };
+
+        std::vector<uint32_t> renderBufferBinding = {
+            0,
+            1
+        };
+
+        resources.renderDescriptorSets[i]->updateBuffers(renderBufferBinding, renderBufferInfos);
+    }
+
+    m_gridCullMap[grid] = resources;
+}
+
+bool Scene::gridResourcesExist(std::shared_ptr<ViewGrid> grid)
+{
+    return m_gridCullMap.find(grid) != m_gridCullMap.end();
+}
+
+void Scene::updateGridResources(std::shared_ptr<ViewGrid> grid, const std::vector<std::shared_ptr<View>>& views,
+    uint32_t currentFrame)
+{
+    if (views.size() > MAX_VIEWS)
+    {
+        throw std::runtime_error("Error: too many views for batched culling.");
+    }
+
+    GridCullResources& resources = m_gridCullMap[grid];
+
+    // rebind the draw buffers only when the views change, unused slots repeat the first view
+    if (resources.boundViews[currentFrame] != views && !views.empty())
+    {
+        for (uint32_t i = 0; i < MAX_VIEWS; i++)
+        {
+            const std::shared_ptr<View>& view = views[i < views.size() ? i : 0];
+
+            std::vector<VkDescriptorBufferInfo> bufferInfos = {
+                m_indirectBuffersMap[view][currentFrame]->getInfo()
+            };
+
+            std::vector<uint32_t> bufferBinding = {
+                0
+            };
+
+            resources.descriptorSets[currentFrame]->updateBuffers(bufferBinding, bufferInfos, i);
+        }
+
+        resources.boundViews[currentFrame] = views;
+    }
+
+    GridCullDataCompute* data = static_cast<GridCullDataCompute*>(resources.cullBuffers[currentFrame]->getMapped());
+    data->totalMeshes = m_drawCount;
+    data->viewCount = static_cast<uint32_t>(views.size());
+
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        std::vector<glm::vec4> frustumPlanes = views[i]->getCamera()->getFrustumPlanes();
+        for (size_t j = 0; j < frustumPlanes.size(); j++)
+        {
+            data->views[i].frustumPlanes[j] = frustumPlanes[j];
+        }
+
+        data->views[i].frustumCull = views[i]->getFrustumCull();
+    }
+}
+
+void Scene::updateGridRenderData(std::shared_ptr<ViewGrid> grid, const std::vector<std::shared_ptr<View>>& views,
+    uint32_t currentFrame, glm::vec2 framebufferResolution)
+{
+    GridViewDataVertex* data = static_cast<GridViewDataVertex*>(m_gridCullMap[grid].viewBuffers[currentFrame]->getMapped());
+
+    for (size_t i = 0; i < views.size() && i < MAX_VIEWS; i++)
+    {
+        std::shared_ptr<Camera> camera = views[i]->getCamera();
+
+        glm::vec2 scale = views[i]->getResolution() / framebufferResolution;
+        glm::vec2 offset = (2.f * views[i]->getViewportStart() + views[i]->getResolution()) / framebufferResolution - 1.f;
+
+        data[i].view = camera->getView();
+        data[i].proj = camera->getProjection();
+        data[i].viewport = glm::vec4(scale, offset);
+        data[i].depthOnly = views[i]->getDepthOnly();
+    }
+}
+
+std::shared_ptr<DescriptorSet> Scene::getGridRenderDescriptorSet(std::shared_ptr<ViewGrid> grid, uint32_t currentFrame)
+{
+    return m_gridCullMap[grid].renderDescriptorSets[currentFrame];
+}
+
 void Scene::setLightPos(const glm::vec3& lightPos)
 {
     m_lightPos = lightPos;
@@ -211,11 +543,17 @@ void Scene::hideModel(std::shared_ptr<Model> model)
             std::vector<VkDrawIndexedIndirectCommand> t(commands2, commands2 + 1);
         }
     }
+
+    m_bvhDirty = true;
+
+    updateGridDrawTemplate();
 }
 
 void Scene::addDebugCameraGeometry(std::vector<std::shared_ptr<View>> views)
 {
     m_renderDebugCameraGeometry = true;
+    m_bvhDirty = true;
+    m_version++;
     if(!m_reinitializeDebugCameraGeometry)
         return;
 
@@ -265,6 +603,8 @@ void Scene::addDebugCameraGeometry(std::vector<std::shared_ptr<View>> views)
 void Scene::setRenderDebugGeometryFlag(bool renderDebugCameraGeometryFlag)
 {
     m_renderDebugCameraGeometry = renderDebugCameraGeometryFlag;
+    m_bvhDirty = true;
+    m_version++;
 }
 
 bool Scene::getRenderDebugGeometryFlag() const
@@ -277,15 +617,37 @@ void Scene::setReinitializeDebugCameraGeometryFlag(bool reinitializeDebugCameraG
     m_reinitializeDebugCameraGeometry = reinitializeDebugCameraGeometry;
 }
 
-void Scene::createVertexBuffer(const std::shared_ptr<Device>& device,
-    const std::vector<Vertex>& vertices)
+void Scene::createVertexBuffer(const std::shared_ptr<Device>& device, const GeometryArena& geometry)
 {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    VkDeviceSize bufferSize = Vertex::getBindingDescription().stride * VkDeviceSize(geometry.getVertexCount());
 
     Buffer stagingBuffer(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     stagingBuffer.map();
-    stagingBuffer.copyMapped((void*)vertices.data(), (size_t)bufferSize);
+
+#if PACKED_VERTICES
+    // every mesh owns its vertex range, pack them one by one so that each gets its own quantization
+    PackedVertex* packed = static_cast<PackedVertex*>(stagingBuffer.getMapped());
+    for (auto& model : m_models)
+    {
+        std::vector<std::shared_ptr<Mesh>> meshes = model->getMeshes();
+        std::vector<std::shared_ptr<Mesh>> transparentMeshes = model->getTransparentMeshes();
+        meshes.insert(meshes.end(), transparentMeshes.begin(), transparentMeshes.end());
+
+        for (auto& mesh : meshes)
+        {
+            const Mesh::MeshInfo& info = mesh->getMeshInfo();
+
+            glm::vec3 positionOffset, positionScale;
+            utils::packVertices(geometry.getVertices(info.vertexOffset), info.vertexCount,
+                packed + info.vertexOffset, positionOffset, positionScale);
+            mesh->setPositionQuantization(positionOffset, positionScale);
+        }
+    }
+#else
+    geometry.copyVertices(static_cast<Vertex*>(stagingBuffer.getMapped()));
+#endif
+
     stagingBuffer.unmap();
 
     m_vertexBuffer = std::make_shared<Buffer>(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
@@ -294,15 +656,14 @@ void Scene::createVertexBuffer(const std::shared_ptr<Device>& device,
     device->copyBuffer(stagingBuffer.getVkBuffer(), m_vertexBuffer->getVkBuffer(), m_vertexBuffer->getSize());
 }
 
-void Scene::createIndexBuffer(const std::shared_ptr<Device>& device,
-    const std::vector<uint32_t> indices)
+void Scene::createIndexBuffer(const std::shared_ptr<Device>& device, const GeometryArena& geometry)
 {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+    VkDeviceSize bufferSize = sizeof(uint32_t) * geometry.getIndexCount();
 
     Buffer stagingBuffer(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     stagingBuffer.map();
-    stagingBuffer.copyMapped((void*)indices.data(), (size_t)bufferSize);
+    geometry.copyIndices(static_cast<uint32_t*>(stagingBuffer.getMapped()));
     stagingBuffer.unmap();
     
     m_indexBuffer = std::make_shared<Buffer>(device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
@@ -343,11 +704,32 @@ void Scene::createIndirectDrawBuffer(const std::shared_ptr<Device>& device)
     stagingBuffer.copyMapped((void*)commands.data(), (size_t)bufferSize);
     stagingBuffer.unmap();
 
+    // also read by the culling as the template of the visible draws
     m_indirectDrawBuffer = std::make_shared<Buffer>(device, bufferSize + MAX_VIEWS, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     m_indirectDrawBuffer->map();
 
     device->copyBuffer(stagingBuffer.getVkBuffer(), m_indirectDrawBuffer->getVkBuffer(), stagingBuffer.getSize());
+
+    m_gridDrawTemplateBuffer = std::make_shared<Buffer>(device, std::max(bufferSize, (VkDeviceSize)sizeof(VkDrawIndexedIndirectCommand)),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_gridDrawTemplateBuffer->map();
+
+    updateGridDrawTemplate();
+}
+
+void Scene::updateGridDrawTemplate()
+{
+    const VkDrawIndexedIndirectCommand* commands = (const VkDrawIndexedIndirectCommand*)m_indirectDrawBuffer->getMapped();
+    VkDrawIndexedIndirectCommand* gridCommands = (VkDrawIndexedIndirectCommand*)m_gridDrawTemplateBuffer->getMapped();
+
+    // instances of draw i are at [i * MAX_VIEWS, i * MAX_VIEWS + visible views) of the grid instance buffer
+    for (uint32_t i = 0; i < m_drawCount; i++)
+    {
+        gridCommands[i] = commands[i];
+        gridCommands[i].instanceCount = 0;
+        gridCommands[i].firstInstance = i * MAX_VIEWS;
+    }
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,599 @@
+/**
+ * @file SceneCache.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "SceneCache.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "utils/Import.h"
+#include "utils/Structs.h"
+#include "utils/Constants.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr char CACHE_MAGIC[8] = { 'V', 'K', 'E', 'S', 'C', 'E', 'N', 'E' };
+constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+constexpr uint64_t MISSING_FILE_SIZE = UINT64_MAX;
+
+void getSourceStamp(const std::string& modelFile, uint64_t& size, int64_t& time)
+{
+    size = static_cast<uint64_t>(fs::file_size(modelFile));
+    time = static_cast<int64_t>(fs::last_write_time(modelFile).time_since_epoch().count());
+}
+
+/**
+ * @brief Like getSourceStamp, a file which does not exist gets the missing size, so that
+ * the cache is outdated once it appears.
+ */
+void getFileStamp(const std::string& file, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    if (!fs::is_regular_file(file, error))
+    {
+        size = MISSING_FILE_SIZE;
+        time = 0;
+        return;
+    }
+
+    getSourceStamp(file, size, time);
+}
+
+std::string resolvePath(const std::string& path, const std::string& directory)
+{
+    if (fs::path(path).is_absolute())
+    {
+        return path;
+    }
+
+    return directory + "/" + path;
+}
+
+/**
+ * @brief Stores the file path relative to the model directory when possible, so that
+ * the cache stays usable after the repository is moved.
+ */
+void addString(std::string path, const std::string& directory, std::string& strings,
+    uint32_t& offset, uint32_t& size)
+{
+    std::string prefix = directory + "/";
+    if (path.compare(0, prefix.size(), prefix) == 0)
+    {
+        path = path.substr(prefix.size());
+    }
+
+    offset = static_cast<uint32_t>(strings.size());
+    size = static_cast<uint32_t>(path.size());
+    strings += path;
+}
+
+}
+
+namespace vke
+{
+
+SceneCache::SceneCache(const std::string& cacheFile, const std::string& directory)
+    : m_data(nullptr), m_size(0), m_directory(directory), m_mapping(nullptr), m_file(-1)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(cacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Failed to open scene cache: " + cacheFile);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map scene cache: " + cacheFile);
+    }
+
+    m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map scene cache: " + cacheFile);
+    }
+
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    m_mapping = mapping;
+    m_file = reinterpret_cast<intptr_t>(file);
+#else
+    int file = open(cacheFile.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw std::runtime_error("Failed to open scene cache: " + cacheFile);
+    }
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(file);
+        throw std::runtime_error("Failed to open scene cache: " + cacheFile);
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to map scene cache: " + cacheFile);
+    }
+
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<size_t>(fileStat.st_size);
+    m_mapping = data;
+#endif
+
+    try
+    {
+        validate();
+    }
+    catch (...)
+    {
+        unmap();
+        throw;
+    }
+}
+
+SceneCache::SceneCache(std::vector<char>&& blob, const std::string& directory)
+    : m_blob(std::move(blob)), m_directory(directory), m_mapping(nullptr), m_file(-1)
+{
+    m_data = m_blob.data();
+    m_size = m_blob.size();
+
+    validate();
+}
+
+SceneCache::~SceneCache()
+{
+    unmap();
+}
+
+void SceneCache::unmap()
+{
+    if (m_mapping == nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+    CloseHandle(reinterpret_cast<HANDLE>(m_file));
+#else
+    munmap(m_mapping, m_size);
+#endif
+
+    m_mapping = nullptr;
+    m_data = nullptr;
+}
+
+std::shared_ptr<SceneCache> SceneCache::loadModel(const std::string& filename)
+{
+    std::string modelFile = std::string(MODELS_FILES_LOC) + filename;
+    std::string directory = fs::absolute(fs::path(modelFile).parent_path()).string();
+    std::string cacheFile = getCacheFile(filename);
+
+    if (isValid(cacheFile, modelFile))
+    {
+        try
+        {
+            return std::make_shared<SceneCache>(cacheFile, directory);
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << e.what() << ", importing the model again." << std::endl;
+        }
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<std::string> importedFiles;
+    std::shared_ptr<Model> model = utils::importModel(filename, vertices, indices, &importedFiles);
+
+    std::vector<char> blob = serialize(modelFile, model, vertices, indices, importedFiles);
+
+    // write into a temporary file first so that a killed run never leaves a truncated cache
+    std::error_code error;
+    fs::create_directories(fs::path(cacheFile).parent_path(), error);
+
+    std::string tmpFile = cacheFile + ".tmp";
+    {
+        std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+        out.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+        error = out ? std::error_code() : std::make_error_code(std::errc::io_error);
+    }
+
+    if (!error)
+    {
+        fs::rename(tmpFile, cacheFile, error);
+    }
+
+    if (error)
+    {
+        fs::remove(tmpFile, error);
+        std::cerr << "Failed to write scene cache: " << cacheFile << std::endl;
+    }
+
+    return std::make_shared<SceneCache>(std::move(blob), directory);
+}
+
+std::vector<char> SceneCache::serialize(const std::string& modelFile, const std::shared_ptr<Model>& model,
+    const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+    const std::vector<std::string>& importedFiles)
+{
+    std::string directory = fs::absolute(fs::path(modelFile).parent_path()).string();
+
+    // opaque and transparent meshes keep their relative order, Model::addMesh sorts them
+    // into the same lists again when loading
+    std::vector<std::shared_ptr<Mesh>> meshes = model->getMeshes();
+    std::vector<std::shared_ptr<Mesh>> transparentMeshes = model->getTransparentMeshes();
+    meshes.insert(meshes.end(), transparentMeshes.begin(), transparentMeshes.end());
+
+    std::vector<MeshRecord> records(meshes.size());
+    std::string strings;
+
+    // the model itself is stamped by the header, everything else the import touched is a dependency
+    std::string modelPath = fs::absolute(modelFile).lexically_normal().string();
+    std::vector<std::string> dependencies;
+    auto addDependency = [&](const std::string& file)
+    {
+        std::string path = fs::absolute(file).lexically_normal().string();
+        if (path != modelPath)
+        {
+            dependencies.push_back(path);
+        }
+    };
+
+    for (auto& file : importedFiles)
+    {
+        addDependency(file);
+    }
+
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const std::shared_ptr<Mesh>& mesh = meshes[i];
+        const Mesh::MeshInfo& info = mesh->getMeshInfo();
+        MeshRecord& record = records[i];
+
+        record = {};
+        record.indexCount = info.indexCount;
+        record.firstIndex = info.firstIndex;
+        record.vertexOffset = info.vertexOffset;
+        record.vertexCount = info.vertexCount;
+
+        glm::vec3 center = mesh->getBbCenter();
+        record.boundingSphere[0] = center.x;
+        record.boundingSphere[1] = center.y;
+        record.boundingSphere[2] = center.z;
+        record.boundingSphere[3] = mesh->getBbRadius();
+
+        std::shared_ptr<Material> material = mesh->getMaterial();
+        if (material == nullptr)
+        {
+            continue;
+        }
+
+        record.flags |= HAS_MATERIAL;
+
+        glm::vec3 ambient = material->getAmbientColor();
+        glm::vec3 diffuse = material->getDiffuseColor();
+        glm::vec3 specular = material->getSpecularColor();
+        for (int c = 0; c < 3; c++)
+        {
+            record.ambientColor[c] = ambient[c];
+            record.diffuseColor[c] = diffuse[c];
+            record.specularColor[c] = specular[c];
+        }
+        record.opacity = material->getOpacity();
+
+        if (material->hasTexture())
+        {
+            addDependency(material->getTextureFile());
+
+            record.flags |= HAS_TEXTURE;
+            addString(material->getTextureFile(), directory, strings,
+                record.textureFileOffset, record.textureFileSize);
+        }
+
+        if (material->hasBumpTexture())
+        {
+            addDependency(material->getBumpTextureFile());
+
+            record.flags |= HAS_BUMP_TEXTURE;
+            addString(material->getBumpTextureFile(), directory, strings,
+                record.bumpTextureFileOffset, record.bumpTextureFileSize);
+        }
+    }
+
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+    std::vector<DependencyRecord> dependencyRecords(dependencies.size());
+    for (size_t i = 0; i < dependencies.size(); i++)
+    {
+        DependencyRecord& record = dependencyRecords[i];
+
+        addString(dependencies[i], directory, strings, record.pathOffset, record.pathSize);
+        getFileStamp(dependencies[i], record.size, record.time);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = VERSION;
+    header.vertexStride = sizeof(Vertex);
+    getSourceStamp(modelFile, header.sourceSize, header.sourceTime);
+    header.meshCount = static_cast<uint32_t>(records.size());
+    header.vertexCount = static_cast<uint32_t>(vertices.size());
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+    header.dependencyCount = static_cast<uint32_t>(dependencyRecords.size());
+
+    header.meshesOffset = alignOffset(sizeof(Header));
+    header.verticesOffset = alignOffset(header.meshesOffset + sizeof(MeshRecord) * records.size());
+    header.indicesOffset = alignOffset(header.verticesOffset + sizeof(Vertex) * vertices.size());
+    header.dependenciesOffset = alignOffset(header.indicesOffset + sizeof(uint32_t) * indices.size());
+    header.stringsOffset = alignOffset(header.dependenciesOffset + sizeof(DependencyRecord) * dependencyRecords.size());
+
+    std::vector<char> blob(header.stringsOffset + strings.size(), 0);
+
+    std::memcpy(blob.data(), &header, sizeof(Header));
+    std::memcpy(blob.data() + header.meshesOffset, records.data(), sizeof(MeshRecord) * records.size());
+    std::memcpy(blob.data() + header.verticesOffset, vertices.data(), sizeof(Vertex) * vertices.size());
+    std::memcpy(blob.data() + header.indicesOffset, indices.data(), sizeof(uint32_t) * indices.size());
+    std::memcpy(blob.data() + header.dependenciesOffset, dependencyRecords.data(),
+        sizeof(DependencyRecord) * dependencyRecords.size());
+    std::memcpy(blob.data() + header.stringsOffset, strings.data(), strings.size());
+
+    return blob;
+}
+
+std::string SceneCache::getCacheFile(const std::string& filename)
+{
+    std::string name = filename;
+    std::replace_if(name.begin(), name.end(), [](char c){ return c == '/' || c == '\\' || c == ':'; }, '_');
+
+    return std::string(MODEL_CACHE_FILES_LOC) + name + ".vkecache";
+}
+
+bool SceneCache::isValid(const std::string& cacheFile, const std::string& modelFile)
+{
+    std::ifstream in(cacheFile, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+
+    Header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(Header)))
+    {
+        return false;
+    }
+
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    std::error_code error;
+    if (!fs::exists(modelFile, error))
+    {
+        return false;
+    }
+    getSourceStamp(modelFile, sourceSize, sourceTime);
+
+    bool valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+        header.version == VERSION &&
+        header.vertexStride == sizeof(Vertex) &&
+        header.sourceSize == sourceSize &&
+        header.sourceTime == sourceTime;
+
+    if (!valid)
+    {
+        return false;
+    }
+
+    std::vector<DependencyRecord> dependencies(header.dependencyCount);
+    std::string strings(header.stringsSize, '\0');
+    if (!in.seekg(header.dependenciesOffset) ||
+        !in.read(reinterpret_cast<char*>(dependencies.data()), sizeof(DependencyRecord) * dependencies.size()) ||
+        !in.seekg(header.stringsOffset) ||
+        !in.read(strings.data(), strings.size()))
+    {
+        return false;
+    }
+
+    std::string directory = fs::absolute(fs::path(modelFile).parent_path()).string();
+    for (auto& dependency : dependencies)
+    {
+        if (uint64_t(dependency.pathOffset) + dependency.pathSize > strings.size())
+        {
+            return false;
+        }
+
+        uint64_t size = 0;
+        int64_t time = 0;
+        getFileStamp(resolvePath(strings.substr(dependency.pathOffset, dependency.pathSize), directory), size, time);
+
+        if (size != dependency.size || time != dependency.time)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::shared_ptr<Model> SceneCache::createModel(uint32_t firstVertex, uint32_t firstIndex) const
+{
+    const Header* header = getHeader();
+    const MeshRecord* records = reinterpret_cast<const MeshRecord*>(m_data + header->meshesOffset);
+    std::shared_ptr<Model> model = std::make_shared<Model>();
+
+    for (uint32_t i = 0; i < header->meshCount; i++)
+    {
+        const MeshRecord& record = records[i];
+
+        Mesh::MeshInfo info{};
+        info.indexCount = record.indexCount;
+        info.firstIndex = record.firstIndex + firstIndex;
+        info.vertexOffset = record.vertexOffset + firstVertex;
+        info.vertexCount = record.vertexCount;
+
+        std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(info);
+        mesh->setModelMatrix(glm::mat4(1.f));
+
+        if (record.flags & HAS_MATERIAL)
+        {
+            std::shared_ptr<Material> material = std::make_shared<Material>();
+
+            material->setAmbientColor(glm::vec3(record.ambientColor[0], record.ambientColor[1], record.ambientColor[2]));
+            material->setDiffuseColor(glm::vec3(record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2]));
+            material->setSpecularColor(glm::vec3(record.specularColor[0], record.specularColor[1], record.specularColor[2]));
+            material->setOpacity(record.opacity);
+
+            if (record.flags & HAS_TEXTURE)
+            {
+                material->setTextureFile(getString(record.textureFileOffset, record.textureFileSize));
+            }
+
+            if (record.flags & HAS_BUMP_TEXTURE)
+            {
+                material->setBumpTextureFile(getString(record.bumpTextureFileOffset, record.bumpTextureFileSize));
+            }
+
+            mesh->setMaterial(material);
+        }
+
+        mesh->setBbProperties(glm::vec3(record.boundingSphere[0], record.boundingSphere[1], record.boundingSphere[2]),
+            record.boundingSphere[3]);
+
+        model->addMesh(mesh);
+    }
+
+    return model;
+}
+
+const Vertex* SceneCache::getVertices() const
+{
+    return reinterpret_cast<const Vertex*>(m_data + getHeader()->verticesOffset);
+}
+
+const uint32_t* SceneCache::getIndices() const
+{
+    return reinterpret_cast<const uint32_t*>(m_data + getHeader()->indicesOffset);
+}
+
+uint32_t SceneCache::getVertexCount() const
+{
+    return getHeader()->vertexCount;
+}
+
+uint32_t SceneCache::getIndexCount() const
+{
+    return getHeader()->indexCount;
+}
+
+bool SceneCache::isMapped() const
+{
+    return m_mapping != nullptr;
+}
+
+void SceneCache::validate() const
+{
+    if (m_size < sizeof(Header))
+    {
+        throw std::runtime_error("Scene cache is truncated");
+    }
+
+    const Header* header = getHeader();
+
+    if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != VERSION ||
+        header->vertexStride != sizeof(Vertex))
+    {
+        throw std::runtime_error("Scene cache has incompatible format");
+    }
+
+    bool inBounds =
+        header->meshesOffset + sizeof(MeshRecord) * uint64_t(header->meshCount) <= m_size &&
+        header->verticesOffset + sizeof(Vertex) * uint64_t(header->vertexCount) <= m_size &&
+        header->indicesOffset + sizeof(uint32_t) * uint64_t(header->indexCount) <= m_size &&
+        header->dependenciesOffset + sizeof(DependencyRecord) * uint64_t(header->dependencyCount) <= m_size &&
+        header->stringsOffset + uint64_t(header->stringsSize) <= m_size;
+
+    if (!inBounds)
+    {
+        throw std::runtime_error("Scene cache is truncated");
+    }
+
+    const MeshRecord* records = reinterpret_cast<const MeshRecord*>(m_data + header->meshesOffset);
+    for (uint32_t i = 0; i < header->meshCount; i++)
+    {
+        const MeshRecord& record = records[i];
+
+        bool recordInBounds =
+            uint64_t(record.vertexOffset) + record.vertexCount <= header->vertexCount &&
+            uint64_t(record.firstIndex) + record.indexCount <= header->indexCount &&
+            uint64_t(record.textureFileOffset) + record.textureFileSize <= header->stringsSize &&
+            uint64_t(record.bumpTextureFileOffset) + record.bumpTextureFileSize <= header->stringsSize;
+
+        if (!recordInBounds)
+        {
+            throw std::runtime_error("Scene cache has corrupted mesh records");
+        }
+    }
+}
+
+const SceneCache::Header* SceneCache::getHeader() const
+{
+    return reinterpret_cast<const Header*>(m_data);
+}
+
+std::string SceneCache::getString(uint32_t offset, uint32_t size) const
+{
+    std::string path(m_data + getHeader()->stringsOffset + offset, size);
+
+    if (fs::path(path).is_absolute())
+    {
+        return path;
+    }
+
+    return m_directory + "/" + path;
+}
+
+}
@@ -46,10 +46,6 @@ void SwapChain::destroyVkResources()
     {
         vkDestroySemaphore(m_device->getVkDevice(), m_renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(m_device->getVkDevice(), m_imageAvailableSemaphores[i], nullptr);
-        vkDestroySemaphore(m_device->getVkDevice(), m_computeFinishedSemaphores[i], nullptr);
-
-        vkDestroyFence(m_device->getVkDevice(), m_computeInFlightFences[i], nullptr);
-        vkDestroyFence(m_device->getVkDevice(), m_inFlightFences[i], nullptr);
     }
 }
 
@@ -139,43 +135,20 @@ void SwapChain::createSyncObjects()
 {
     m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-
-    m_computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         if (vkCreateSemaphore(m_device->getVkDevice(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS
-        ||  vkCreateSemaphore(m_device->getVkDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS
-        ||  vkCreateFence(m_device->getVkDevice(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
+        ||  vkCreateSemaphore(m_device->getVkDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create semaphores!");
         }
-
-        if (vkCreateSemaphore(m_device->getVkDevice(), &semaphoreInfo, nullptr, &m_computeFinishedSemaphores[i]) != VK_SUCCESS
-            || vkCreateFence(m_device->getVkDevice(), &fenceInfo, nullptr, &m_computeInFlightFences[i]) != VK_SUCCESS)
-            throw std::runtime_error("failed to create compute semaphores");
     }
 }
 
-VkFence SwapChain::getFenceId(int id)
-{
-    return m_inFlightFences[id];
-}
-
-VkFence SwapChain::getComputeFenceId(int id)
-{
-    return m_computeInFlightFences[id];
-}
-
 VkSwapchainKHR SwapChain::getSwapChain() const
 {
     return m_swapChain;
@@ -191,11 +164,6 @@ VkSemaphore SwapChain::getRenderFinishedSemaphore(int id)
     return m_renderFinishedSemaphores[id];
 }
 
-VkSemaphore SwapChain::getComputeFinishedSemaphore(int id)
-{
-    return m_computeFinishedSemaphores[id];
-}
-
 std::shared_ptr<Framebuffer> SwapChain::getFramebuffer(int id)
 {
     return m_swapChainFramebuffers[id];
@@ -43,6 +43,15 @@ Texture::Texture(std::shared_ptr<Device> device, unsigned char* pixels, glm::vec
         VK_SAMPLER_MIPMAP_MODE_LINEAR);
 }
 
+Texture::Texture(std::shared_ptr<Device> device, std::shared_ptr<Image> image)
+    : m_device(device), m_image(image)
+{
+    m_imageView = m_image->createImageView();
+
+    m_sampler = std::make_shared<Sampler>(m_device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        VK_SAMPLER_MIPMAP_MODE_LINEAR);
+}
+
 Texture::~Texture()
 {
 }
@@ -0,0 +1,280 @@
+/**
+ * @file TextureLoader.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "TextureLoader.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "Renderer.h"
+#include "Buffer.h"
+#include "Image.h"
+#include "Texture.h"
+#include "utils/FileHandling.h"
+#include "utils/Constants.h"
+#include "utils/Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace
+{
+
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+VkDeviceSize alignOffset(VkDeviceSize offset)
+{
+    return (offset + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Single channel bump data from any decoded image.
+ */
+void toOneChannel(const unsigned char* pixels, unsigned char* dst, size_t pixelCount, int channels)
+{
+    if (channels == 1)
+    {
+        std::memcpy(dst, pixels, pixelCount);
+    }
+    else if (channels == 3)
+    {
+        vke::utils::rgbToLuma(pixels, dst, pixelCount);
+    }
+    else
+    {
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            const unsigned char* pixel = pixels + i * channels;
+            dst[i] = (channels == 2) ? pixel[0] : static_cast<unsigned char>((pixel[0] + pixel[1] + pixel[2]) / 3);
+        }
+    }
+}
+
+}
+
+namespace vke
+{
+
+TextureLoader::TextureLoader(std::shared_ptr<Device> device, uint32_t threadCount)
+    : m_device(device), m_threadPool(threadCount)
+{
+}
+
+void TextureLoader::loadTextures(const std::vector<std::shared_ptr<Model>>& models, std::shared_ptr<Renderer> renderer)
+{
+    std::vector<TextureRequest> requests;
+    std::unordered_set<std::string> textureFiles;
+    std::unordered_set<std::string> bumpTextureFiles;
+
+    for (auto& model : models)
+    {
+        std::vector<std::shared_ptr<Mesh>> meshes = model->getMeshes();
+        std::vector<std::shared_ptr<Mesh>> transparentMeshes = model->getTransparentMeshes();
+        meshes.insert(meshes.end(), transparentMeshes.begin(), transparentMeshes.end());
+
+        for (auto& mesh : meshes)
+        {
+            std::shared_ptr<Material> material = mesh->getMaterial();
+            if (material == nullptr)
+            {
+                continue;
+            }
+
+            if (material->hasTexture())
+            {
+                std::string file = material->getTextureFile();
+                if (renderer->getTextureId(file) == RET_ID_NOT_FOUND && textureFiles.insert(file).second)
+                {
+                    requests.push_back({ file, false, 0, 0, VK_FORMAT_R8G8B8A8_SRGB, 0, 0, nullptr });
+                }
+            }
+
+            if (material->hasBumpTexture())
+            {
+                std::string file = material->getBumpTextureFile();
+                if (renderer->getBumpTextureId(file) == RET_ID_NOT_FOUND && bumpTextureFiles.insert(file).second)
+                {
+                    requests.push_back({ file, true, 0, 0, VK_FORMAT_R8_UNORM, 0, 0, nullptr });
+                }
+            }
+        }
+    }
+
+    if (requests.empty())
+    {
+        return;
+    }
+
+    // only the headers are read here to plan the staging memory
+    m_threadPool.run(static_cast<uint32_t>(requests.size()), [&](uint32_t i)
+    {
+        TextureRequest& request = requests[i];
+
+        int channels;
+        if (!utils::getImageInfo(request.filename, request.width, request.height, channels))
+        {
+            throw std::runtime_error("Failed loading image: " + request.filename);
+        }
+
+        request.size = static_cast<VkDeviceSize>(request.width) * request.height * (request.bump ? 1 : 4);
+    });
+
+    VkDeviceSize totalSize = 0;
+    VkDeviceSize maxSize = 0;
+    for (auto& request : requests)
+    {
+        totalSize += alignOffset(request.size);
+        maxSize = std::max(maxSize, request.size);
+    }
+
+    VkDeviceSize stagingSize = std::max(std::min(totalSize, static_cast<VkDeviceSize>(MAX_TEXTURE_STAGING_SIZE)), maxSize);
+
+    Buffer stagingBuffer(m_device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer.map();
+
+    utils::setFlipImagesOnLoad(true);
+
+    // fill the staging buffer with as many images as fit, upload them and reuse it for the rest
+    std::vector<TextureRequest*> batch;
+    VkDeviceSize batchSize = 0;
+
+    auto flushBatch = [&]()
+    {
+        decodeBatch(batch, static_cast<unsigned char*>(stagingBuffer.getMapped()));
+        uploadBatch(batch, stagingBuffer.getVkBuffer());
+
+        batch.clear();
+        batchSize = 0;
+    };
+
+    for (auto& request : requests)
+    {
+        if (!batch.empty() && batchSize + request.size > stagingSize)
+        {
+            flushBatch();
+        }
+
+        request.offset = batchSize;
+        batchSize += alignOffset(request.size);
+        batch.push_back(&request);
+    }
+
+    flushBatch();
+
+    stagingBuffer.unmap();
+
+    for (auto& request : requests)
+    {
+        std::shared_ptr<Texture> texture = std::make_shared<Texture>(m_device, request.image);
+
+        if (request.bump)
+        {
+            renderer->addBumpTexture(texture, request.filename);
+        }
+        else
+        {
+            renderer->addTexture(texture, request.filename);
+        }
+    }
+}
+
+void TextureLoader::decodeBatch(std::vector<TextureRequest*>& requests, unsigned char* staging)
+{
+    TRACE_ZONE("Texture batch");
+
+    m_threadPool.run(static_cast<uint32_t>(requests.size()), [&](uint32_t i)
+    {
+        TRACE_ZONE("Texture decode");
+
+        TextureRequest& request = *requests[i];
+
+        int width, height, channels;
+        unsigned char* pixels = utils::decodeImage(request.filename, width, height, channels);
+
+        if (width != request.width || height != request.height)
+        {
+            utils::freeImage(pixels);
+            throw std::runtime_error("Image changed while loading: " + request.filename);
+        }
+
+        unsigned char* dst = staging + request.offset;
+        size_t pixelCount = static_cast<size_t>(width) * height;
+
+        if (request.bump)
+        {
+            toOneChannel(pixels, dst, pixelCount, channels);
+        }
+        else if (channels == 3)
+        {
+            utils::rgbToRgba(pixels, dst, pixelCount);
+        }
+        else if (channels == 4)
+        {
+            std::memcpy(dst, pixels, pixelCount * 4);
+        }
+        else
+        {
+            utils::freeImage(pixels);
+            throw std::runtime_error("Error: weird number of channels.");
+        }
+
+        utils::freeImage(pixels);
+    });
+}
+
+void TextureLoader::uploadBatch(std::vector<TextureRequest*>& requests, VkBuffer stagingBuffer)
+{
+    for (auto request : requests)
+    {
+        request->image = std::make_shared<Image>(m_device, glm::vec2(request->width, request->height), request->format,
+            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    VkCommandBuffer commandBuffer;
+    m_device->beginSingleCommands(commandBuffer);
+
+    for (auto request : requests)
+    {
+        m_device->createImageBarrier(commandBuffer, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, request->image->getVkImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = request->offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = {
+            static_cast<unsigned int>(request->width),
+            static_cast<unsigned int>(request->height),
+            1
+        };
+
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, request->image->getVkImage(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        m_device->createImageBarrier(commandBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, request->image->getVkImage(),
+            VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        request->image->setVkImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    m_device->endSingleCommands(commandBuffer);
+}
+
+}
\ No newline at end of file
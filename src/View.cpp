@@ -23,7 +23,7 @@ View::View(const glm::vec2& resolution, const glm::vec2& viewportStart, std::sha
     : m_resolution(resolution), m_viewportStart(viewportStart),
     m_camera(std::make_shared<Camera>(m_resolution, glm::vec3(2.f, 10.f, 2.f))),
     m_vubos(MAX_FRAMES_IN_FLIGHT), m_cubos(MAX_FRAMES_IN_FLIGHT), m_fubos(MAX_FRAMES_IN_FLIGHT),
-    m_viewDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_frustumCull(true), m_depthOnly(false)
+    m_viewDescriptorSets(MAX_FRAMES_IN_FLIGHT), m_frustumCull(true), m_depthOnly(false), m_rendered(false)
 {
     createDescriptorResources(device, descriptorSetLayout, descriptorPool);
 }
@@ -32,22 +32,13 @@ View::~View()
 {
 }
 
-void View::destroyVkResources(int currentFrame)
+void View::destroyVkResources()
 {
-    if (currentFrame == -1)
-    {
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-        {
-            m_vubos[i]->destroyVkResources();
-            m_cubos[i]->destroyVkResources();
-            m_fubos[i]->destroyVkResources();
-        }
-    }
-    else
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        m_vubos[currentFrame]->destroyVkResources();
-        m_cubos[currentFrame]->destroyVkResources();
-        m_fubos[currentFrame]->destroyVkResources();
+        m_vubos[i]->destroyVkResources();
+        m_cubos[i]->destroyVkResources();
+        m_fubos[i]->destroyVkResources();
     }
 }
 
@@ -160,6 +151,8 @@ void View::updateDescriptorDataRenderDebugCube(std::vector<MeshShaderDataVertex>
 
         vertexShaderData.push_back(MeshShaderDataVertex());
         vertexShaderData.back().model = matrix;
+        vertexShaderData.back().positionOffset = glm::vec4(meshes[i]->getPositionOffset(), 0.f);
+        vertexShaderData.back().positionScale = glm::vec4(meshes[i]->getPositionScale(), 1.f);
 
         fragmentShaderData.push_back(MeshShaderDataFragment());
         if (material->hasTexture())
@@ -177,6 +170,31 @@ void View::updateDescriptorDataRenderDebugCube(std::vector<MeshShaderDataVertex>
     }
 }
 
+bool View::isDirty() const
+{
+    if (!m_rendered)
+        return true;
+
+    return m_camera->getView() != m_renderedView || m_camera->getProjection() != m_renderedProj
+        || m_resolution != m_renderedResolution || m_viewportStart != m_renderedViewportStart
+        || m_depthOnly != m_renderedDepthOnly;
+}
+
+void View::setRendered()
+{
+    m_rendered = true;
+    m_renderedView = m_camera->getView();
+    m_renderedProj = m_camera->getProjection();
+    m_renderedResolution = m_resolution;
+    m_renderedViewportStart = m_viewportStart;
+    m_renderedDepthOnly = m_depthOnly;
+}
+
+void View::setDirty()
+{
+    m_rendered = false;
+}
+
 void View::setDebugCameraGeometry(std::shared_ptr<Model> model)
 {
     m_debugModel = model;
@@ -10,6 +10,7 @@
 #include "ViewGrid.h"
 
 #include "utils/Constants.h"
+#include "utils/Trace.h"
 
 namespace vke
 {
@@ -44,6 +45,8 @@ void ViewGrid::viewCalculateEye(std::shared_ptr<View> view)
 
 void ViewGrid::reconstructMatrices()
 {
+    TRACE_ZONE("Reconstruct matrices");
+
     calculateGridMatrix();
 
     for (auto& view : m_views)
@@ -132,16 +135,18 @@ void ViewGrid::addColumn()
     m_gridSize.x += 1;
 }
 
-void ViewGrid::removeColumn(int currentFrame, bool resourcesOnly)
+std::vector<std::shared_ptr<View>> ViewGrid::removeColumn()
 {
+    std::vector<std::shared_ptr<View>> removedViews;
+
     if (m_gridSize.x == 1)
-        return;
+        return removedViews;
 
     if (!m_byStep && !m_byInGridPos)
-        return;
+        return removedViews;
 
     if (m_viewRowColumns.size() == 0)
-        return;
+        return removedViews;
     
     int newViewWidth = static_cast<float>(m_resolution.x) / static_cast<float>(m_gridSize.x - 1);
     int viewHeight = static_cast<float>(m_resolution.y) / static_cast<float>(m_gridSize.y);
@@ -153,13 +158,6 @@ void ViewGrid::removeColumn(int currentFrame, bool resourcesOnly)
 
     for (int i = 0; i < m_viewRowColumns.size(); i++)
     {
-        if (resourcesOnly)
-        {
-            viewId = (m_gridSize.x * i) + m_gridSize.x - 1;
-            m_views[viewId]->destroyVkResources(currentFrame);
-            continue;
-        }
-
         viewHeightOffset = viewHeight * i;
         for (int j = 0; j < m_viewRowColumns[i] - 1; j++)
         {
@@ -171,14 +169,15 @@ void ViewGrid::removeColumn(int currentFrame, bool resourcesOnly)
             viewId++;
         }
 
-        m_views[viewId]->destroyVkResources(currentFrame);
+        removedViews.push_back(m_views[viewId]);
 
         m_views.erase(std::next(m_views.begin(), viewId));
         m_viewRowColumns[i] -= 1;
     }
 
-    if (!resourcesOnly)
-        m_gridSize.x -= 1;
+    m_gridSize.x -= 1;
+
+    return removedViews;
 }
 
 void ViewGrid::addRow()
@@ -244,25 +243,19 @@ void ViewGrid::addRow()
     m_viewRowColumns.push_back(columnsCount);
 }
 
-void ViewGrid::removeRow(int currentFrame, bool resourcesOnly)
+std::vector<std::shared_ptr<View>> ViewGrid::removeRow()
 {
     if (m_gridSize.y == 1)
-        return;
+        return {};
 
     if (!m_byStep && !m_byInGridPos)
-        return;
+        return {};
 
     int columnsCount = m_viewRowColumns[m_viewRowColumns.size() - 1];
 
     int firstRowViewId = m_views.size() - columnsCount;
 
-    for (int i = firstRowViewId; i < m_views.size(); i++)
-    {
-        m_views[i]->destroyVkResources(currentFrame);
-    }
-
-    if (resourcesOnly)
-        return;
+    std::vector<std::shared_ptr<View>> removedViews(std::next(m_views.begin(), firstRowViewId), m_views.end());
 
     m_views.erase(std::next(m_views.begin(), firstRowViewId), std::next(m_views.begin(), m_views.size()));
     m_viewRowColumns.erase(std::next(m_viewRowColumns.begin(), m_viewRowColumns.size() - 1));
@@ -274,6 +267,7 @@ void ViewGrid::removeRow(int currentFrame, bool resourcesOnly)
 
     resizeViewsHeight(newViewHeight);
 
+    return removedViews;
 }
 
 std::vector<std::shared_ptr<View>> ViewGrid::getViews() const
@@ -281,6 +275,31 @@ std::vector<std::shared_ptr<View>> ViewGrid::getViews() const
     return m_views;
 }
 
+std::vector<std::shared_ptr<View>> ViewGrid::getDirtyViews() const
+{
+    std::vector<std::shared_ptr<View>> dirtyViews;
+
+    for (auto& view : m_views)
+    {
+        if (view->isDirty())
+            dirtyViews.push_back(view);
+    }
+
+    return dirtyViews;
+}
+
+void ViewGrid::setViewsRendered()
+{
+    for (auto& view : m_views)
+        view->setRendered();
+}
+
+void ViewGrid::setViewsDirty()
+{
+    for (auto& view : m_views)
+        view->setDirty();
+}
+
 void ViewGrid::getInputInfo(glm::vec3 &position, glm::vec3 &viewDir, float& speed,
     float& sensitivity)
 {
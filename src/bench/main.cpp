@@ -0,0 +1,51 @@
+/**
+ * @file main.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief Runs the evaluation sweeps in one process, instead of one process per measurement.
+ * @date 2024-05-20
+ * 
+ * 
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "Benchmark.h"
+
+void printUsage()
+{
+    std::cout << "Usage: " << std::endl << 
+                "./ExteriorMappingBench SWEEP_FILE [ --out RESULTS_FILE ]" << std::endl << 
+                "(RESULTS_FILE is written into the profiles folder, benchmark.json by default)" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+
+    if (arguments.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::string resultsFile = "benchmark.json";
+    if (auto it = std::find(arguments.begin(), arguments.end(), "--out"); it != arguments.end())
+    {
+        if (auto stringIt = std::next(it, 1); stringIt != arguments.end())
+            resultsFile = *stringIt;
+    }
+
+    try
+    {
+        vke::Benchmark benchmark(arguments[0]);
+        benchmark.run();
+        benchmark.saveResults(std::string(PROFILE_FILES_LOC) + resultsFile);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,789 @@
+/**
+ * @file CpuRayEvaluator.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "cpu/CpuRayEvaluator.h"
+
+#include "utils/Constants.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// SSE2 is part of every x86-64 target, the lanes are processed four at a time without any
+// extra compiler flags.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VKE_CPU_SSE
+#endif
+
+namespace
+{
+
+// Same values as in res/shaders/constants.glsl.
+constexpr int MAX_HITS = MAX_VIEWS;
+constexpr int MIN_INTERVAL_VIEWS = 4;
+constexpr int INTS_FOR_ENCODING = MAX_HITS / 32;
+constexpr float MAX_ANGLE = 3.1415926535897932384626433832795f / 2.f;
+constexpr int MIN_PIX_SAMPLES = 16;
+constexpr int MAX_PIX_SAMPLES = 256 - MIN_PIX_SAMPLES;
+
+constexpr uint32_t SAMPLE_COLOR = 1u << static_cast<int>(vke::SamplingType::COLOR);
+constexpr uint32_t SAMPLE_DEPTH_NORMAL = 1u << static_cast<int>(vke::SamplingType::DEPTH_DIST);
+constexpr uint32_t SAMPLE_DEPTH_ANGLE = 1u << static_cast<int>(vke::SamplingType::DEPTH_ANGLE);
+
+constexpr int LANES = vke::CpuRayEvaluator::RAY_PACKET_SIZE;
+
+#ifdef VKE_CPU_SSE
+constexpr int SSE_WIDTH = 4;
+static_assert(LANES % SSE_WIDTH == 0, "The ray packet has to be a multiple of the SSE width.");
+
+/**
+ * @brief mask ? a : b, the mask lanes are all ones or all zeros.
+ */
+__m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+struct FrustumHit
+{
+    float t;
+    int viewId;
+};
+
+struct IntervalHit
+{
+    glm::vec2 t;
+    uint32_t idBits[INTS_FOR_ENCODING];
+    int count;
+};
+
+struct BilinearTap
+{
+    int x0, y0, x1, y1;
+    float fx, fy;
+};
+
+bool isInMask(int id, const uint32_t* mask)
+{
+    return (mask[id / 32] & (1u << (id % 32))) != 0;
+}
+
+/**
+ * @brief Linear filtering with clamp to edge, same as the framebuffer sampler.
+ */
+BilinearTap bilinearTap(const glm::ivec2& res, float u, float v)
+{
+    float x = u * res.x - 0.5f;
+    float y = v * res.y - 0.5f;
+
+    x = std::isfinite(x) ? std::clamp(x, -1.f, float(res.x)) : 0.f;
+    y = std::isfinite(y) ? std::clamp(y, -1.f, float(res.y)) : 0.f;
+
+    float floorX = std::floor(x);
+    float floorY = std::floor(y);
+
+    BilinearTap tap;
+    tap.fx = x - floorX;
+    tap.fy = y - floorY;
+    tap.x0 = std::clamp(int(floorX), 0, res.x - 1);
+    tap.y0 = std::clamp(int(floorY), 0, res.y - 1);
+    tap.x1 = std::clamp(int(floorX) + 1, 0, res.x - 1);
+    tap.y1 = std::clamp(int(floorY) + 1, 0, res.y - 1);
+
+    return tap;
+}
+
+glm::vec4 fetchColor(const vke::CpuAtlas& atlas, int x, int y)
+{
+    const uint8_t* texel = atlas.color + (size_t(y) * atlas.res.x + x) * 4;
+
+    return glm::vec4(texel[0], texel[1], texel[2], texel[3]) / 255.f;
+}
+
+glm::vec4 sampleColor(const vke::CpuAtlas& atlas, float u, float v)
+{
+    BilinearTap tap = bilinearTap(atlas.res, u, v);
+
+    glm::vec4 top = glm::mix(fetchColor(atlas, tap.x0, tap.y0), fetchColor(atlas, tap.x1, tap.y0), tap.fx);
+    glm::vec4 bottom = glm::mix(fetchColor(atlas, tap.x0, tap.y1), fetchColor(atlas, tap.x1, tap.y1), tap.fx);
+
+    return glm::mix(top, bottom, tap.fy);
+}
+
+float sampleDepth(const vke::CpuAtlas& atlas, float u, float v)
+{
+    BilinearTap tap = bilinearTap(atlas.res, u, v);
+
+    size_t row0 = size_t(tap.y0) * atlas.res.x;
+    size_t row1 = size_t(tap.y1) * atlas.res.x;
+
+    float top = glm::mix(atlas.depth[row0 + tap.x0], atlas.depth[row0 + tap.x1], tap.fx);
+    float bottom = glm::mix(atlas.depth[row1 + tap.x0], atlas.depth[row1 + tap.x1], tap.fx);
+
+    return glm::mix(top, bottom, tap.fy);
+}
+
+/**
+ * @brief Transforms (x, y, z, 1) of every lane by the matrix.
+ */
+void transformLanes(const glm::mat4& m, const float* __restrict x, const float* __restrict y,
+    const float* __restrict z, float* __restrict outX, float* __restrict outY, float* __restrict outZ,
+    float* __restrict outW)
+{
+#ifdef VKE_CPU_SSE
+    for (int l = 0; l < LANES; l += SSE_WIDTH)
+    {
+        __m128 vx = _mm_loadu_ps(x + l);
+        __m128 vy = _mm_loadu_ps(y + l);
+        __m128 vz = _mm_loadu_ps(z + l);
+
+        for (int row = 0; row < 4; row++)
+        {
+            __m128 result = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][row]), vx),
+                _mm_mul_ps(_mm_set1_ps(m[1][row]), vy)), _mm_mul_ps(_mm_set1_ps(m[2][row]), vz)),
+                _mm_set1_ps(m[3][row]));
+
+            float* out = (row == 0) ? outX : (row == 1) ? outY : (row == 2) ? outZ : outW;
+            _mm_storeu_ps(out + l, result);
+        }
+    }
+#else
+    for (int l = 0; l < LANES; l++)
+    {
+        outX[l] = m[0][0] * x[l] + m[1][0] * y[l] + m[2][0] * z[l] + m[3][0];
+        outY[l] = m[0][1] * x[l] + m[1][1] * y[l] + m[2][1] * z[l] + m[3][1];
+        outZ[l] = m[0][2] * x[l] + m[1][2] * y[l] + m[2][2] * z[l] + m[3][2];
+        outW[l] = m[0][3] * x[l] + m[1][3] * y[l] + m[2][3] * z[l] + m[3][3];
+    }
+#endif
+}
+
+/**
+ * @brief Intersects every lane with the six planes of a view frustum. The first two parameters
+ * of the plane hits are kept, found counts the hits lying on the frustum, at most two.
+ */
+void intersectFrustumLanes(const glm::vec4* planes, const float* __restrict orgX, const float* __restrict orgY,
+    const float* __restrict orgZ, const float* __restrict dirX, const float* __restrict dirY,
+    const float* __restrict dirZ, float* __restrict intersects0, float* __restrict intersects1,
+    int* __restrict found)
+{
+#ifdef VKE_CPU_SSE
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    const __m128 epsilon = _mm_set1_ps(1e-6f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+
+    for (int l = 0; l < LANES; l += SSE_WIDTH)
+    {
+        __m128 ox = _mm_loadu_ps(orgX + l);
+        __m128 oy = _mm_loadu_ps(orgY + l);
+        __m128 oz = _mm_loadu_ps(orgZ + l);
+        __m128 dx = _mm_loadu_ps(dirX + l);
+        __m128 dy = _mm_loadu_ps(dirY + l);
+        __m128 dz = _mm_loadu_ps(dirZ + l);
+
+        __m128 i0 = _mm_setzero_ps();
+        __m128 i1 = _mm_setzero_ps();
+        __m128i count = _mm_setzero_si128();
+
+        for (int j = 0; j < 6; j++)
+        {
+            __m128 px = _mm_set1_ps(planes[j].x);
+            __m128 py = _mm_set1_ps(planes[j].y);
+            __m128 pz = _mm_set1_ps(planes[j].z);
+            __m128 pw = _mm_set1_ps(planes[j].w);
+
+            __m128 denom = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, dx), _mm_mul_ps(py, dy)), _mm_mul_ps(pz, dz));
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, ox), _mm_mul_ps(py, oy)),
+                _mm_mul_ps(pz, oz)), pw);
+            __m128 t = _mm_div_ps(_mm_xor_ps(dist, signMask), denom);
+
+            __m128 ix = _mm_add_ps(ox, _mm_mul_ps(t, dx));
+            __m128 iy = _mm_add_ps(oy, _mm_mul_ps(t, dy));
+            __m128 iz = _mm_add_ps(oz, _mm_mul_ps(t, dz));
+
+            // the intersection has to lie inside the other five planes
+            __m128 valid = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int k = 0; k < 6; k++)
+            {
+                if (k == j)
+                    continue;
+
+                __m128 side = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[k].x), ix),
+                    _mm_mul_ps(_mm_set1_ps(planes[k].y), iy)), _mm_mul_ps(_mm_set1_ps(planes[k].z), iz)),
+                    _mm_set1_ps(planes[k].w));
+                valid = _mm_and_ps(valid, _mm_cmpge_ps(side, _mm_setzero_ps()));
+            }
+
+            __m128 hit = _mm_cmpgt_ps(_mm_andnot_ps(signMask, denom), epsilon);
+
+            i0 = select(_mm_and_ps(hit, _mm_castsi128_ps(_mm_cmpeq_epi32(count, zero))), t, i0);
+            i1 = select(_mm_and_ps(hit, _mm_castsi128_ps(_mm_cmpeq_epi32(count, one))), t, i1);
+
+            // all ones is -1, subtracting the mask counts the hit
+            __m128 counted = _mm_and_ps(_mm_and_ps(hit, valid), _mm_castsi128_ps(_mm_cmplt_epi32(count, two)));
+            count = _mm_sub_epi32(count, _mm_castps_si128(counted));
+        }
+
+        _mm_storeu_ps(intersects0 + l, i0);
+        _mm_storeu_ps(intersects1 + l, i1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(found + l), count);
+    }
+#else
+    for (int l = 0; l < LANES; l++)
+    {
+        intersects0[l] = 0.f;
+        intersects1[l] = 0.f;
+        found[l] = 0;
+    }
+
+    for (int j = 0; j < 6; j++)
+    {
+        for (int l = 0; l < LANES; l++)
+        {
+            float denom = planes[j].x * dirX[l] + planes[j].y * dirY[l] + planes[j].z * dirZ[l];
+            float t = -(planes[j].x * orgX[l] + planes[j].y * orgY[l] + planes[j].z * orgZ[l] + planes[j].w) / denom;
+
+            float ix = orgX[l] + t * dirX[l];
+            float iy = orgY[l] + t * dirY[l];
+            float iz = orgZ[l] + t * dirZ[l];
+
+            bool valid = true;
+            for (int k = 0; k < 6; k++)
+            {
+                bool inside = planes[k].x * ix + planes[k].y * iy + planes[k].z * iz + planes[k].w >= 0.f;
+                valid = valid && (k == j || inside);
+            }
+
+            bool hit = std::fabs(denom) > 1e-6f;
+            intersects0[l] = (hit && found[l] == 0) ? t : intersects0[l];
+            intersects1[l] = (hit && found[l] == 1) ? t : intersects1[l];
+            found[l] += int(hit && valid && found[l] < 2);
+        }
+    }
+#endif
+}
+
+void insertSort(FrustumHit* hits, int intersectCount)
+{
+    for (int i = 1; i < intersectCount; i++)
+    {
+        FrustumHit key = hits[i];
+
+        int j = i - 1;
+        while (j >= 0 && hits[j].t > key.t)
+        {
+            hits[j + 1] = hits[j];
+            j = j - 1;
+        }
+
+        hits[j + 1] = key;
+    }
+}
+
+/**
+ * @brief Port of FIND_MAX_INTERVAL, including the lookup of the new interval start
+ * by the hit index, so that the result matches the shader.
+ */
+IntervalHit findMaxInterval(const FrustumHit* frustumHitsIn, const FrustumHit* frustumHitsOut,
+    int intersectCount)
+{
+    IntervalHit maxInterval{};
+    maxInterval.count = 0;
+
+    int maxInInterval = 0;
+    int currentlyInInterval = 0;
+    uint32_t cameraIndexMask[INTS_FOR_ENCODING] = {};
+    float currentStartT = -1;
+
+    int inId = 0;
+    int outId = 0;
+    for (int i = 0; i < intersectCount * 2; i++)
+    {
+        FrustumHit hitIn = frustumHitsIn[std::min(inId, intersectCount - 1)];
+        FrustumHit hitOut = frustumHitsOut[std::min(outId, intersectCount - 1)];
+
+        if (hitIn.t <= hitOut.t && inId < intersectCount)
+        {
+            currentlyInInterval++;
+
+            cameraIndexMask[hitIn.viewId / 32] |= (1u << (hitIn.viewId % 32));
+
+            currentStartT = hitIn.t;
+
+            inId++;
+        }
+        else if (hitIn.t > hitOut.t || inId >= intersectCount)
+        {
+            if (currentlyInInterval >= MIN_INTERVAL_VIEWS &&
+                currentlyInInterval > maxInInterval)
+            {
+                maxInterval.t = glm::vec2(currentStartT, hitOut.t);
+                std::copy(cameraIndexMask, cameraIndexMask + INTS_FOR_ENCODING, maxInterval.idBits);
+                maxInterval.count = currentlyInInterval;
+                maxInInterval = currentlyInInterval;
+            }
+
+            currentlyInInterval--;
+
+            cameraIndexMask[hitOut.viewId / 32] &= ~(1u << (hitOut.viewId % 32));
+
+            if (inId > 0 && frustumHitsIn[inId - 1].viewId == hitOut.viewId)
+            {
+                for (int j = inId - 2; j >= 0; j--)
+                {
+                    if (isInMask(j, cameraIndexMask))
+                    {
+                        currentStartT = frustumHitsIn[j].t;
+                        break;
+                    }
+                }
+            }
+
+            outId++;
+        }
+    }
+
+    return maxInterval;
+}
+
+float pointToLineDist(const glm::vec3& v, const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec3 ab = b - a;
+    glm::vec3 av = v - a;
+    glm::vec3 bv = v - b;
+
+    if (glm::dot(av, ab) <= 0.f)
+    {
+        return glm::length(av);
+    }
+    else if (glm::dot(bv, ab) >= 0.f)
+    {
+        return glm::length(bv);
+    }
+
+    return glm::length(glm::cross(ab, av)) / glm::length(ab);
+}
+
+float lineToLineAngleDist(const glm::vec3& c, const glm::vec3& d, const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec3 ab = b - a;
+    glm::vec3 cd = d - c;
+
+    return std::acos(glm::dot(ab, cd) / (glm::length(ab) * glm::length(cd)));
+}
+
+bool anyLane(const bool* lanes)
+{
+    bool result = false;
+    for (int l = 0; l < LANES; l++)
+    {
+        result = result || lanes[l];
+    }
+
+    return result;
+}
+
+}
+
+namespace vke
+{
+
+struct CpuRayEvaluator::ViewData
+{
+    glm::vec4 frustumPlanes[6];
+    glm::mat4 viewProj;
+    glm::mat4 invView;
+    glm::mat4 invProj;
+    glm::vec2 res;
+    glm::vec2 offset;
+    glm::vec3 viewDir;
+};
+
+struct CpuRayEvaluator::RayPacket
+{
+    float orgX[LANES], orgY[LANES], orgZ[LANES];
+    float dirX[LANES], dirY[LANES], dirZ[LANES];
+
+    int pixelX;
+    int pixelY;
+    int laneCount;
+
+    glm::vec4 color[LANES];
+};
+
+CpuRayEvaluator::CpuRayEvaluator(uint32_t threadCount, uint32_t tileSize)
+    : m_threadPool(std::make_unique<TileThreadPool>(threadCount)),
+      m_tileSize(std::max(tileSize, 1u))
+{
+}
+
+void CpuRayEvaluator::evaluate(const RayEvalUniformBuffer& ubo, const std::vector<ViewEvalDataCompute>& views,
+    const CpuAtlas& atlas, std::vector<glm::vec4>& output)
+{
+    if (ubo.viewCnt < 0 || ubo.viewCnt > MAX_VIEWS || static_cast<size_t>(ubo.viewCnt) > views.size())
+    {
+        throw std::runtime_error("Invalid number of views for the CPU ray evaluation.");
+    }
+
+    if (atlas.color == nullptr || atlas.depth == nullptr || atlas.res.x <= 0 || atlas.res.y <= 0)
+    {
+        throw std::runtime_error("CPU ray evaluation requires both color and depth atlas.");
+    }
+
+    std::vector<ViewData> viewData(ubo.viewCnt);
+    for (int i = 0; i < ubo.viewCnt; i++)
+    {
+        const ViewEvalDataCompute& view = views[i];
+
+        std::copy(view.frustumPlanes, view.frustumPlanes + 6, viewData[i].frustumPlanes);
+        viewData[i].viewProj = view.proj * view.view;
+        viewData[i].invView = view.invView;
+        viewData[i].invProj = view.invProj;
+        viewData[i].res = glm::vec2(view.resOffset.x, view.resOffset.y);
+        viewData[i].offset = glm::vec2(view.resOffset.z, view.resOffset.w);
+        viewData[i].viewDir = glm::vec3(view.viewDir);
+    }
+
+    glm::ivec2 res = glm::ivec2(ubo.res);
+    output.resize(size_t(res.x) * res.y);
+
+    uint32_t tilesX = (res.x + m_tileSize - 1) / m_tileSize;
+    uint32_t tilesY = (res.y + m_tileSize - 1) / m_tileSize;
+
+    m_threadPool->run(tilesX * tilesY, [&](uint32_t tile)
+    {
+        int startX = (tile % tilesX) * m_tileSize;
+        int startY = (tile / tilesX) * m_tileSize;
+        int endX = std::min(startX + int(m_tileSize), res.x);
+        int endY = std::min(startY + int(m_tileSize), res.y);
+
+        RayPacket packet;
+        for (int y = startY; y < endY; y++)
+        {
+            for (int x = startX; x < endX; x += LANES)
+            {
+                packet.pixelX = x;
+                packet.pixelY = y;
+                packet.laneCount = std::min(LANES, endX - x);
+
+                evaluatePacket(ubo, viewData, atlas, packet);
+
+                std::copy(packet.color, packet.color + packet.laneCount,
+                    output.begin() + size_t(y) * res.x + x);
+            }
+        }
+    });
+}
+
+uint32_t CpuRayEvaluator::getThreadCount() const
+{
+    return m_threadPool->getThreadCount();
+}
+
+uint32_t CpuRayEvaluator::getTileSize() const
+{
+    return m_tileSize;
+}
+
+void CpuRayEvaluator::evaluatePacket(const RayEvalUniformBuffer& ubo, const std::vector<ViewData>& views,
+    const CpuAtlas& atlas, RayPacket& packet) const
+{
+    // Ray generation
+    for (int l = 0; l < LANES; l++)
+    {
+        glm::vec2 pixCenter = glm::vec2(packet.pixelX + l, packet.pixelY) + glm::vec2(0.5f);
+        glm::vec2 uv = pixCenter / ubo.res;
+        glm::vec2 d = uv * 2.f - 1.f;
+
+        glm::vec4 from = ubo.invProj * glm::vec4(d.x, d.y, 0.f, 1.f);
+        glm::vec4 target = ubo.invProj * glm::vec4(d.x, d.y, 1.f, 1.f);
+
+        from /= from.w;
+        target /= target.w;
+
+        glm::vec3 org = glm::vec3(ubo.invView * from);
+        glm::vec3 dir = glm::vec3(ubo.invView * glm::vec4(glm::normalize(glm::vec3(target)), 0.f));
+
+        packet.orgX[l] = org.x;
+        packet.orgY[l] = org.y;
+        packet.orgZ[l] = org.z;
+        packet.dirX[l] = dir.x;
+        packet.dirY[l] = dir.y;
+        packet.dirZ[l] = dir.z;
+    }
+
+    // Frustum intersections, all lanes against one view at a time
+    FrustumHit frustumHitsIn[LANES][MAX_HITS];
+    FrustumHit frustumHitsOut[LANES][MAX_HITS];
+    int intersectCount[LANES] = {};
+
+    for (int i = 0; i < ubo.viewCnt; i++)
+    {
+        const glm::vec4* planes = views[i].frustumPlanes;
+
+        float intersects0[LANES];
+        float intersects1[LANES];
+        int foundIntersects[LANES];
+
+        intersectFrustumLanes(planes, packet.orgX, packet.orgY, packet.orgZ, packet.dirX, packet.dirY, packet.dirZ,
+            intersects0, intersects1, foundIntersects);
+
+        for (int l = 0; l < LANES; l++)
+        {
+            if (foundIntersects[l] != 2)
+            {
+                continue;
+            }
+
+            bool swapped = intersects0[l] >= intersects1[l];
+            float tIn = swapped ? intersects1[l] : intersects0[l];
+            float tOut = swapped ? intersects0[l] : intersects1[l];
+
+            frustumHitsIn[l][intersectCount[l]] = { tIn >= 0.f ? tIn : 0.f, i };
+            frustumHitsOut[l][intersectCount[l]] = { tOut, i };
+            intersectCount[l]++;
+        }
+    }
+
+    // Intervals and sample counts, sequential per ray
+    IntervalHit intervals[LANES];
+    int sampleCount[LANES];
+    bool laneValid[LANES];
+    int maxSampleCount = 0;
+
+    for (int l = 0; l < LANES; l++)
+    {
+        insertSort(frustumHitsIn[l], intersectCount[l]);
+        insertSort(frustumHitsOut[l], intersectCount[l]);
+
+        intervals[l] = findMaxInterval(frustumHitsIn[l], frustumHitsOut[l], intersectCount[l]);
+
+        laneValid[l] = l < packet.laneCount && intervals[l].count > 0;
+        sampleCount[l] = ubo.numOfRaySamples;
+        packet.color[l] = laneValid[l] ? glm::vec4(0.f) : glm::vec4(0.f, 0.f, 1.f, 1.f);
+
+        if (!laneValid[l])
+        {
+            continue;
+        }
+
+        if (ubo.automaticSampleCount)
+        {
+            glm::vec3 org(packet.orgX[l], packet.orgY[l], packet.orgZ[l]);
+            glm::vec3 dir(packet.dirX[l], packet.dirY[l], packet.dirZ[l]);
+            glm::vec3 ray = (org + dir * intervals[l].t.y) - (org + dir * intervals[l].t.x);
+
+            float maxDist = 0.f;
+            for (int i = 0; i < ubo.viewCnt; i++)
+            {
+                if (isInMask(i, intervals[l].idBits))
+                {
+                    const glm::vec3& viewDir = views[i].viewDir;
+                    float localDist = std::acos(glm::dot(viewDir, ray) / (glm::length(viewDir) * glm::length(ray)));
+
+                    if (localDist > maxDist)
+                    {
+                        maxDist = localDist;
+                    }
+                }
+            }
+
+            float ratio = std::min(maxDist / MAX_ANGLE, 1.f);
+            sampleCount[l] = MIN_PIX_SAMPLES + int(ratio * MAX_PIX_SAMPLES);
+        }
+
+        maxSampleCount = std::max(maxSampleCount, sampleCount[l]);
+    }
+
+    if (!anyLane(laneValid))
+    {
+        return;
+    }
+
+    // Sampling along the intervals, every lane samples the same view together
+    bool colorSampling = ubo.samplingType == SAMPLE_COLOR;
+
+    float segmentStart[LANES];
+    float sampleDist[LANES];
+    glm::vec3 startP[LANES];
+    glm::vec3 endP[LANES];
+    float bestDist[LANES];
+
+    for (int l = 0; l < LANES; l++)
+    {
+        glm::vec3 org(packet.orgX[l], packet.orgY[l], packet.orgZ[l]);
+        glm::vec3 dir(packet.dirX[l], packet.dirY[l], packet.dirZ[l]);
+
+        segmentStart[l] = intervals[l].t.x;
+        sampleDist[l] = (intervals[l].t.y - intervals[l].t.x) / float(sampleCount[l]);
+        startP[l] = org + dir * intervals[l].t.x;
+        endP[l] = org + dir * intervals[l].t.y;
+        bestDist[l] = colorSampling ? 20.f : std::numeric_limits<float>::infinity();
+    }
+
+    for (int j = 0; j < maxSampleCount; j++)
+    {
+        bool sampling[LANES];
+        float px[LANES], py[LANES], pz[LANES];
+
+        for (int l = 0; l < LANES; l++)
+        {
+            sampling[l] = laneValid[l] && j < sampleCount[l];
+
+            float t = segmentStart[l] + j * sampleDist[l];
+            px[l] = packet.orgX[l] + packet.dirX[l] * t;
+            py[l] = packet.orgY[l] + packet.dirY[l] * t;
+            pz[l] = packet.orgZ[l] + packet.dirZ[l] * t;
+        }
+
+        glm::vec4 localMin[LANES];
+        glm::vec4 localMax[LANES];
+        glm::vec4 colorAcc[LANES];
+        float pointDistAcc[LANES];
+        int numOfViews[LANES];
+        bool viewsDone[LANES];
+
+        for (int l = 0; l < LANES; l++)
+        {
+            localMin[l] = glm::vec4(2.f);
+            localMax[l] = glm::vec4(-1.f);
+            colorAcc[l] = glm::vec4(0.f);
+            pointDistAcc[l] = 0.f;
+            numOfViews[l] = 0;
+            viewsDone[l] = false;
+        }
+
+        for (int k = 0; k < ubo.viewCnt; k++)
+        {
+            const ViewData& view = views[k];
+
+            bool use[LANES];
+            for (int l = 0; l < LANES; l++)
+            {
+                use[l] = sampling[l] && !viewsDone[l] && isInMask(k, intervals[l].idBits);
+            }
+
+            if (!anyLane(use))
+            {
+                continue;
+            }
+
+            float ctX[LANES], ctY[LANES], ctZ[LANES], ctW[LANES];
+            transformLanes(view.viewProj, px, py, pz, ctX, ctY, ctZ, ctW);
+
+            float dX[LANES], dY[LANES], u[LANES], v[LANES];
+            for (int l = 0; l < LANES; l++)
+            {
+                dX[l] = ctX[l] / ctW[l];
+                dY[l] = ctY[l] / ctW[l];
+
+                u[l] = (((dX[l] + 1.f) / 2.f) * view.res.x + view.offset.x) / ubo.viewsTotalRes.x;
+                v[l] = (((dY[l] + 1.f) / 2.f) * view.res.y + view.offset.y) / ubo.viewsTotalRes.y;
+            }
+
+            if (colorSampling)
+            {
+                for (int l = 0; l < LANES; l++)
+                {
+                    if (use[l])
+                    {
+                        glm::vec4 pixVal = sampleColor(atlas, u[l], v[l]);
+
+                        localMin[l] = glm::min(localMin[l], pixVal);
+                        localMax[l] = glm::max(localMax[l], pixVal);
+                        colorAcc[l] += pixVal;
+                    }
+                }
+            }
+            else
+            {
+                float z[LANES];
+                for (int l = 0; l < LANES; l++)
+                {
+                    z[l] = use[l] ? sampleDepth(atlas, u[l], v[l]) : 0.f;
+                }
+
+                float vX[LANES], vY[LANES], vZ[LANES], vW[LANES];
+                transformLanes(view.invProj, dX, dY, z, vX, vY, vZ, vW);
+
+                for (int l = 0; l < LANES; l++)
+                {
+                    vX[l] /= vW[l];
+                    vY[l] /= vW[l];
+                    vZ[l] /= vW[l];
+                }
+
+                float wX[LANES], wY[LANES], wZ[LANES], wW[LANES];
+                transformLanes(view.invView, vX, vY, vZ, wX, wY, wZ, wW);
+
+                for (int l = 0; l < LANES; l++)
+                {
+                    if (!use[l])
+                    {
+                        continue;
+                    }
+
+                    glm::vec3 worldPoint(wX[l], wY[l], wZ[l]);
+
+                    float pointDistance = std::numeric_limits<float>::infinity();
+                    if (ubo.samplingType == SAMPLE_DEPTH_NORMAL)
+                    {
+                        pointDistance = pointToLineDist(worldPoint, startP[l], endP[l]);
+                    }
+                    else if (ubo.samplingType == SAMPLE_DEPTH_ANGLE)
+                    {
+                        glm::vec3 org(packet.orgX[l], packet.orgY[l], packet.orgZ[l]);
+                        pointDistance = lineToLineAngleDist(org, worldPoint, startP[l], endP[l]);
+                    }
+
+                    pointDistAcc[l] += pointDistance;
+                    colorAcc[l] += sampleColor(atlas, u[l], v[l]);
+                }
+            }
+
+            for (int l = 0; l < LANES; l++)
+            {
+                numOfViews[l] += int(use[l]);
+                viewsDone[l] = viewsDone[l] || numOfViews[l] > ubo.maxViewsUsed;
+            }
+        }
+
+        for (int l = 0; l < LANES; l++)
+        {
+            if (!sampling[l])
+            {
+                continue;
+            }
+
+            if (colorSampling)
+            {
+                glm::vec4 localVecDist = localMax[l] - localMin[l];
+                float localDist = localVecDist.x + localVecDist.y + localVecDist.z + localVecDist.w;
+
+                if (localDist < bestDist[l])
+                {
+                    bestDist[l] = localDist;
+                    packet.color[l] = colorAcc[l] / float(numOfViews[l]);
+                }
+            }
+            else if (pointDistAcc[l] < bestDist[l])
+            {
+                bestDist[l] = pointDistAcc[l];
+                packet.color[l] = colorAcc[l] / float(numOfViews[l]);
+            }
+        }
+    }
+}
+
+}
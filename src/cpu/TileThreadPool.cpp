@@ -0,0 +1,189 @@
+/**
+ * @file TileThreadPool.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "cpu/TileThreadPool.h"
+
+#include <algorithm>
+
+namespace vke
+{
+
+TileThreadPool::TileThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    // worker 0 is the thread calling run()
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        m_threads.emplace_back(&TileThreadPool::workerLoop, this, i);
+    }
+}
+
+TileThreadPool::~TileThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_startCondition.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void TileThreadPool::run(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+    if (taskCount == 0)
+    {
+        return;
+    }
+
+    uint32_t workerCount = static_cast<uint32_t>(m_queues.size());
+    uint32_t blockSize = (taskCount + workerCount - 1) / workerCount;
+
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        std::lock_guard<std::mutex> lock(m_queues[i]->mutex);
+
+        uint32_t start = std::min(i * blockSize, taskCount);
+        uint32_t end = std::min(start + blockSize, taskCount);
+        for (uint32_t t = start; t < end; t++)
+        {
+            m_queues[i]->tasks.push_back(t);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_exception = nullptr;
+        m_runningWorkers = static_cast<uint32_t>(m_threads.size());
+        m_generation++;
+    }
+
+    m_startCondition.notify_all();
+
+    executeTasks(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this]{ return m_runningWorkers == 0; });
+
+    m_task = nullptr;
+
+    if (m_exception)
+    {
+        std::exception_ptr exception = m_exception;
+        m_exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+uint32_t TileThreadPool::getThreadCount() const
+{
+    return static_cast<uint32_t>(m_queues.size());
+}
+
+void TileThreadPool::workerLoop(uint32_t workerId)
+{
+    uint64_t seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_startCondition.wait(lock, [&]{ return m_stop || m_generation != seenGeneration; });
+
+            if (m_stop)
+            {
+                return;
+            }
+
+            seenGeneration = m_generation;
+        }
+
+        executeTasks(workerId);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_runningWorkers--;
+        }
+
+        m_doneCondition.notify_one();
+    }
+}
+
+void TileThreadPool::executeTasks(uint32_t workerId)
+{
+    uint32_t task;
+    while (popTask(workerId, task) || stealTask(workerId, task))
+    {
+        try
+        {
+            (*m_task)(task);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_exception)
+            {
+                m_exception = std::current_exception();
+            }
+        }
+    }
+}
+
+bool TileThreadPool::popTask(uint32_t workerId, uint32_t& task)
+{
+    WorkQueue& queue = *m_queues[workerId];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+
+    return true;
+}
+
+bool TileThreadPool::stealTask(uint32_t workerId, uint32_t& task)
+{
+    uint32_t workerCount = static_cast<uint32_t>(m_queues.size());
+
+    for (uint32_t i = 1; i < workerCount; i++)
+    {
+        WorkQueue& victim = *m_queues[(workerId + i) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
@@ -14,8 +14,13 @@
 void printUsage()
 {
     std::cout << "Usage: " << std::endl << 
-                "./ExteriorMapping [ --recover | --config CONFIG_FILE ]" << std::endl << 
-                "(CONFIG_FILE needs to be placed in the config file folder in /res)" << std::endl;
+                "./ExteriorMapping [ --recover | --config CONFIG_FILE ] [ --headless ] [ --quality PERCENT ] [ --trace FILE ] [ --dump ] [ --cpu_metrics ]" << std::endl << 
+                "(CONFIG_FILE needs to be placed in the config file folder in /res)" << std::endl <<
+                "(--headless is only supported together with --eval)" << std::endl <<
+                "(--quality below 100 evaluates the flat parts of the novel view at a lower rate)" << std::endl <<
+                "(--trace writes a chrome://tracing file of the frames into the profiles folder on exit)" << std::endl <<
+                "(--eval mse compares the novel view with the ground truth on the GPU, --dump also writes both images" << std::endl <<
+                " and --cpu_metrics computes the metrics on the CPU instead)" << std::endl;
 }
 
 // Inspired by:
@@ -192,6 +197,46 @@ void argumentsWindowSize(const std::vector<std::string>& arguments, vke::Applica
     }
 }
 
+void argumentsHeadless(const std::vector<std::string>& arguments, vke::Application::Arguments& appArgs)
+{
+    appArgs.headless = std::find(arguments.begin(), arguments.end(), "--headless") != arguments.end();
+
+    // Without windows there is no user input, so only the evaluation can drive the frames.
+    if (appArgs.headless && appArgs.evalType == vke::Application::Arguments::EvaluationType::_COUNT)
+    {
+        std::cout << "Error: --headless can be used only together with --eval." << std::endl;
+        appArgs.configFile = "";
+    }
+}
+
+void argumentsQuality(const std::vector<std::string>& arguments, vke::Application::Arguments& appArgs)
+{
+    auto it = arguments.begin();
+    if (it = std::find(arguments.begin(), arguments.end(), "--quality"); it != arguments.end())
+    {
+        if (auto stringIt = std::next(it, 1); stringIt != arguments.end() && isStringNumber(*stringIt))
+        {
+            appArgs.quality = std::min(std::stoi(*stringIt), 100);
+        }
+    }
+}
+
+void argumentsTrace(const std::vector<std::string>& arguments, vke::Application::Arguments& appArgs)
+{
+    auto it = arguments.begin();
+    if (it = std::find(arguments.begin(), arguments.end(), "--trace"); it != arguments.end())
+    {
+        if (auto stringIt = std::next(it, 1); stringIt != arguments.end())
+            appArgs.traceFile = *stringIt;
+    }
+}
+
+void argumentsMetrics(const std::vector<std::string>& arguments, vke::Application::Arguments& appArgs)
+{
+    appArgs.dumpImages = std::find(arguments.begin(), arguments.end(), "--dump") != arguments.end();
+    appArgs.cpuMetrics = std::find(arguments.begin(), arguments.end(), "--cpu_metrics") != arguments.end();
+}
+
 vke::Application::Arguments parseArguments(const std::vector<std::string>& arguments)
 {
     vke::Application::Arguments appArgs{};
@@ -200,8 +245,15 @@ vke::Application::Arguments parseArguments(const std::vector<std::string>& argum
     
     argumentsDebug(arguments, appArgs);
 
+    argumentsHeadless(arguments, appArgs);
+
+    argumentsQuality(arguments, appArgs);
+
+    argumentsTrace(arguments, appArgs);
+
+    argumentsMetrics(arguments, appArgs);
 
-    if (appArgs.evalType == vke::Application::Arguments::EvaluationType::_COUNT)
+    if (appArgs.evalType == vke::Application::Arguments::EvaluationType::_COUNT || appArgs.headless)
     {
         argumentsWindowSize(arguments, appArgs);
     }
@@ -8,6 +8,7 @@
  */
 
 #include "utils/FileHandling.h"
+#include "utils/Trace.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image/stb_image.h>
@@ -16,6 +17,21 @@
 #include <stb_image/stb_image_write.h>
 
 #include <algorithm>
+#include <array>
+
+// The kernels are compiled for SSSE3 on their own and picked at runtime, the rest of the build
+// keeps the baseline instruction set.
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define VKE_SSSE3
+#define VKE_SSSE3_TARGET
+#define VKE_SSSE3_SUPPORTED() true
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define VKE_SSSE3
+#define VKE_SSSE3_TARGET __attribute__((target("ssse3")))
+#define VKE_SSSE3_SUPPORTED() __builtin_cpu_supports("ssse3")
+#endif
 
 namespace vke::utils
 {
@@ -54,6 +70,38 @@ unsigned char* loadImage(std::string& filename, int& width, int& height, int& ch
     return pixels;
 }
 
+unsigned char* decodeImage(const std::string& filename, int& width, int& height, int& channels)
+{
+    std::string path = filename;
+    std::replace(path.begin(), path.end(), '\\', '/');
+
+    unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    if (pixels == NULL)
+    {
+        throw std::runtime_error("Failed loading image: " + path);
+    }
+
+    return pixels;
+}
+
+bool getImageInfo(const std::string& filename, int& width, int& height, int& channels)
+{
+    std::string path = filename;
+    std::replace(path.begin(), path.end(), '\\', '/');
+
+    return stbi_info(path.c_str(), &width, &height, &channels) != 0;
+}
+
+void setFlipImagesOnLoad(bool flip)
+{
+    stbi_set_flip_vertically_on_load(flip ? 1 : 0);
+}
+
+void freeImage(unsigned char* pixels)
+{
+    stbi_image_free(pixels);
+}
+
 void saveImage(const std::string &filename, const glm::ivec3 &dims, uint8_t *data)
 {
     if (filename.substr(filename.find_last_of(".") + 1) == "jpg")
@@ -92,29 +140,20 @@ void saveImage(const std::string &filename, const glm::ivec3 &dims, uint8_t *dat
 
 void saveImages(const std::vector<SaveImageInfo> &saveInfos)
 {
+    TRACE_ZONE("Save images");
+
     for (auto& info : saveInfos)
     {
         saveImage(info.filename, info.dims, info.data);
     }
 }
 
-void saveImagesThread(const std::vector<SaveImageInfo> &saveInfos, bool& imagesSaved)
-{
-    saveImages(saveInfos);
-    imagesSaved = true;
-}
-
 std::vector<unsigned char> threeChannelsToOne(unsigned char *pixels, const int &width,
                                               const int &height)
 {
     std::vector<unsigned char> newValues(width * height);
 
-    for (int i = 0; i < width * height; i++)
-    {
-        int pixelsId = i * 3;
-
-        newValues[i] = static_cast<float>(pixels[pixelsId] + pixels[pixelsId + 1] + pixels[pixelsId + 2]) / 3.f;
-    }
+    rgbToLuma(pixels, newValues.data(), static_cast<size_t>(width) * height);
 
     return newValues;
 }
@@ -124,18 +163,137 @@ std::vector<unsigned char> threeChannelsToFour(unsigned char* pixels, const int&
 {
     std::vector<unsigned char> newValues(width * height * 4);
 
-    for (int i = 0; i < width * height; i++)
+    rgbToRgba(pixels, newValues.data(), static_cast<size_t>(width) * height);
+
+    return newValues;
+}
+
+#ifdef VKE_SSSE3
+namespace
+{
+
+bool ssse3Supported()
+{
+    static const bool supported = VKE_SSSE3_SUPPORTED();
+    return supported;
+}
+
+/**
+ * @brief Widens 4 pixels per step, the load reads 16 bytes of which 12 are used.
+ * 
+ * @return size_t Number of the converted pixels, the rest is left for the scalar loop.
+ */
+VKE_SSSE3_TARGET size_t rgbToRgbaSsse3(const unsigned char* src, unsigned char* dst, size_t pixelCount)
+{
+    const __m128i mask = _mm_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    size_t i = 0;
+    for (; i + 6 <= pixelCount; i += 4)
     {
-        int pixelsId = i * 3;
-        int newValsId = i * 4;
+        __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        __m128i rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, mask), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), rgba);
+    }
+
+    return i;
+}
 
-        newValues[newValsId] = pixels[pixelsId];
-        newValues[newValsId + 1] = pixels[pixelsId + 1];
-        newValues[newValsId + 2] = pixels[pixelsId + 2];
-        newValues[newValsId + 3] = 255;
+// shuffle masks gathering one channel of 16 pixels from three 16 byte loads
+const auto lumaMasks = []
+{
+    std::array<std::array<std::array<int8_t, 16>, 3>, 3> result{};
+    for (int channel = 0; channel < 3; channel++)
+    {
+        for (int j = 0; j < 16; j++)
+        {
+            int position = j * 3 + channel;
+            for (int load = 0; load < 3; load++)
+            {
+                result[channel][load][j] = (position / 16 == load) ? static_cast<int8_t>(position % 16) : -128;
+            }
+        }
     }
+    return result;
+}();
 
-    return newValues;
+VKE_SSSE3_TARGET __m128i gatherChannel(int channel, __m128i a, __m128i b, __m128i c)
+{
+    __m128i fromA = _mm_shuffle_epi8(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(lumaMasks[channel][0].data())));
+    __m128i fromB = _mm_shuffle_epi8(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(lumaMasks[channel][1].data())));
+    __m128i fromC = _mm_shuffle_epi8(c, _mm_loadu_si128(reinterpret_cast<const __m128i*>(lumaMasks[channel][2].data())));
+    return _mm_or_si128(fromA, _mm_or_si128(fromB, fromC));
+}
+
+/**
+ * @brief Averages 16 pixels per step.
+ * 
+ * @return size_t Number of the converted pixels, the rest is left for the scalar loop.
+ */
+VKE_SSSE3_TARGET size_t rgbToLumaSsse3(const unsigned char* src, unsigned char* dst, size_t pixelCount)
+{
+    const __m128i zero = _mm_setzero_si128();
+    // (sum * 21846) >> 16 equals sum / 3 rounded down for every sum of three bytes
+    const __m128i third = _mm_set1_epi16(21846);
+
+    size_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        const unsigned char* pixels = src + i * 3;
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 32));
+
+        __m128i r = gatherChannel(0, a, b, c);
+        __m128i g = gatherChannel(1, a, b, c);
+        __m128i bl = gatherChannel(2, a, b, c);
+
+        __m128i sumLo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero)),
+            _mm_unpacklo_epi8(bl, zero));
+        __m128i sumHi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero)),
+            _mm_unpackhi_epi8(bl, zero));
+
+        __m128i luma = _mm_packus_epi16(_mm_mulhi_epu16(sumLo, third), _mm_mulhi_epu16(sumHi, third));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), luma);
+    }
+
+    return i;
+}
+
+}
+#endif
+
+void rgbToRgba(const unsigned char* src, unsigned char* dst, size_t pixelCount)
+{
+    size_t i = 0;
+
+#ifdef VKE_SSSE3
+    if (ssse3Supported())
+        i = rgbToRgbaSsse3(src, dst, pixelCount);
+#endif
+
+    for (; i < pixelCount; i++)
+    {
+        dst[i * 4] = src[i * 3];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+void rgbToLuma(const unsigned char* src, unsigned char* dst, size_t pixelCount)
+{
+    size_t i = 0;
+
+#ifdef VKE_SSSE3
+    if (ssse3Supported())
+        i = rgbToLumaSsse3(src, dst, pixelCount);
+#endif
+
+    for (; i < pixelCount; i++)
+    {
+        dst[i] = static_cast<unsigned char>((src[i * 3] + src[i * 3 + 1] + src[i * 3 + 2]) / 3);
+    }
 }
 
 }
\ No newline at end of file
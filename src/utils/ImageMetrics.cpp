@@ -0,0 +1,133 @@
+/**
+ * @file ImageMetrics.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "utils/ImageMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vke::utils
+{
+
+namespace
+{
+
+float luma(const uint8_t* pixel)
+{
+    return (0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2]) / 255.f;
+}
+
+}
+
+MetricsSumsCompute computeMetricsSums(const uint8_t* gt, const uint8_t* novel, const glm::ivec2& dims)
+{
+    MetricsSumsCompute sums{};
+
+    // summed area tables of the luma moments, one row and column larger, so every window is
+    // given by its four corners
+    glm::ivec2 tableDims = dims + 1;
+    std::vector<double> sumA(tableDims.x * tableDims.y, 0.0);
+    std::vector<double> sumB(sumA.size(), 0.0);
+    std::vector<double> sumAA(sumA.size(), 0.0);
+    std::vector<double> sumBB(sumA.size(), 0.0);
+    std::vector<double> sumAB(sumA.size(), 0.0);
+
+    double squaredError = 0.0;
+
+    for (int y = 0; y < dims.y; y++)
+    {
+        for (int x = 0; x < dims.x; x++)
+        {
+            const uint8_t* gtPixel = gt + (y * dims.x + x) * 4;
+            const uint8_t* novelPixel = novel + (y * dims.x + x) * 4;
+
+            for (int c = 0; c < 3; c++)
+            {
+                double diff = (gtPixel[c] - novelPixel[c]) / 255.0;
+                squaredError += diff * diff;
+            }
+
+            double a = luma(gtPixel);
+            double b = luma(novelPixel);
+
+            int id = (y + 1) * tableDims.x + (x + 1);
+            int up = y * tableDims.x + (x + 1);
+            int left = (y + 1) * tableDims.x + x;
+            int upLeft = y * tableDims.x + x;
+
+            sumA[id] = a + sumA[up] + sumA[left] - sumA[upLeft];
+            sumB[id] = b + sumB[up] + sumB[left] - sumB[upLeft];
+            sumAA[id] = a * a + sumAA[up] + sumAA[left] - sumAA[upLeft];
+            sumBB[id] = b * b + sumBB[up] + sumBB[left] - sumBB[upLeft];
+            sumAB[id] = a * b + sumAB[up] + sumAB[left] - sumAB[upLeft];
+        }
+    }
+
+    double ssim = 0.0;
+    double count = SSIM_WINDOW * SSIM_WINDOW;
+
+    for (int y = 0; y + SSIM_WINDOW <= dims.y; y++)
+    {
+        for (int x = 0; x + SSIM_WINDOW <= dims.x; x++)
+        {
+            int topLeft = y * tableDims.x + x;
+            int topRight = y * tableDims.x + x + SSIM_WINDOW;
+            int bottomLeft = (y + SSIM_WINDOW) * tableDims.x + x;
+            int bottomRight = (y + SSIM_WINDOW) * tableDims.x + x + SSIM_WINDOW;
+
+            auto window = [&](const std::vector<double>& table) {
+                return (table[bottomRight] - table[topRight] - table[bottomLeft] + table[topLeft]) / count;
+            };
+
+            double meanA = window(sumA);
+            double meanB = window(sumB);
+            double varA = window(sumAA) - meanA * meanA;
+            double varB = window(sumBB) - meanB * meanB;
+            double covariance = window(sumAB) - meanA * meanB;
+
+            ssim += ((2.0 * meanA * meanB + SSIM_C1) * (2.0 * covariance + SSIM_C2)) /
+                ((meanA * meanA + meanB * meanB + SSIM_C1) * (varA + varB + SSIM_C2));
+        }
+    }
+
+    sums.squaredError = static_cast<float>(squaredError);
+    sums.ssim = static_cast<float>(ssim);
+    sums.windows = static_cast<float>(std::max(dims.x - SSIM_WINDOW + 1, 0) * std::max(dims.y - SSIM_WINDOW + 1, 0));
+    sums.pixels = static_cast<float>(dims.x * dims.y);
+
+    return sums;
+}
+
+ImageMetrics metricsFromSums(const MetricsSumsCompute& sums)
+{
+    ImageMetrics metrics{};
+
+    metrics.mse = (sums.pixels > 0.f) ? sums.squaredError / (sums.pixels * 3.f) : 0.f;
+    metrics.psnr = (metrics.mse > 0.f) ? -10.f * std::log10(metrics.mse) : std::numeric_limits<float>::infinity();
+    metrics.ssim = (sums.windows > 0.f) ? sums.ssim / sums.windows : 1.f;
+
+    return metrics;
+}
+
+ImageMetrics averageMetrics(const std::vector<ImageMetrics>& metrics)
+{
+    ImageMetrics average{};
+
+    for (auto& frame : metrics)
+    {
+        average.mse += frame.mse / metrics.size();
+        average.psnr += frame.psnr / metrics.size();
+        average.ssim += frame.ssim / metrics.size();
+    }
+
+    return average;
+}
+
+}
\ No newline at end of file
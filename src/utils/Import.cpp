@@ -9,11 +9,43 @@
 
 #include "utils/Import.h"
 #include "Material.h"
+#include "utils/Trace.h"
 
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
+namespace
+{
+
+/**
+ * @brief Default file access of assimp which remembers the files it opened.
+ */
+class RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+    explicit RecordingIOSystem(std::vector<std::string>& openedFiles)
+        : m_openedFiles(openedFiles)
+    {
+    }
+
+    Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb") override
+    {
+        Assimp::IOStream* stream = Assimp::DefaultIOSystem::Open(pFile, pMode);
+        if (stream)
+        {
+            m_openedFiles.push_back(pFile);
+        }
+
+        return stream;
+    }
+
+private:
+    std::vector<std::string>& m_openedFiles;
+};
+
+}
+
 namespace vke::utils
 {
 
@@ -35,9 +67,6 @@ std::shared_ptr<Mesh> processMesh(aiMesh* mesh, const aiScene* scene,
     const aiMatrix4x4& accTransform, std::vector<Vertex>& vertices,
     std::vector<uint32_t>& indices, std::string directory)
 {
-    std::vector<Vertex> localVertices;
-    std::vector<uint32_t> localIndices;
-
     aiVector3D UVW;
     aiVector3D n;
 
@@ -118,7 +147,6 @@ std::shared_ptr<Mesh> processMesh(aiMesh* mesh, const aiScene* scene,
         }
 
         vertices.push_back(vertex);
-        localVertices.push_back(vertex);
     }
 
     for (uint32_t i = 0; i < mesh->mNumFaces; i++)
@@ -127,14 +155,14 @@ std::shared_ptr<Mesh> processMesh(aiMesh* mesh, const aiScene* scene,
         for (uint32_t j = 0; j < face.mNumIndices; j++)
         {
             indices.push_back(face.mIndices[j]);
-            localIndices.push_back(face.mIndices[j]);
         }
     }
 
     glm::mat4 modelMatrix = aiMatrix4x4ToGlm(&accTransform);
 
     info.indexCount = indices.size() - info.firstIndex;
-    std::shared_ptr<Mesh> myMesh = std::make_shared<Mesh>(localVertices, localIndices, info);
+    info.vertexCount = mesh->mNumVertices;
+    std::shared_ptr<Mesh> myMesh = std::make_shared<Mesh>(info);
     myMesh->setModelMatrix(glm::mat4(1.f));
 
     std::shared_ptr<Material> myMaterial = std::make_shared<Material>();
@@ -239,7 +267,7 @@ void processNode(const std::shared_ptr<Model>& model, aiNode* node, const aiScen
 }
 
 std::shared_ptr<Model> importModel(std::string filename, std::vector<Vertex>& vertices,
-    std::vector<uint32_t>& indices)
+    std::vector<uint32_t>& indices, std::vector<std::string>* openedFiles)
 {
     filename = std::string(MODELS_FILES_LOC) + filename;
 
@@ -253,6 +281,11 @@ std::shared_ptr<Model> importModel(std::string filename, std::vector<Vertex>& ve
     fs::path dirPath = directory;
 
     Assimp::Importer import;
+    if (openedFiles)
+    {
+        // the importer owns the handler
+        import.SetIOHandler(new RecordingIOSystem(*openedFiles));
+    }
 
     const aiScene * scene = import.ReadFile(filename.c_str(), aiProcess_Triangulate | aiProcess_CalcTangentSpace);
 
@@ -269,4 +302,19 @@ std::shared_ptr<Model> importModel(std::string filename, std::vector<Vertex>& ve
     return model;
 }
 
+std::shared_ptr<Model> importModelCached(std::string filename, GeometryArena& geometry)
+{
+    TRACE_ZONE("Import model");
+
+    uint32_t firstVertex = geometry.getVertexCount();
+    uint32_t firstIndex = geometry.getIndexCount();
+
+    // the arena points straight into the cache mapping and keeps it alive until the upload
+    std::shared_ptr<SceneCache> modelGeometry = SceneCache::loadModel(filename);
+    geometry.append(modelGeometry, modelGeometry->getVertices(), modelGeometry->getVertexCount(),
+        modelGeometry->getIndices(), modelGeometry->getIndexCount());
+
+    return modelGeometry->createModel(firstVertex, firstIndex);
+}
+
 }
\ No newline at end of file
@@ -9,6 +9,10 @@
 
 #include "utils/Math.h"
 
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+
 namespace vke::utils
 {
 glm::vec3 getScaleFromMatrix(glm::mat4 matrix)
@@ -25,4 +29,94 @@ glm::vec3 getScaleFromMatrix(glm::mat4 matrix)
     return scale;
 }
 
+glm::vec2 octEncode(glm::vec3 direction)
+{
+    float l1 = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (l1 <= 0.f)
+    {
+        return glm::vec2(0.f);
+    }
+
+    glm::vec2 p = glm::vec2(direction.x, direction.y) / l1;
+
+    // fold the lower hemisphere over the diagonals
+    if (direction.z < 0.f)
+    {
+        glm::vec2 s(p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f);
+        p = (1.f - glm::abs(glm::vec2(p.y, p.x))) * s;
+    }
+
+    return p;
+}
+
+glm::vec3 octDecode(glm::vec2 encoded)
+{
+    glm::vec3 v(encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+    float t = glm::max(-v.z, 0.f);
+    v.x += v.x >= 0.f ? -t : t;
+    v.y += v.y >= 0.f ? -t : t;
+
+    return glm::normalize(v);
+}
+
+void packVertices(const Vertex* vertices, uint32_t count, PackedVertex* dst,
+    glm::vec3& positionOffset, glm::vec3& positionScale)
+{
+    positionOffset = glm::vec3(0.f);
+    positionScale = glm::vec3(1.f);
+
+#if QUANTIZED_POSITIONS
+    if (count > 0)
+    {
+        glm::vec3 minPos(vertices[0].pos);
+        glm::vec3 maxPos(vertices[0].pos);
+        for (uint32_t i = 1; i < count; i++)
+        {
+            minPos = glm::min(minPos, glm::vec3(vertices[i].pos));
+            maxPos = glm::max(maxPos, glm::vec3(vertices[i].pos));
+        }
+
+        positionOffset = minPos;
+        positionScale = maxPos - minPos;
+        for (int c = 0; c < 3; c++)
+        {
+            if (positionScale[c] <= 0.f)
+                positionScale[c] = 1.f;
+        }
+    }
+#endif
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& packed = dst[i];
+
+        glm::vec3 normal(vertex.normal);
+        glm::vec3 tangent(vertex.tangent);
+        glm::vec3 bitangent(vertex.bitangent);
+        float bitangentSign = glm::dot(glm::cross(normal, tangent), bitangent) < 0.f ? -1.f : 1.f;
+
+#if QUANTIZED_POSITIONS
+        glm::vec3 q = glm::clamp((glm::vec3(vertex.pos) - positionOffset) / positionScale, 0.f, 1.f);
+        for (int c = 0; c < 3; c++)
+            packed.pos[c] = static_cast<uint16_t>(std::lround(q[c] * 65535.f));
+        packed.pos[3] = bitangentSign > 0.f ? 65535 : 0;
+#else
+        for (int c = 0; c < 3; c++)
+            packed.pos[c] = vertex.pos[c];
+        packed.pos[3] = bitangentSign;
+#endif
+
+        glm::vec2 n = octEncode(normal);
+        glm::vec2 t = octEncode(tangent);
+        packed.normalTangent[0] = static_cast<int16_t>(std::lround(n.x * 32767.f));
+        packed.normalTangent[1] = static_cast<int16_t>(std::lround(n.y * 32767.f));
+        packed.normalTangent[2] = static_cast<int16_t>(std::lround(t.x * 32767.f));
+        packed.normalTangent[3] = static_cast<int16_t>(std::lround(t.y * 32767.f));
+
+        packed.uv[0] = static_cast<uint16_t>(glm::packHalf1x16(vertex.uv.x));
+        packed.uv[1] = static_cast<uint16_t>(glm::packHalf1x16(vertex.uv.y));
+    }
+}
+
 }
\ No newline at end of file
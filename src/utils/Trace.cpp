@@ -0,0 +1,193 @@
+/**
+ * @file Trace.cpp
+ * @author Boris Burkalo (xburka00)
+ * @brief
+ * @date 2024-05-20
+ *
+ *
+ */
+
+#include "utils/Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vke::utils
+{
+
+namespace
+{
+
+constexpr uint64_t TRACE_RING_SIZE = 1 << 16;
+constexpr int32_t CPU_TRACK = -1;
+
+struct TraceRecord
+{
+    const char* name;
+    int32_t gpuTrack;
+    int64_t start;
+    int64_t end;
+};
+
+struct TraceRing
+{
+    std::array<TraceRecord, TRACE_RING_SIZE> records;
+    // number of records ever written, only stored by the owning thread
+    std::atomic<uint64_t> head{ 0 };
+    uint32_t threadId = 0;
+    std::string threadName;
+};
+
+const std::chrono::steady_clock::time_point g_traceStart = std::chrono::steady_clock::now();
+
+// the rings outlive their threads, so the zones of the finished screenshot threads are kept
+std::mutex g_ringsMutex;
+std::vector<std::shared_ptr<TraceRing>> g_rings;
+
+thread_local TraceRing* t_ring = nullptr;
+
+TraceRing* getThreadRing()
+{
+    if (t_ring)
+        return t_ring;
+
+    // only the first zone of every thread takes the lock
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+
+    auto ring = std::make_shared<TraceRing>();
+    ring->threadId = static_cast<uint32_t>(g_rings.size());
+    ring->threadName = "Thread " + std::to_string(ring->threadId);
+    g_rings.push_back(ring);
+
+    t_ring = ring.get();
+
+    return t_ring;
+}
+
+void pushRecord(const TraceRecord& record)
+{
+    TraceRing* ring = getThreadRing();
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->records[head % TRACE_RING_SIZE] = record;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char code[7];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                escaped += code;
+            }
+            else
+            {
+                escaped += c;
+            }
+        }
+    }
+
+    return escaped;
+}
+
+}
+
+int64_t traceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_traceStart).count();
+}
+
+void traceEvent(const char* name, int64_t start, int64_t end)
+{
+    pushRecord(TraceRecord{ name, CPU_TRACK, start, end });
+}
+
+void traceGpuEvent(const char* name, uint32_t track, int64_t start, int64_t end)
+{
+    pushRecord(TraceRecord{ name, static_cast<int32_t>(track), start, end });
+}
+
+void setTraceThreadName(const std::string& name)
+{
+    TraceRing* ring = getThreadRing();
+
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    ring->threadName = name;
+}
+
+void writeTrace(const std::string& filename)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open file: " + filename);
+
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+
+    // microseconds with a nanosecond fraction
+    file << std::fixed << std::setprecision(3);
+
+    // the CPU threads are in the first process, the GPU queues in the second one
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}}," << std::endl;
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"Graphics queue\"}}," << std::endl;
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":1,\"args\":{\"name\":\"Compute queue\"}}";
+
+    for (auto& ring : g_rings)
+    {
+        file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId
+            << ",\"args\":{\"name\":\"" << escapeJson(ring->threadName) << "\"}}";
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+        std::vector<TraceRecord> records;
+        records.reserve(head - first);
+        for (uint64_t i = first; i < head; i++)
+            records.push_back(ring->records[i % TRACE_RING_SIZE]);
+
+        // the owning thread may have overwritten the oldest records during the copy, and may be
+        // writing the record at newHead right now, which reuses the slot of newHead - TRACE_RING_SIZE
+        uint64_t newHead = ring->head.load(std::memory_order_acquire);
+        uint64_t valid = newHead + 1 > TRACE_RING_SIZE ? newHead + 1 - TRACE_RING_SIZE : 0;
+
+        for (uint64_t i = std::max(first, valid); i < head; i++)
+        {
+            const TraceRecord& record = records[i - first];
+
+            bool gpu = record.gpuTrack != CPU_TRACK;
+
+            file << "," << std::endl << "{\"name\":\"" << escapeJson(record.name) << "\",\"cat\":\"" << (gpu ? "gpu" : "cpu")
+                << "\",\"ph\":\"X\",\"ts\":" << record.start / 1000.0 << ",\"dur\":" << (record.end - record.start) / 1000.0
+                << ",\"pid\":" << (gpu ? 2 : 1) << ",\"tid\":" << (gpu ? record.gpuTrack : static_cast<int32_t>(ring->threadId)) << "}";
+        }
+    }
+
+    file << std::endl << "]}" << std::endl;
+}
+
+}
\ No newline at end of file
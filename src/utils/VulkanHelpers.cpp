@@ -26,21 +26,36 @@ vke::QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-        if (presentSupport)
+        // A compute only family runs the ray evaluation next to the graphics work.
+        if (!indices.computeFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+            !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
         {
-            indices.presentFamily = i;
+            indices.computeFamily = i;
         }
 
-        if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
-            (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+        if (!indices.isComplete())
         {
-            indices.graphicsFamily = i;
+            VkBool32 presentSupport = false;
+            if (surface != VK_NULL_HANDLE)
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+            if (presentSupport)
+            {
+                indices.presentFamily = i;
+            }
+
+            if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+                (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+            {
+                indices.graphicsFamily = i;
+
+                // Without a surface (headless) nothing is presented, the graphics queue is used instead.
+                if (surface == VK_NULL_HANDLE)
+                    indices.presentFamily = i;
+            }
         }
 
-        if (indices.isComplete())
+        if (indices.isComplete() && indices.computeFamily.has_value())
         {
             break;
         }
@@ -85,7 +100,11 @@ bool checkDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface, const st
     bool extensionsSupported = checkDeviceExtensionSupport(device, deviceExtensions);
     
     bool swapChainAdequate = false;
-    if (extensionsSupported)
+    if (surface == VK_NULL_HANDLE)
+    {
+        swapChainAdequate = true;
+    }
+    else if (extensionsSupported)
     {
         SwapChainSupportDetails swapChainSupport = vke::utils::querySwapChainSupport(device, surface);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();